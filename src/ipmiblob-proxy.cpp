@@ -0,0 +1,84 @@
+/* ipmiblob-proxy: owns the IPMI device and serves requests from local
+ * processes over a Unix socket, so that they share the BMC fairly.
+ *
+ *     ipmiblob-proxy [--socket PATH] [--window N]
+ */
+
+#include <ipmiblob/ipmi_handler.hpp>
+#include <ipmiblob/ipmi_proxy.hpp>
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace
+{
+
+ipmiblob::IpmiProxyServer* running = nullptr;
+
+void stopRunning(int)
+{
+    if (running)
+    {
+        running->stop();
+    }
+}
+
+int usage(const char* name)
+{
+    std::fprintf(stderr,
+                 "usage: %s [--socket PATH] [--window N]\n", name);
+    return EXIT_FAILURE;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    std::string path = ipmiblob::proxy::defaultSocketPath;
+    ipmiblob::IpmiProxyServer::Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!std::strcmp(argv[i], "--socket") && i + 1 < argc)
+        {
+            path = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--window") && i + 1 < argc)
+        {
+            options.window = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else
+        {
+            return usage(argv[0]);
+        }
+    }
+
+    if (!options.window)
+    {
+        return usage(argv[0]);
+    }
+
+    ipmiblob::IpmiProxyServer server(
+        ipmiblob::IpmiHandler::CreateIpmiHandler(options.window), options);
+    if (auto listening = server.listen(path); !listening)
+    {
+        std::fprintf(stderr, "%s\n", listening.error().message().c_str());
+        return EXIT_FAILURE;
+    }
+
+    running = &server;
+    std::signal(SIGINT, stopRunning);
+    std::signal(SIGTERM, stopRunning);
+
+    auto served = server.run();
+    running = nullptr;
+    if (!served)
+    {
+        std::fprintf(stderr, "%s\n", served.error().message().c_str());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,129 @@
+#include "async_blob_handler.hpp"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ipmiblob
+{
+
+BlobOperation<std::uint32_t> AsyncBlobHandler::getBlobCount()
+{
+    return BlobOperation<std::uint32_t>(
+        [this](BlobCallback<std::uint32_t> done) {
+            blob.getBlobCountAsync(std::move(done));
+        });
+}
+
+BlobOperation<std::string> AsyncBlobHandler::enumerateBlob(
+    std::uint32_t index)
+{
+    return BlobOperation<std::string>(
+        [this, index](BlobCallback<std::string> done) {
+            blob.enumerateBlobAsync(index, std::move(done));
+        });
+}
+
+Task<BlobResult<std::vector<std::string>>> AsyncBlobHandler::getBlobList()
+{
+    auto blobCount = co_await getBlobCount();
+    if (!blobCount)
+    {
+        co_return std::unexpected(blobCount.error());
+    }
+
+    std::vector<std::string> list;
+    for (std::uint32_t i = 0; i < *blobCount; i++)
+    {
+        auto name = co_await enumerateBlob(i);
+        /* Currently ignore failures. */
+        if (name && !name->empty())
+        {
+            list.push_back(std::move(*name));
+        }
+    }
+
+    co_return list;
+}
+
+BlobOperation<void> AsyncBlobHandler::commit(
+    std::uint16_t session, std::span<const std::uint8_t> bytes)
+{
+    return BlobOperation<void>([this, session, bytes](BlobCallback<void> done) {
+        blob.commitAsync(session, bytes, std::move(done));
+    });
+}
+
+BlobOperation<void> AsyncBlobHandler::writeMeta(
+    std::uint16_t session, std::uint32_t offset,
+    std::span<const std::uint8_t> bytes)
+{
+    return BlobOperation<void>(
+        [this, session, offset, bytes](BlobCallback<void> done) {
+            blob.writeMetaAsync(session, offset, bytes, std::move(done));
+        });
+}
+
+BlobOperation<void> AsyncBlobHandler::writeBytes(
+    std::uint16_t session, std::uint32_t offset,
+    std::span<const std::uint8_t> bytes)
+{
+    return BlobOperation<void>(
+        [this, session, offset, bytes](BlobCallback<void> done) {
+            blob.writeBytesAsync(session, offset, bytes, std::move(done));
+        });
+}
+
+BlobOperation<StatResponse> AsyncBlobHandler::getStat(std::string_view id)
+{
+    return BlobOperation<StatResponse>(
+        [this, id](BlobCallback<StatResponse> done) {
+            blob.getStatAsync(id, std::move(done));
+        });
+}
+
+BlobOperation<StatResponse> AsyncBlobHandler::getStat(std::uint16_t session)
+{
+    return BlobOperation<StatResponse>(
+        [this, session](BlobCallback<StatResponse> done) {
+            blob.getStatAsync(session, std::move(done));
+        });
+}
+
+BlobOperation<std::uint16_t> AsyncBlobHandler::openBlob(
+    std::string_view id, std::uint16_t handlerFlags)
+{
+    return BlobOperation<std::uint16_t>(
+        [this, id, handlerFlags](BlobCallback<std::uint16_t> done) {
+            blob.openBlobAsync(id, handlerFlags, std::move(done));
+        });
+}
+
+BlobOperation<void> AsyncBlobHandler::closeBlob(std::uint16_t session)
+{
+    return BlobOperation<void>([this, session](BlobCallback<void> done) {
+        blob.closeBlobAsync(session, std::move(done));
+    });
+}
+
+BlobOperation<void> AsyncBlobHandler::deleteBlob(std::string_view id)
+{
+    return BlobOperation<void>([this, id](BlobCallback<void> done) {
+        blob.deleteBlobAsync(id, std::move(done));
+    });
+}
+
+BlobOperation<std::vector<std::uint8_t>> AsyncBlobHandler::readBytes(
+    std::uint16_t session, std::uint32_t offset, std::uint32_t length)
+{
+    using Bytes = std::vector<std::uint8_t>;
+    return BlobOperation<Bytes>(
+        [this, session, offset, length](BlobCallback<Bytes> done) {
+            blob.readBytesAsync(session, offset, length, std::move(done));
+        });
+}
+
+} // namespace ipmiblob
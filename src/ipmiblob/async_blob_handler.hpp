@@ -0,0 +1,121 @@
+#pragma once
+
+#include "blob_handler.hpp"
+#include "coroutine.hpp"
+
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ipmiblob
+{
+
+/**
+ * An asynchronous blob call to be co_awaited from a Task.  The request is
+ * only sent when the operation is awaited, and the awaiting task is resumed
+ * on its executor once the reply is in.  Await it in the expression that
+ * created it: the bytes and ids it was given are read when it is sent.
+ */
+template <typename T>
+class [[nodiscard]] BlobOperation
+{
+  public:
+    /* Sends the request, arranging for the callback to get the outcome. */
+    using Start = std::function<void(BlobCallback<T>)>;
+
+    explicit BlobOperation(Start start) : start(std::move(start)) {}
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    template <typename Promise>
+    void await_suspend(std::coroutine_handle<Promise> caller)
+    {
+        Executor* executor = caller.promise().executor;
+        /* The callback may run before start returns, but the task is only
+         * resumed from the executor, so this is safe either way.
+         */
+        start([this, executor, caller](BlobResult<T> outcome) {
+            result.emplace(std::move(outcome));
+            executor->schedule(caller);
+        });
+    }
+
+    BlobResult<T> await_resume()
+    {
+        return std::move(*result);
+    }
+
+  private:
+    Start start;
+    std::optional<BlobResult<T>> result;
+};
+
+/**
+ * Coroutine versions of the blob calls, for writing many concurrent
+ * sequential flows (open, write, commit, poll, close) as straight-line code
+ * while the transport keeps their requests in flight together:
+ *
+ *     Task<BlobResult<void>> update(AsyncBlobHandler& blob) {
+ *         auto session = co_await blob.openBlob("/flash/image", flags);
+ *         ...
+ *     }
+ *
+ * Failures are reported by value, as with the try* calls on BlobHandler.
+ */
+class AsyncBlobHandler
+{
+  public:
+    /**
+     * @param[in] blob - the handler to send requests through, which must
+     *     outlive this object.
+     */
+    explicit AsyncBlobHandler(BlobHandler& blob) : blob(blob) {}
+
+    BlobOperation<std::uint32_t> getBlobCount();
+
+    BlobOperation<std::string> enumerateBlob(std::uint32_t index);
+
+    /**
+     * Enumerate every blob, skipping ids that fail to enumerate like
+     * BlobHandler::getBlobList().
+     */
+    Task<BlobResult<std::vector<std::string>>> getBlobList();
+
+    BlobOperation<void> commit(std::uint16_t session,
+                               std::span<const std::uint8_t> bytes = {});
+
+    BlobOperation<void> writeMeta(std::uint16_t session, std::uint32_t offset,
+                                  std::span<const std::uint8_t> bytes);
+
+    BlobOperation<void> writeBytes(std::uint16_t session, std::uint32_t offset,
+                                   std::span<const std::uint8_t> bytes);
+
+    BlobOperation<StatResponse> getStat(std::string_view id);
+
+    BlobOperation<StatResponse> getStat(std::uint16_t session);
+
+    BlobOperation<std::uint16_t> openBlob(std::string_view id,
+                                          std::uint16_t handlerFlags);
+
+    BlobOperation<void> closeBlob(std::uint16_t session);
+
+    BlobOperation<void> deleteBlob(std::string_view id);
+
+    BlobOperation<std::vector<std::uint8_t>> readBytes(std::uint16_t session,
+                                                       std::uint32_t offset,
+                                                       std::uint32_t length);
+
+  private:
+    BlobHandler& blob;
+};
+
+} // namespace ipmiblob
@@ -1,23 +1,79 @@
 #pragma once
 
+#include "ipmi_errors.hpp"
+
 #include <exception>
+#include <expected>
+#include <memory>
 #include <string>
+#include <utility>
 
 namespace ipmiblob
 {
 
+/**
+ * A blob failure reported by value.  When the BMC rejected the request the
+ * IPMI completion code is kept, so callers can tell a busy BMC (0xc0) from a
+ * hard failure without parsing strings.
+ */
+struct BlobError
+{
+    /* The IPMI completion code, or 0 if the failure was not a rejection. */
+    int code = 0;
+    /* What went wrong, or nullptr when code is set. */
+    const char* reason = nullptr;
+
+    BlobError(const char* reason) : reason(reason) {}
+    BlobError(const IpmiError& error) :
+        code(error.code), reason(error.reason), owned(error.owned)
+    {}
+
+    /* Keeps its own copy of a reason that would not outlive it, such as the
+     * message of a caught exception.
+     */
+    explicit BlobError(std::string reason) :
+        owned(std::make_shared<const std::string>(std::move(reason)))
+    {
+        this->reason = owned->c_str();
+    }
+
+    std::string message() const
+    {
+        return IpmiError{code, reason}.message();
+    }
+
+  private:
+    std::shared_ptr<const std::string> owned;
+};
+
+template <typename T>
+using BlobResult = std::expected<T, BlobError>;
+
 class BlobException : public std::exception
 {
   public:
     explicit BlobException(const std::string& message) : message(message) {};
 
+    explicit BlobException(const char* message) : message(message) {}
+
+    explicit BlobException(const BlobError& error) :
+        message(error.message()), ccode(error.code)
+    {}
+
     virtual const char* what() const noexcept override
     {
         return message.c_str();
     }
 
+    /* The IPMI completion code behind the failure, if any, else 0. */
+    int code() const noexcept
+    {
+        return ccode;
+    }
+
   private:
     std::string message;
+    int ccode = 0;
 };
 
 } // namespace ipmiblob
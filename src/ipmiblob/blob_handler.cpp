@@ -17,63 +17,46 @@
 #include "blob_handler.hpp"
 
 #include "blob_errors.hpp"
+#include "blob_layout.hpp"
 #include "crc.hpp"
+#include "internal/blob_reply.hpp"
 #include "ipmi_errors.hpp"
 #include "ipmi_interface.hpp"
 
+#include <fcntl.h>
+#include <linux/ipmi.h>
+#include <linux/ipmi_msgdefs.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
 #include <array>
 #include <cinttypes>
 #include <cstring>
-#include <iterator>
+#include <expected>
 #include <limits>
 #include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 
 namespace ipmiblob
 {
 
-namespace
-{
-const std::array<std::uint8_t, 3> ipmiPhosphorOen = {0xcf, 0xc2, 0x00};
-}
-
-std::unique_ptr<BlobInterface> BlobHandler::CreateBlobHandler(
-    std::unique_ptr<IpmiInterface> ipmi)
+namespace internal
 {
-    return std::make_unique<BlobHandler>(std::move(ipmi));
-}
 
-std::vector<std::uint8_t> BlobHandler::sendIpmiPayload(
-    BlobOEMCommands command, const std::vector<std::uint8_t>& payload)
+BlobResult<std::span<const std::uint8_t>> unwrapReply(
+    const IpmiResult<std::span<const std::uint8_t>>& sent)
 {
-    std::vector<std::uint8_t> request, reply, bytes;
-
-    std::copy(ipmiPhosphorOen.begin(), ipmiPhosphorOen.end(),
-              std::back_inserter(request));
-    request.push_back(static_cast<std::uint8_t>(command));
-
-    if (!payload.empty())
+    if (!sent)
     {
-        /* Grow the vector to hold the bytes. */
-        request.reserve(request.size() + sizeof(std::uint16_t));
-
-        /* CRC required. */
-        std::uint16_t crc = generateCrc(payload);
-        auto src = reinterpret_cast<const std::uint8_t*>(&crc);
-
-        std::copy(src, src + sizeof(crc), std::back_inserter(request));
-
-        /* Copy the payload. */
-        std::copy(payload.begin(), payload.end(), std::back_inserter(request));
-    }
-
-    try
-    {
-        reply = ipmi->sendPacket(ipmiOEMNetFn, ipmiOEMBlobCmd, request);
-    }
-    catch (const IpmiException& e)
-    {
-        throw BlobException(e.what());
+        return std::unexpected(sent.error());
     }
+    std::span<const std::uint8_t> reply = *sent;
 
     /* IPMI_CC was OK, and it returned no bytes, so let's be happy with that for
      * now.
@@ -86,314 +69,965 @@ std::vector<std::uint8_t> BlobHandler::sendIpmiPayload(
     /* This cannot be a response because it's smaller than the smallest
      * response.
      */
-    if (reply.size() < ipmiPhosphorOen.size())
+    if (reply.size() < layout::ResponseHeader::oen::end)
     {
-        throw BlobException("Invalid response length");
+        return std::unexpected("Invalid response length");
     }
 
     /* Verify the OEN. */
-    if (std::memcmp(ipmiPhosphorOen.data(), reply.data(),
-                    ipmiPhosphorOen.size()) != 0)
+    if (layout::ResponseHeader::oen::load(reply.data()) !=
+        layout::phosphorOen)
     {
-        throw BlobException("Invalid OEN received");
+        return std::unexpected("Invalid OEN received");
     }
 
     /* In this case there was no data, as there was no CRC. */
-    std::size_t headerSize = ipmiPhosphorOen.size() + sizeof(std::uint16_t);
-    if (reply.size() < headerSize)
+    if (reply.size() < layout::ResponseHeader::size)
     {
-        return {};
+        return std::span<const std::uint8_t>();
     }
 
-    /* Validate CRC. */
-    std::uint16_t crc;
-    auto ptr = reinterpret_cast<std::uint8_t*>(&crc);
-    std::memcpy(ptr, &reply[ipmiPhosphorOen.size()], sizeof(crc));
-
-    bytes.insert(bytes.begin(), reply.begin() + headerSize, reply.end());
+    /* Validate CRC; the payload is checked and returned in place. */
+    std::uint16_t crc = layout::ResponseHeader::crc::load(reply.data());
 
+    auto bytes = reply.subspan(layout::ResponseHeader::size);
     auto computed = generateCrc(bytes);
     if (crc != computed)
     {
         std::fprintf(stderr, "Invalid CRC, received: 0x%x, computed: 0x%x\n",
                      crc, computed);
-        throw BlobException("Invalid CRC on received data.");
+        return std::unexpected("Invalid CRC on received data.");
     }
 
     return bytes;
 }
 
-int BlobHandler::getBlobCount()
+} // namespace internal
+
+namespace
 {
-    std::uint32_t count;
-    try
+
+/* Adapt a result to the throwing API. */
+template <typename T>
+T valueOrThrow(BlobResult<T>&& result)
+{
+    if (!result)
+    {
+        throw BlobException(result.error());
+    }
+
+    if constexpr (!std::is_void_v<T>)
     {
-        auto resp = sendIpmiPayload(BlobOEMCommands::bmcBlobGetCount, {});
-        if (resp.size() != sizeof(count))
+        return std::move(*result);
+    }
+}
+
+/* Whether the BMC turned a request down for carrying or asking too much. */
+bool isTooLong(const BlobError& error)
+{
+    /* Not among the kernel's definitions. */
+    constexpr int cannotReturnRequestedBytes = 0xca;
+
+    return error.code == IPMI_REQ_LEN_INVALID_ERR ||
+           error.code == IPMI_REQ_LEN_EXCEEDED_ERR ||
+           error.code == cannotReturnRequestedBytes;
+}
+
+/**
+ * Binary search for the largest size, up to most, that the BMC takes.
+ *
+ * @param[in] most - the largest size to try, and the first.
+ * @param[in] tryWith - makes a request of the given size, returning how many
+ *     bytes of it the BMC took; fewer than asked means too long.
+ */
+template <typename Request>
+BlobResult<std::size_t> largestAccepted(std::size_t most, Request tryWith)
+{
+    std::size_t accepted = 0;
+    std::size_t rejected = most + 1;
+    /* Most BMCs take the largest, so that costs a single request. */
+    std::size_t size = most;
+    while (rejected - accepted > 1)
+    {
+        auto sent = tryWith(size);
+        if (sent && *sent >= size)
+        {
+            accepted = size;
+        }
+        else if (sent)
         {
-            return 0;
+            accepted = std::max(accepted, *sent);
+            rejected = size;
         }
+        else if (isTooLong(sent.error()))
+        {
+            rejected = size;
+        }
+        else
+        {
+            return std::unexpected(sent.error());
+        }
+        size = accepted + (rejected - accepted) / 2;
+    }
 
-        /* LE to LE (need to make this portable as some point. */
-        std::memcpy(&count, resp.data(), sizeof(count));
+    if (accepted == 0)
+    {
+        return std::unexpected("BMC rejected even a single byte");
     }
-    catch (const BlobException& b)
+    return accepted;
+}
+
+/* For requests whose reply carries nothing of interest. */
+BlobResult<void> ignorePayload(
+    const BlobResult<std::span<const std::uint8_t>>& resp)
+{
+    if (!resp)
     {
-        return 0;
+        return std::unexpected(resp.error());
+    }
+    return {};
+}
+
+BlobResult<std::uint32_t> decodeCount(
+    const BlobResult<std::span<const std::uint8_t>>& resp)
+{
+    if (!resp)
+    {
+        return std::unexpected(resp.error());
     }
 
-    return count;
+    if (resp->size() != layout::GetCountResponse::size)
+    {
+        return std::unexpected("Invalid response length");
+    }
+
+    return layout::GetCountResponse::count::load(resp->data());
 }
 
-std::string BlobHandler::enumerateBlob(std::uint32_t index)
+BlobResult<std::string> decodeName(
+    const BlobResult<std::span<const std::uint8_t>>& resp)
 {
-    std::vector<std::uint8_t> payload;
-    auto data = reinterpret_cast<const std::uint8_t*>(&index);
+    if (!resp)
+    {
+        return std::unexpected(resp.error());
+    }
 
-    std::copy(data, data + sizeof(std::uint32_t), std::back_inserter(payload));
+    return (resp->empty()) ? "" : std::string(resp->begin(), resp->end() - 1);
+}
 
-    try
+BlobResult<std::uint16_t> decodeSession(
+    const BlobResult<std::span<const std::uint8_t>>& resp)
+{
+    if (!resp)
     {
-        auto resp = sendIpmiPayload(BlobOEMCommands::bmcBlobEnumerate, payload);
-        return (resp.empty()) ? ""
-                              : std::string(&resp[0], &resp[resp.size() - 1]);
+        return std::unexpected(resp.error());
     }
-    catch (const BlobException& b)
+
+    if (resp->size() != layout::OpenResponse::size)
     {
-        return "";
+        return std::unexpected("Did not receive session.");
     }
+
+    return layout::OpenResponse::session::load(resp->data());
 }
 
-void BlobHandler::commit(std::uint16_t session,
-                         const std::vector<std::uint8_t>& bytes)
+BlobResult<void> decodeStatInto(
+    const BlobResult<std::span<const std::uint8_t>>& sent, StatResponse& meta)
+{
+    using Reply = layout::StatReply;
+    static constexpr std::size_t minRespSize = Reply::size;
+
+    if (!sent)
+    {
+        return std::unexpected(sent.error());
+    }
+    std::span<const std::uint8_t> resp = *sent;
+
+    // Avoid out of bounds reads below
+    if (resp.size() < minRespSize)
+    {
+        std::fprintf(stderr,
+                     "Invalid response length, Got %zu which is less than "
+                     "minRespSize %zu\n",
+                     resp.size(), minRespSize);
+        return std::unexpected("Invalid response length");
+    }
+
+    std::uint8_t len;
+    std::tie(meta.blob_state, meta.size, len) =
+        Reply::decode(resp.first<Reply::size>());
+
+    auto metaDataLength = resp.size() - minRespSize;
+    if (metaDataLength != len)
+    {
+        std::fprintf(stderr,
+                     "Metadata length did not match actual length, Got %zu "
+                     "which does not equal expected length %" PRIu8 "\n",
+                     metaDataLength, len);
+        return std::unexpected("Metadata length did not match actual length");
+    }
+
+    meta.metadata.assign(resp.begin() + minRespSize, resp.end());
+    return {};
+}
+
+BlobResult<StatResponse> decodeStat(
+    const BlobResult<std::span<const std::uint8_t>>& sent)
+{
+    StatResponse meta;
+    if (auto decoded = decodeStatInto(sent, meta); !decoded)
+    {
+        return std::unexpected(decoded.error());
+    }
+    return meta;
+}
+
+BlobResult<std::vector<std::uint8_t>> copyPayload(
+    const BlobResult<std::span<const std::uint8_t>>& resp)
+{
+    if (!resp)
+    {
+        return std::unexpected(resp.error());
+    }
+
+    return std::vector<std::uint8_t>(resp->begin(), resp->end());
+}
+
+} // namespace
+
+/* A blob request built in place in an IPMI sized buffer: the OEN, the
+ * subcommand, a slot for the CRC and then the payload fields.
+ */
+class BlobHandler::RequestFrame
+{
+  public:
+    explicit RequestFrame(BlobOEMCommands command)
+    {
+        layout::RequestHeader::encode(
+            std::span(buffer).first<layout::RequestHeader::size>(),
+            layout::phosphorOen, static_cast<std::uint8_t>(command), 0);
+    }
+
+    /* Append the fixed fields of layout L and return them for encoding.  The
+     * fixed fields come straight after the header, ahead of any variable
+     * length tail, so they always fit.
+     */
+    template <typename L>
+    typename L::Buffer append()
+    {
+        static_assert(payloadOffset + L::size <= IPMI_MAX_MSG_LENGTH);
+
+        auto fields =
+            std::span(buffer).subspan(length).template first<L::size>();
+        length += L::size;
+        return fields;
+    }
+
+    RequestFrame& putBytes(std::span<const std::uint8_t> bytes)
+    {
+        if (reserve(bytes.size()))
+        {
+            std::copy(bytes.begin(), bytes.end(), buffer.begin() + length);
+            length += bytes.size();
+        }
+        return *this;
+    }
+
+    /* Append a string with its nul-terminator. */
+    RequestFrame& putString(std::string_view str)
+    {
+        if (reserve(str.size() + 1))
+        {
+            std::copy(str.begin(), str.end(), buffer.begin() + length);
+            length += str.size();
+            buffer[length++] = 0x00;
+        }
+        return *this;
+    }
+
+    /* Fill in the CRC, or drop its slot when there is no payload, and return
+     * the bytes to put on the wire.
+     */
+    BlobResult<std::span<const std::uint8_t>> finish()
+    {
+        if (overflow)
+        {
+            return std::unexpected("Request too large for an IPMI message");
+        }
+
+        if (length == payloadOffset)
+        {
+            return std::span(buffer).first(crcOffset);
+        }
+
+        std::uint16_t crc =
+            generateCrc(std::span(buffer).subspan(payloadOffset,
+                                                  length - payloadOffset));
+        layout::RequestHeader::crc::store(buffer.data(), crc);
+
+        return std::span(buffer).first(length);
+    }
+
+  private:
+    /* Note a tail that does not fit; finish() reports it. */
+    bool reserve(std::size_t size)
+    {
+        if (size > buffer.size() - length)
+        {
+            overflow = true;
+        }
+        return !overflow;
+    }
+
+    static constexpr std::size_t crcOffset =
+        layout::RequestHeader::crc::offset;
+    static constexpr std::size_t payloadOffset = layout::RequestHeader::size;
+
+    std::array<std::uint8_t, IPMI_MAX_MSG_LENGTH> buffer;
+    std::size_t length = payloadOffset;
+    bool overflow = false;
+};
+
+std::unique_ptr<BlobInterface> BlobHandler::CreateBlobHandler(
+    std::unique_ptr<IpmiInterface> ipmi)
+{
+    return std::make_unique<BlobHandler>(std::move(ipmi));
+}
+
+BlobResult<std::span<const std::uint8_t>> BlobHandler::sendIpmiPayload(
+    RequestFrame& frame, IpmiReply& buffer)
+{
+    auto request = frame.finish();
+    if (!request)
+    {
+        return std::unexpected(request.error());
+    }
+
+    return internal::unwrapReply(ipmi->trySendPacketInto(
+        ipmiOEMNetFn, ipmiOEMBlobCmd, *request, buffer));
+}
+
+template <typename T, typename Decode>
+void BlobHandler::submitPayload(RequestFrame& frame, BlobCallback<T> done,
+                                Decode decode)
+{
+    auto request = frame.finish();
+    if (!request)
+    {
+        done(std::unexpected(request.error()));
+        return;
+    }
+
+    ipmi->submit(ipmiOEMNetFn, ipmiOEMBlobCmd, *request,
+                 [done = std::move(done), decode](
+                     IpmiResult<std::span<const std::uint8_t>> sent) {
+                     done(decode(internal::unwrapReply(sent)));
+                 });
+}
+
+BlobResult<std::uint32_t> BlobHandler::tryGetBlobCount()
+{
+    RequestFrame frame(BlobOEMCommands::bmcBlobGetCount);
+    IpmiReply buffer;
+    return decodeCount(sendIpmiPayload(frame, buffer));
+}
+
+int BlobHandler::getBlobCount()
+{
+    return tryGetBlobCount().value_or(0);
+}
+
+void BlobHandler::getBlobCountAsync(BlobCallback<std::uint32_t> done)
+{
+    RequestFrame frame(BlobOEMCommands::bmcBlobGetCount);
+    submitPayload(frame, std::move(done), decodeCount);
+}
+
+BlobResult<std::string> BlobHandler::tryEnumerateBlob(std::uint32_t index)
 {
-    std::vector<std::uint8_t> request;
-    auto addrSession = reinterpret_cast<const std::uint8_t*>(&session);
-    std::copy(addrSession, addrSession + sizeof(session),
-              std::back_inserter(request));
+    RequestFrame frame(BlobOEMCommands::bmcBlobEnumerate);
+    layout::EnumerateRequest::encode(frame.append<layout::EnumerateRequest>(),
+                                     index);
 
+    IpmiReply buffer;
+    return decodeName(sendIpmiPayload(frame, buffer));
+}
+
+std::string BlobHandler::enumerateBlob(std::uint32_t index)
+{
+    return tryEnumerateBlob(index).value_or("");
+}
+
+void BlobHandler::enumerateBlobAsync(std::uint32_t index,
+                                     BlobCallback<std::string> done)
+{
+    RequestFrame frame(BlobOEMCommands::bmcBlobEnumerate);
+    layout::EnumerateRequest::encode(frame.append<layout::EnumerateRequest>(),
+                                     index);
+    submitPayload(frame, std::move(done), decodeName);
+}
+
+BlobResult<void> BlobHandler::tryCommit(std::uint16_t session,
+                                        std::span<const std::uint8_t> bytes)
+{
     /* You have one byte to describe the length. */
     if (bytes.size() > std::numeric_limits<std::uint8_t>::max())
     {
-        throw BlobException("Commit data length greater than 8-bit limit\n");
+        return std::unexpected("Commit data length greater than 8-bit limit\n");
     }
 
-    std::uint8_t length = static_cast<std::uint8_t>(bytes.size());
-    auto addrLength = reinterpret_cast<const std::uint8_t*>(&length);
-    std::copy(addrLength, addrLength + sizeof(length),
-              std::back_inserter(request));
+    RequestFrame frame(BlobOEMCommands::bmcBlobCommit);
+    layout::CommitRequest::encode(frame.append<layout::CommitRequest>(),
+                                  session,
+                                  static_cast<std::uint8_t>(bytes.size()));
+    frame.putBytes(bytes);
 
-    std::copy(bytes.begin(), bytes.end(), std::back_inserter(request));
+    IpmiReply buffer;
+    return ignorePayload(sendIpmiPayload(frame, buffer));
+}
 
-    sendIpmiPayload(BlobOEMCommands::bmcBlobCommit, request);
+void BlobHandler::commit(std::uint16_t session,
+                         const std::vector<std::uint8_t>& bytes)
+{
+    valueOrThrow(tryCommit(session, bytes));
 }
 
-void BlobHandler::writeGeneric(BlobOEMCommands command, std::uint16_t session,
-                               std::uint32_t offset,
-                               const std::vector<std::uint8_t>& bytes)
+void BlobHandler::commit(std::uint16_t session,
+                         std::span<const std::uint8_t> bytes)
 {
-    std::vector<std::uint8_t> payload;
+    valueOrThrow(tryCommit(session, bytes));
+}
 
-    payload.reserve(
-        sizeof(std::uint16_t) + sizeof(std::uint32_t) + bytes.size());
+void BlobHandler::commitAsync(std::uint16_t session,
+                              std::span<const std::uint8_t> bytes,
+                              BlobCallback<void> done)
+{
+    if (bytes.size() > std::numeric_limits<std::uint8_t>::max())
+    {
+        done(std::unexpected("Commit data length greater than 8-bit limit\n"));
+        return;
+    }
 
-    auto data = reinterpret_cast<const std::uint8_t*>(&session);
-    std::copy(data, data + sizeof(std::uint16_t), std::back_inserter(payload));
+    RequestFrame frame(BlobOEMCommands::bmcBlobCommit);
+    layout::CommitRequest::encode(frame.append<layout::CommitRequest>(),
+                                  session,
+                                  static_cast<std::uint8_t>(bytes.size()));
+    frame.putBytes(bytes);
+    submitPayload(frame, std::move(done), ignorePayload);
+}
 
-    data = reinterpret_cast<const std::uint8_t*>(&offset);
-    std::copy(data, data + sizeof(std::uint32_t), std::back_inserter(payload));
+BlobResult<void> BlobHandler::writeGeneric(BlobOEMCommands command,
+                                           std::uint16_t session,
+                                           std::uint32_t offset,
+                                           std::span<const std::uint8_t> bytes)
+{
+    RequestFrame frame(command);
+    layout::WriteRequest::encode(frame.append<layout::WriteRequest>(), session,
+                                 offset);
+    frame.putBytes(bytes);
 
-    std::copy(bytes.begin(), bytes.end(), std::back_inserter(payload));
+    IpmiReply buffer;
+    return ignorePayload(sendIpmiPayload(frame, buffer));
+}
 
-    sendIpmiPayload(command, payload);
+void BlobHandler::writeGenericAsync(BlobOEMCommands command,
+                                    std::uint16_t session,
+                                    std::uint32_t offset,
+                                    std::span<const std::uint8_t> bytes,
+                                    BlobCallback<void> done)
+{
+    RequestFrame frame(command);
+    layout::WriteRequest::encode(frame.append<layout::WriteRequest>(), session,
+                                 offset);
+    frame.putBytes(bytes);
+    submitPayload(frame, std::move(done), ignorePayload);
+}
+
+BlobResult<void> BlobHandler::tryWriteMeta(std::uint16_t session,
+                                           std::uint32_t offset,
+                                           std::span<const std::uint8_t> bytes)
+{
+    return writeGeneric(BlobOEMCommands::bmcBlobWriteMeta, session, offset,
+                        bytes);
 }
 
 void BlobHandler::writeMeta(std::uint16_t session, std::uint32_t offset,
                             const std::vector<std::uint8_t>& bytes)
 {
-    writeGeneric(BlobOEMCommands::bmcBlobWriteMeta, session, offset, bytes);
+    valueOrThrow(tryWriteMeta(session, offset, bytes));
+}
+
+void BlobHandler::writeMeta(std::uint16_t session, std::uint32_t offset,
+                            std::span<const std::uint8_t> bytes)
+{
+    valueOrThrow(tryWriteMeta(session, offset, bytes));
+}
+
+void BlobHandler::writeMetaAsync(std::uint16_t session, std::uint32_t offset,
+                                 std::span<const std::uint8_t> bytes,
+                                 BlobCallback<void> done)
+{
+    writeGenericAsync(BlobOEMCommands::bmcBlobWriteMeta, session, offset,
+                      bytes, std::move(done));
+}
+
+BlobResult<void> BlobHandler::tryWriteBytes(
+    std::uint16_t session, std::uint32_t offset,
+    std::span<const std::uint8_t> bytes)
+{
+    return writeGeneric(BlobOEMCommands::bmcBlobWrite, session, offset, bytes);
 }
 
 void BlobHandler::writeBytes(std::uint16_t session, std::uint32_t offset,
                              const std::vector<std::uint8_t>& bytes)
 {
-    writeGeneric(BlobOEMCommands::bmcBlobWrite, session, offset, bytes);
+    valueOrThrow(tryWriteBytes(session, offset, bytes));
 }
 
-std::vector<std::string> BlobHandler::getBlobList()
+void BlobHandler::writeBytes(std::uint16_t session, std::uint32_t offset,
+                             std::span<const std::uint8_t> bytes)
 {
-    std::vector<std::string> list;
-    int blobCount = getBlobCount();
+    valueOrThrow(tryWriteBytes(session, offset, bytes));
+}
+
+void BlobHandler::writeBytesAsync(std::uint16_t session, std::uint32_t offset,
+                                  std::span<const std::uint8_t> bytes,
+                                  BlobCallback<void> done)
+{
+    writeGenericAsync(BlobOEMCommands::bmcBlobWrite, session, offset, bytes,
+                      std::move(done));
+}
 
-    for (int i = 0; i < blobCount; i++)
+BlobResult<std::vector<std::string>> BlobHandler::tryGetBlobList()
+{
+    auto blobCount = tryGetBlobCount();
+    if (!blobCount)
     {
-        auto name = enumerateBlob(i);
+        return std::unexpected(blobCount.error());
+    }
+
+    std::vector<std::string> list;
+    for (std::uint32_t i = 0; i < *blobCount; i++)
+    {
+        auto name = tryEnumerateBlob(i);
         /* Currently ignore failures. */
-        if (!name.empty())
+        if (name && !name->empty())
         {
-            list.push_back(name);
+            list.push_back(std::move(*name));
         }
     }
 
     return list;
 }
 
-StatResponse BlobHandler::statGeneric(BlobOEMCommands command,
-                                      const std::vector<std::uint8_t>& request)
+std::vector<std::string> BlobHandler::getBlobList()
 {
-    StatResponse meta;
-    static constexpr std::size_t blobStateSize = sizeof(meta.blob_state);
-    static constexpr std::size_t metaSize = sizeof(meta.size);
-    static constexpr std::size_t metaOffset = blobStateSize + metaSize;
-    static constexpr std::size_t minRespSize =
-        metaOffset + sizeof(std::uint8_t);
-    std::vector<std::uint8_t> resp;
+    return tryGetBlobList().value_or(std::vector<std::string>());
+}
 
-    try
-    {
-        resp = sendIpmiPayload(command, request);
-    }
-    catch (const BlobException& b)
-    {
-        throw;
-    }
+BlobResult<StatResponse> BlobHandler::tryGetStat(const std::string& id)
+{
+    RequestFrame frame(BlobOEMCommands::bmcBlobStat);
+    frame.putString(id);
 
-    // Avoid out of bounds memcpy below
-    if (resp.size() < minRespSize)
-    {
-        std::fprintf(stderr,
-                     "Invalid response length, Got %zu which is less than "
-                     "minRespSize %zu\n",
-                     resp.size(), minRespSize);
-        throw BlobException("Invalid response length");
-    }
+    IpmiReply buffer;
+    return decodeStat(sendIpmiPayload(frame, buffer));
+}
 
-    std::memcpy(&meta.blob_state, &resp[0], blobStateSize);
-    std::memcpy(&meta.size, &resp[blobStateSize], metaSize);
-    std::uint8_t len = resp[metaOffset];
+BlobResult<void> BlobHandler::tryGetStatInto(std::string_view id,
+                                             StatResponse& stat)
+{
+    RequestFrame frame(BlobOEMCommands::bmcBlobStat);
+    frame.putString(id);
 
-    auto metaDataLength = resp.size() - minRespSize;
-    if (metaDataLength != len)
-    {
-        std::fprintf(stderr,
-                     "Metadata length did not match actual length, Got %zu "
-                     "which does not equal expected length %" PRIu8 "\n",
-                     metaDataLength, len);
-        throw BlobException("Metadata length did not match actual length");
-    }
+    IpmiReply buffer;
+    return decodeStatInto(sendIpmiPayload(frame, buffer), stat);
+}
 
-    if (len > 0)
-    {
-        meta.metadata.resize(len);
-        std::copy(resp.begin() + minRespSize, resp.end(),
-                  meta.metadata.begin());
-    }
+StatResponse BlobHandler::getStat(const std::string& id)
+{
+    return valueOrThrow(tryGetStat(id));
+}
 
-    return meta;
+void BlobHandler::getStatAsync(std::string_view id,
+                               BlobCallback<StatResponse> done)
+{
+    RequestFrame frame(BlobOEMCommands::bmcBlobStat);
+    frame.putString(id);
+    submitPayload(frame, std::move(done), decodeStat);
 }
 
-StatResponse BlobHandler::getStat(const std::string& id)
+BlobResult<StatResponse> BlobHandler::tryGetStat(std::uint16_t session)
+{
+    RequestFrame frame(BlobOEMCommands::bmcBlobSessionStat);
+    layout::SessionRequest::encode(frame.append<layout::SessionRequest>(),
+                                   session);
+
+    IpmiReply buffer;
+    return decodeStat(sendIpmiPayload(frame, buffer));
+}
+
+BlobResult<void> BlobHandler::tryGetStatInto(std::uint16_t session,
+                                             StatResponse& stat)
 {
-    std::vector<std::uint8_t> name;
-    std::copy(id.begin(), id.end(), std::back_inserter(name));
-    name.push_back(0x00); /* need to add nul-terminator. */
+    RequestFrame frame(BlobOEMCommands::bmcBlobSessionStat);
+    layout::SessionRequest::encode(frame.append<layout::SessionRequest>(),
+                                   session);
 
-    return statGeneric(BlobOEMCommands::bmcBlobStat, name);
+    IpmiReply buffer;
+    return decodeStatInto(sendIpmiPayload(frame, buffer), stat);
 }
 
 StatResponse BlobHandler::getStat(std::uint16_t session)
 {
-    std::vector<std::uint8_t> request;
-    auto addrSession = reinterpret_cast<const std::uint8_t*>(&session);
-    std::copy(addrSession, addrSession + sizeof(session),
-              std::back_inserter(request));
+    return valueOrThrow(tryGetStat(session));
+}
 
-    return statGeneric(BlobOEMCommands::bmcBlobSessionStat, request);
+void BlobHandler::getStatAsync(std::uint16_t session,
+                               BlobCallback<StatResponse> done)
+{
+    RequestFrame frame(BlobOEMCommands::bmcBlobSessionStat);
+    layout::SessionRequest::encode(frame.append<layout::SessionRequest>(),
+                                   session);
+    submitPayload(frame, std::move(done), decodeStat);
+}
+
+BlobResult<std::uint16_t> BlobHandler::tryOpenBlob(const std::string& id,
+                                                   std::uint16_t handlerFlags)
+{
+    RequestFrame frame(BlobOEMCommands::bmcBlobOpen);
+    layout::OpenRequest::encode(frame.append<layout::OpenRequest>(),
+                                handlerFlags);
+    frame.putString(id);
+
+    IpmiReply buffer;
+    return decodeSession(sendIpmiPayload(frame, buffer));
 }
 
 std::uint16_t BlobHandler::openBlob(const std::string& id,
                                     std::uint16_t handlerFlags)
 {
-    std::uint16_t session;
-    std::vector<std::uint8_t> request, resp;
-    auto addrFlags = reinterpret_cast<const std::uint8_t*>(&handlerFlags);
+    return valueOrThrow(tryOpenBlob(id, handlerFlags));
+}
 
-    std::copy(addrFlags, addrFlags + sizeof(handlerFlags),
-              std::back_inserter(request));
-    std::copy(id.begin(), id.end(), std::back_inserter(request));
-    request.push_back(0x00); /* need to add nul-terminator. */
+void BlobHandler::openBlobAsync(std::string_view id,
+                                std::uint16_t handlerFlags,
+                                BlobCallback<std::uint16_t> done)
+{
+    RequestFrame frame(BlobOEMCommands::bmcBlobOpen);
+    layout::OpenRequest::encode(frame.append<layout::OpenRequest>(),
+                                handlerFlags);
+    frame.putString(id);
+    submitPayload(frame, std::move(done), decodeSession);
+}
 
-    try
-    {
-        resp = sendIpmiPayload(BlobOEMCommands::bmcBlobOpen, request);
-    }
-    catch (const BlobException& b)
+BlobResult<void> BlobHandler::tryCloseBlob(std::uint16_t session)
+{
+    RequestFrame frame(BlobOEMCommands::bmcBlobClose);
+    layout::SessionRequest::encode(frame.append<layout::SessionRequest>(),
+                                   session);
+
+    IpmiReply buffer;
+    return ignorePayload(sendIpmiPayload(frame, buffer));
+}
+
+void BlobHandler::closeBlob(std::uint16_t session)
+{
+    auto closed = tryCloseBlob(session);
+    if (!closed)
     {
-        throw;
+        std::fprintf(stderr, "Received failure on close: %s\n",
+                     closed.error().message().c_str());
     }
+}
+
+void BlobHandler::closeBlobAsync(std::uint16_t session,
+                                 BlobCallback<void> done)
+{
+    RequestFrame frame(BlobOEMCommands::bmcBlobClose);
+    layout::SessionRequest::encode(frame.append<layout::SessionRequest>(),
+                                   session);
+    submitPayload(frame, std::move(done), ignorePayload);
+}
+
+BlobResult<void> BlobHandler::tryDeleteBlob(const std::string& id)
+{
+    RequestFrame frame(BlobOEMCommands::bmcBlobDelete);
+    frame.putString(id);
+
+    IpmiReply buffer;
+    return ignorePayload(sendIpmiPayload(frame, buffer));
+}
 
-    if (resp.size() != sizeof(session))
+bool BlobHandler::deleteBlob(const std::string& id)
+{
+    auto deleted = tryDeleteBlob(id);
+    if (!deleted)
     {
-        throw BlobException("Did not receive session.");
+        std::fprintf(stderr, "Received failure on delete: %s\n",
+                     deleted.error().message().c_str());
+        return false;
     }
+    return true;
+}
 
-    std::memcpy(&session, resp.data(), sizeof(session));
-    return session;
+void BlobHandler::deleteBlobAsync(std::string_view id, BlobCallback<void> done)
+{
+    RequestFrame frame(BlobOEMCommands::bmcBlobDelete);
+    frame.putString(id);
+    submitPayload(frame, std::move(done), ignorePayload);
 }
 
-void BlobHandler::closeBlob(std::uint16_t session)
+BlobResult<std::vector<std::uint8_t>> BlobHandler::tryReadBytes(
+    std::uint16_t session, std::uint32_t offset, std::uint32_t length)
+{
+    RequestFrame frame(BlobOEMCommands::bmcBlobRead);
+    layout::ReadRequest::encode(frame.append<layout::ReadRequest>(), session,
+                                offset, length);
+
+    IpmiReply buffer;
+    return copyPayload(sendIpmiPayload(frame, buffer));
+}
+
+std::vector<std::uint8_t> BlobHandler::readBytes(
+    std::uint16_t session, std::uint32_t offset, std::uint32_t length)
+{
+    return valueOrThrow(tryReadBytes(session, offset, length));
+}
+
+void BlobHandler::readBytesAsync(std::uint16_t session, std::uint32_t offset,
+                                 std::uint32_t length,
+                                 BlobCallback<std::vector<std::uint8_t>> done)
+{
+    RequestFrame frame(BlobOEMCommands::bmcBlobRead);
+    layout::ReadRequest::encode(frame.append<layout::ReadRequest>(), session,
+                                offset, length);
+    submitPayload(frame, std::move(done), copyPayload);
+}
+
+BlobResult<std::size_t> BlobHandler::tryReadBytes(std::uint16_t session,
+                                                  std::uint32_t offset,
+                                                  std::span<std::uint8_t> out)
 {
-    std::vector<std::uint8_t> request;
-    auto addrSession = reinterpret_cast<const std::uint8_t*>(&session);
-    std::copy(addrSession, addrSession + sizeof(session),
-              std::back_inserter(request));
+    if (out.size() > std::numeric_limits<std::uint32_t>::max())
+    {
+        out = out.first(std::numeric_limits<std::uint32_t>::max());
+    }
 
-    try
+    RequestFrame frame(BlobOEMCommands::bmcBlobRead);
+    layout::ReadRequest::encode(frame.append<layout::ReadRequest>(), session,
+                                offset, static_cast<std::uint32_t>(out.size()));
+
+    IpmiReply buffer;
+    auto resp = sendIpmiPayload(frame, buffer);
+    if (!resp)
     {
-        sendIpmiPayload(BlobOEMCommands::bmcBlobClose, request);
+        return std::unexpected(resp.error());
     }
-    catch (const BlobException& b)
+
+    if (resp->size() > out.size())
     {
-        std::fprintf(stderr, "Received failure on close: %s\n", b.what());
+        return std::unexpected("Read returned more bytes than requested");
     }
+
+    std::copy(resp->begin(), resp->end(), out.begin());
+    return resp->size();
 }
 
-bool BlobHandler::deleteBlob(const std::string& id)
+std::size_t BlobHandler::readBytes(std::uint16_t session, std::uint32_t offset,
+                                   std::span<std::uint8_t> out)
 {
-    std::vector<std::uint8_t> name;
-    std::copy(id.begin(), id.end(), std::back_inserter(name));
-    name.push_back(0x00); /* need to add nul-terminator. */
+    return valueOrThrow(tryReadBytes(session, offset, out));
+}
 
-    try
+BlobResult<PayloadLimits> BlobHandler::tryProbePayloadLimits(
+    std::uint16_t session, std::span<const std::uint8_t> upcoming)
+{
+    auto stat = tryGetStat(session);
+    if (!stat)
     {
-        sendIpmiPayload(BlobOEMCommands::bmcBlobDelete, name);
-        return true;
+        return std::unexpected(stat.error());
     }
-    catch (const BlobException& b)
+
+    constexpr std::size_t mostWritten =
+        maxPayloadSize(BlobOEMCommands::bmcBlobWrite);
+    constexpr std::size_t mostRead =
+        maxPayloadSize(BlobOEMCommands::bmcBlobRead);
+
+    PayloadLimits found = limits;
+    if ((stat->blob_state & open_write) && upcoming.size() >= mostWritten)
     {
-        std::fprintf(stderr, "Received failure on delete: %s\n", b.what());
+        /* Only the caller's own bytes, so the blob ends up as it would
+         * without the probe.
+         */
+        auto write = largestAccepted(
+            mostWritten, [&](std::size_t size) -> BlobResult<std::size_t> {
+                auto sent = tryWriteBytes(session, 0, upcoming.first(size));
+                if (!sent)
+                {
+                    return std::unexpected(sent.error());
+                }
+                return size;
+            });
+        if (!write)
+        {
+            return std::unexpected(write.error());
+        }
+        found.write = *write;
     }
-    return false;
+    if ((stat->blob_state & open_read) && stat->size >= mostRead)
+    {
+        std::array<std::uint8_t, layout::maxReadPayload> scratch;
+        auto read = largestAccepted(mostRead, [&](std::size_t size) {
+            return tryReadBytes(session, 0, std::span(scratch).first(size));
+        });
+        if (!read)
+        {
+            return std::unexpected(read.error());
+        }
+        found.read = *read;
+    }
+
+    limits = found;
+    return found;
 }
 
-std::vector<std::uint8_t> BlobHandler::readBytes(
-    std::uint16_t session, std::uint32_t offset, std::uint32_t length)
+void BlobHandler::setPayloadLimits(const PayloadLimits& found)
 {
-    std::vector<std::uint8_t> payload;
+    limits.write = std::clamp<std::size_t>(
+        found.write, 1, maxPayloadSize(BlobOEMCommands::bmcBlobWrite));
+    limits.read = std::clamp<std::size_t>(
+        found.read, 1, maxPayloadSize(BlobOEMCommands::bmcBlobRead));
+}
+
+BlobResult<std::uint32_t> BlobHandler::tryUploadFile(std::uint16_t session,
+                                                     const std::string& path)
+{
+    /* Pages sent are dropped from the mapping in steps of this many. */
+    constexpr std::size_t releasePages = 256;
 
-    payload.reserve(
-        sizeof(std::uint16_t) + sizeof(std::uint32_t) + sizeof(std::uint32_t));
+    int fd = sys->open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return std::unexpected("Unable to open file to upload");
+    }
 
-    auto data = reinterpret_cast<const std::uint8_t*>(&session);
-    std::copy(data, data + sizeof(std::uint16_t), std::back_inserter(payload));
+    struct stat info;
+    if (sys->fstat(fd, &info) < 0)
+    {
+        sys->close(fd);
+        return std::unexpected("Unable to stat file to upload");
+    }
+    if (info.st_size > std::numeric_limits<std::uint32_t>::max())
+    {
+        sys->close(fd);
+        return std::unexpected("File too large for a blob");
+    }
 
-    data = reinterpret_cast<const std::uint8_t*>(&offset);
-    std::copy(data, data + sizeof(std::uint32_t), std::back_inserter(payload));
+    auto size = static_cast<std::size_t>(info.st_size);
+    if (size == 0)
+    {
+        sys->close(fd);
+        return 0;
+    }
 
-    data = reinterpret_cast<const std::uint8_t*>(&length);
-    std::copy(data, data + sizeof(std::uint32_t), std::back_inserter(payload));
+    /* The mapping holds its own reference to the file. */
+    void* base = sys->mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    sys->close(fd);
+    if (base == MAP_FAILED)
+    {
+        return std::unexpected("Unable to map file to upload");
+    }
+
+    /* Only hints, so a failure is no reason to stop. */
+    sys->madvise(base, size, MADV_SEQUENTIAL);
+
+    std::span<const std::uint8_t> image(static_cast<std::uint8_t*>(base),
+                                        size);
+    auto page = static_cast<std::size_t>(std::max(sys->getpagesize(), 1));
+    std::size_t released = 0;
+    BlobResult<std::uint32_t> result;
+    std::size_t offset = 0;
+    while (offset < size)
+    {
+        std::size_t length = std::min(limits.write, size - offset);
+        auto written =
+            tryWriteBytes(session, static_cast<std::uint32_t>(offset),
+                          image.subspan(offset, length));
+        if (!written)
+        {
+            result = std::unexpected(written.error());
+            break;
+        }
+        offset += length;
+
+        /* Drop the pages behind, so that the upload stays resident only in
+         * the page cache however large the file.
+         */
+        std::size_t sent = offset / page * page;
+        if (sent - released >= releasePages * page)
+        {
+            sys->madvise(static_cast<std::uint8_t*>(base) + released,
+                         sent - released, MADV_DONTNEED);
+            released = sent;
+        }
+    }
 
-    return sendIpmiPayload(BlobOEMCommands::bmcBlobRead, payload);
+    sys->munmap(base, size);
+    if (result)
+    {
+        result = static_cast<std::uint32_t>(offset);
+    }
+    return result;
+}
+
+BlobResult<std::uint32_t> BlobHandler::tryReadBlob(std::uint16_t session,
+                                                   BlobSink& sink)
+{
+    auto stat = tryGetStat(session);
+    if (!stat)
+    {
+        return std::unexpected(stat.error());
+    }
+
+    /* The one buffer the read uses, whatever the size of the blob. */
+    IpmiReply buffer;
+    std::uint32_t offset = 0;
+    while (offset < stat->size)
+    {
+        auto wanted = static_cast<std::uint32_t>(
+            std::min<std::size_t>(limits.read, stat->size - offset));
+        RequestFrame frame(BlobOEMCommands::bmcBlobRead);
+        layout::ReadRequest::encode(frame.append<layout::ReadRequest>(),
+                                    session, offset, wanted);
+
+        auto resp = sendIpmiPayload(frame, buffer);
+        if (!resp)
+        {
+            return std::unexpected(resp.error());
+        }
+        if (resp->size() > wanted)
+        {
+            return std::unexpected("Read returned more bytes than requested");
+        }
+        if (resp->empty())
+        {
+            return std::unexpected("Blob ended before its reported size");
+        }
+
+        auto written = sink.write(*resp);
+        if (!written)
+        {
+            return std::unexpected(written.error());
+        }
+        offset += static_cast<std::uint32_t>(resp->size());
+    }
+
+    if (auto finished = sink.finish(); !finished)
+    {
+        return std::unexpected(finished.error());
+    }
+    return offset;
 }
 
 } // namespace ipmiblob
@@ -1,13 +1,24 @@
 #pragma once
 
 #include "blob_interface.hpp"
+#include "internal/sys.hpp"
 #include "ipmi_interface.hpp"
 
+#include <functional>
 #include <memory>
+#include <span>
+#include <string>
+#include <string_view>
 
 namespace ipmiblob
 {
 
+/**
+ * Receives the outcome of an asynchronous blob operation.
+ */
+template <typename T>
+using BlobCallback = std::function<void(BlobResult<T>)>;
+
 class BlobHandler : public BlobInterface
 {
   public:
@@ -20,8 +31,14 @@ class BlobHandler : public BlobInterface
     static std::unique_ptr<BlobInterface> CreateBlobHandler(
         std::unique_ptr<IpmiInterface> ipmi);
 
-    explicit BlobHandler(std::unique_ptr<IpmiInterface> ipmi) :
-        ipmi(std::move(ipmi)) {};
+    /**
+     * @param[in] ipmi - the transport to send requests over.
+     * @param[in] sys - the system calls uploadFile() maps files with.
+     */
+    explicit BlobHandler(std::unique_ptr<IpmiInterface> ipmi,
+                         std::unique_ptr<internal::Sys> sys =
+                             std::make_unique<internal::SysImpl>()) :
+        ipmi(std::move(ipmi)), sys(std::move(sys)) {};
 
     ~BlobHandler() = default;
     BlobHandler(const BlobHandler&) = delete;
@@ -36,6 +53,13 @@ class BlobHandler : public BlobInterface
      */
     int getBlobCount();
 
+    /**
+     * Retrieve the blob count, reporting failure by value.
+     *
+     * @return the number of blob_ids found.
+     */
+    BlobResult<std::uint32_t> tryGetBlobCount();
+
     /**
      * Given an index into the list of blobs, return the name.
      *
@@ -44,24 +68,55 @@ class BlobHandler : public BlobInterface
      */
     std::string enumerateBlob(std::uint32_t index);
 
+    /**
+     * Given an index into the list of blobs, return the name, reporting
+     * failure by value.
+     *
+     * @param[in] index - the index into the list of blob ids.
+     * @return the name.
+     */
+    BlobResult<std::string> tryEnumerateBlob(std::uint32_t index);
+
+    using BlobInterface::commit;
+
     /**
      * @throws BlobException.
      */
     void commit(std::uint16_t session,
                 const std::vector<std::uint8_t>& bytes = {}) override;
 
+    /**
+     * @throws BlobException.
+     */
+    void commit(std::uint16_t session,
+                std::span<const std::uint8_t> bytes) override;
+
     /**
      * @throws BlobException.
      */
     void writeMeta(std::uint16_t session, std::uint32_t offset,
                    const std::vector<std::uint8_t>& bytes) override;
 
+    /**
+     * @throws BlobException.
+     */
+    void writeMeta(std::uint16_t session, std::uint32_t offset,
+                   std::span<const std::uint8_t> bytes) override;
+
     /**
      * @throw BlobException.
      */
     void writeBytes(std::uint16_t session, std::uint32_t offset,
                     const std::vector<std::uint8_t>& bytes) override;
 
+    /**
+     * Frames the chunk straight from the caller's memory.
+     *
+     * @throw BlobException.
+     */
+    void writeBytes(std::uint16_t session, std::uint32_t offset,
+                    std::span<const std::uint8_t> bytes) override;
+
     std::vector<std::string> getBlobList() override;
 
     /**
@@ -91,18 +146,168 @@ class BlobHandler : public BlobInterface
                                         std::uint32_t offset,
                                         std::uint32_t length) override;
 
-  private:
     /**
-     * Send the contents of the payload to IPMI, this method handles wrapping
-     * with the OEN, subcommand and CRC.
+     * Reads without allocating, copying the reply once into out.
      *
-     * @param[in] command - the blob command.
-     * @param[in] payload - the payload bytes.
-     * @return the bytes returned from the ipmi interface.
      * @throws BlobException.
      */
-    std::vector<std::uint8_t> sendIpmiPayload(
-        BlobOEMCommands command, const std::vector<std::uint8_t>& payload);
+    std::size_t readBytes(std::uint16_t session, std::uint32_t offset,
+                          std::span<std::uint8_t> out) override;
+
+    /**
+     * Find how many data bytes the BMC takes in one write and one read of an
+     * open session, by binary search down from maxPayloadSize(), taking a
+     * "request data length" completion code, or a read reply shorter than
+     * asked, to mean too long.  The limits found are kept, and readBlob()
+     * and uploadFile() chunk to them from then on.
+     *
+     * Writes are only probed if the session is open for writing and upcoming
+     * holds at least maxPayloadSize(bmcBlobWrite) bytes, written at offset 0
+     * in prefixes of it; reads only if the session is open for reading and
+     * at least maxPayloadSize(bmcBlobRead) bytes long.  A limit not probed
+     * stays as it was.
+     *
+     * @param[in] session - the session id.
+     * @param[in] upcoming - the bytes about to be written at the start of
+     *     the session, if any.
+     * @return the limits found.
+     */
+    BlobResult<PayloadLimits> tryProbePayloadLimits(
+        std::uint16_t session, std::span<const std::uint8_t> upcoming = {});
+
+    /**
+     * @return the limits readBlob() and uploadFile() chunk to: those probed
+     *     or set, or by default the most maxPayloadSize() allows.
+     */
+    PayloadLimits payloadLimits() const
+    {
+        return limits;
+    }
+
+    /**
+     * Use limits probed earlier for the same BMC, say by another handler,
+     * instead of probing again.  Each is kept between one byte and the most
+     * maxPayloadSize() allows.
+     */
+    void setPayloadLimits(const PayloadLimits& found);
+
+    /* The non-throwing operations below are the primary implementation; the
+     * throwing ones above wrap them.
+     */
+    BlobResult<void> tryCommit(std::uint16_t session,
+                               std::span<const std::uint8_t> bytes) override;
+
+    BlobResult<void> tryWriteMeta(
+        std::uint16_t session, std::uint32_t offset,
+        std::span<const std::uint8_t> bytes) override;
+
+    BlobResult<void> tryWriteBytes(
+        std::uint16_t session, std::uint32_t offset,
+        std::span<const std::uint8_t> bytes) override;
+
+    BlobResult<std::vector<std::string>> tryGetBlobList() override;
+
+    BlobResult<StatResponse> tryGetStat(const std::string& id) override;
+
+    BlobResult<StatResponse> tryGetStat(std::uint16_t session) override;
+
+    /**
+     * Encodes the id straight into the request and decodes the reply into
+     * stat; a poll on an open handler does not touch the heap once the
+     * metadata fits.
+     */
+    BlobResult<void> tryGetStatInto(std::string_view id,
+                                    StatResponse& stat) override;
+
+    BlobResult<void> tryGetStatInto(std::uint16_t session,
+                                    StatResponse& stat) override;
+
+    BlobResult<std::uint16_t> tryOpenBlob(const std::string& id,
+                                          std::uint16_t handlerFlags) override;
+
+    BlobResult<void> tryCloseBlob(std::uint16_t session) override;
+
+    BlobResult<void> tryDeleteBlob(const std::string& id) override;
+
+    BlobResult<std::vector<std::uint8_t>> tryReadBytes(
+        std::uint16_t session, std::uint32_t offset,
+        std::uint32_t length) override;
+
+    BlobResult<std::size_t> tryReadBytes(std::uint16_t session,
+                                         std::uint32_t offset,
+                                         std::span<std::uint8_t> out) override;
+
+    /**
+     * Reads in chunks of payloadLimits().read, handing each to the sink
+     * straight from the IPMI reply buffer, so the bytes are not copied on
+     * the way.
+     */
+    BlobResult<std::uint32_t> tryReadBlob(std::uint16_t session,
+                                          BlobSink& sink) override;
+
+    /**
+     * Uploads in chunks of payloadLimits().write.  The file is mapped
+     * read-only and each chunk framed straight from the mapping, so nothing
+     * is copied into the process; pages already sent are dropped from the
+     * mapping as the upload goes.
+     */
+    BlobResult<std::uint32_t> tryUploadFile(std::uint16_t session,
+                                            const std::string& path) override;
+
+    /*
+     * Asynchronous variants, built on IpmiInterface::submit().  Each returns
+     * as soon as the request is handed over, and done is called exactly once
+     * with the outcome, from wherever the transport completes requests (for
+     * IpmiHandler, processReadable()).  Bytes and ids are only read during
+     * the call.
+     */
+
+    void getBlobCountAsync(BlobCallback<std::uint32_t> done);
+
+    void enumerateBlobAsync(std::uint32_t index,
+                            BlobCallback<std::string> done);
+
+    void commitAsync(std::uint16_t session,
+                     std::span<const std::uint8_t> bytes,
+                     BlobCallback<void> done);
+
+    void writeMetaAsync(std::uint16_t session, std::uint32_t offset,
+                        std::span<const std::uint8_t> bytes,
+                        BlobCallback<void> done);
+
+    void writeBytesAsync(std::uint16_t session, std::uint32_t offset,
+                         std::span<const std::uint8_t> bytes,
+                         BlobCallback<void> done);
+
+    void getStatAsync(std::string_view id, BlobCallback<StatResponse> done);
+
+    void getStatAsync(std::uint16_t session, BlobCallback<StatResponse> done);
+
+    void openBlobAsync(std::string_view id, std::uint16_t handlerFlags,
+                       BlobCallback<std::uint16_t> done);
+
+    void closeBlobAsync(std::uint16_t session, BlobCallback<void> done);
+
+    void deleteBlobAsync(std::string_view id, BlobCallback<void> done);
+
+    void readBytesAsync(std::uint16_t session, std::uint32_t offset,
+                        std::uint32_t length,
+                        BlobCallback<std::vector<std::uint8_t>> done);
+
+  private:
+    /* Fixed size request buffer, built without touching the heap. */
+    class RequestFrame;
+
+    /**
+     * Send a request to IPMI and unwrap the response: this method fills in
+     * the request CRC, then checks the OEN and CRC of the reply.
+     *
+     * @param[in] frame - the request, carrying the OEN, subcommand and payload.
+     * @param[in] buffer - where to receive the reply.
+     * @return the payload bytes returned, as a view into buffer.
+     */
+    BlobResult<std::span<const std::uint8_t>> sendIpmiPayload(
+        RequestFrame& frame, IpmiReply& buffer);
 
     /**
      * Generic blob byte writer.
@@ -111,27 +316,32 @@ class BlobHandler : public BlobInterface
      * @param[in] session - the session id.
      * @param[in] offset - the offset for the metadata to write.
      * @param[in] bytes - the bytes to send.
-     * @throws BlobException on failure.
      */
-    void writeGeneric(BlobOEMCommands command, std::uint16_t session,
-                      std::uint32_t offset,
-                      const std::vector<std::uint8_t>& bytes);
+    BlobResult<void> writeGeneric(BlobOEMCommands command,
+                                  std::uint16_t session, std::uint32_t offset,
+                                  std::span<const std::uint8_t> bytes);
 
     /**
-     * Generic stat reader.
+     * Submit a request and call done with its reply once it arrives, after
+     * checking the OEN and CRC and running the payload through decode.
      *
-     * @param[in] command - the command associated with this write.
-     * @param[in] request - the bytes of the request
-     * @return the metadata StatResponse
-     * @throws BlobException on failure.
+     * @param[in] frame - the request, carrying the OEN, subcommand and payload.
+     * @param[in] done - the completion callback.
+     * @param[in] decode - turns the checked payload into a BlobResult<T>.
      */
-    StatResponse statGeneric(BlobOEMCommands command,
-                             const std::vector<std::uint8_t>& request);
+    template <typename T, typename Decode>
+    void submitPayload(RequestFrame& frame, BlobCallback<T> done,
+                       Decode decode);
+
+    /* writeGeneric(), asynchronously. */
+    void writeGenericAsync(BlobOEMCommands command, std::uint16_t session,
+                           std::uint32_t offset,
+                           std::span<const std::uint8_t> bytes,
+                           BlobCallback<void> done);
 
     std::unique_ptr<IpmiInterface> ipmi;
+    std::unique_ptr<internal::Sys> sys;
+    PayloadLimits limits;
 };
 
-constexpr int ipmiOEMNetFn = 46;
-constexpr int ipmiOEMBlobCmd = 128;
-
 } // namespace ipmiblob
@@ -0,0 +1,73 @@
+#include "blob_interface.hpp"
+
+#include "internal/sys.hpp"
+
+#include <fcntl.h>
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <expected>
+#include <limits>
+#include <span>
+#include <string>
+
+namespace ipmiblob
+{
+
+BlobResult<std::uint32_t> BlobInterface::tryUploadFile(std::uint16_t session,
+                                                       const std::string& path)
+{
+    const internal::SysImpl sys;
+    int fd = sys.open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return std::unexpected("Unable to open file to upload");
+    }
+
+    std::array<std::uint8_t, layout::maxWritePayload> chunk;
+    BlobResult<std::uint32_t> result;
+    std::uint64_t offset = 0;
+    while (true)
+    {
+        int got = sys.read(fd, chunk.data(), chunk.size());
+        if (got < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (got < 0)
+        {
+            result = std::unexpected("Unable to read file to upload");
+            break;
+        }
+        if (got == 0)
+        {
+            break;
+        }
+        auto length = static_cast<std::size_t>(got);
+        if (offset + length > std::numeric_limits<std::uint32_t>::max())
+        {
+            result = std::unexpected("File too large for a blob");
+            break;
+        }
+
+        auto written =
+            tryWriteBytes(session, static_cast<std::uint32_t>(offset),
+                          std::span(chunk).first(length));
+        if (!written)
+        {
+            result = std::unexpected(written.error());
+            break;
+        }
+        offset += length;
+    }
+
+    sys.close(fd);
+    if (result)
+    {
+        result = static_cast<std::uint32_t>(offset);
+    }
+    return result;
+}
+
+} // namespace ipmiblob
@@ -1,7 +1,20 @@
 #pragma once
 
+#include "blob_errors.hpp"
+#include "blob_layout.hpp"
+#include "blob_sink.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <expected>
+#include <initializer_list>
+#include <limits>
+#include <span>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
 namespace ipmiblob
@@ -44,6 +57,66 @@ struct StatResponse
     }
 };
 
+/**
+ * @return the most data bytes one request of this command can carry in an
+ *     IPMI message after the blob framing, or for bmcBlobRead and
+ *     bmcBlobEnumerate the most its reply can; strings count without their
+ *     nul-terminator.  0 for commands that carry no data.
+ */
+constexpr std::size_t maxPayloadSize(BlobOEMCommands command)
+{
+    using namespace layout;
+
+    constexpr std::size_t request = maxMessage - RequestHeader::size;
+    switch (command)
+    {
+        case BlobOEMCommands::bmcBlobRead:
+            return maxReadPayload;
+        case BlobOEMCommands::bmcBlobEnumerate:
+            return maxReadPayload - 1;
+        case BlobOEMCommands::bmcBlobWrite:
+        case BlobOEMCommands::bmcBlobWriteMeta:
+            return maxWritePayload;
+        case BlobOEMCommands::bmcBlobCommit:
+            /* The length field is a single byte. */
+            return std::min<std::size_t>(
+                request - CommitRequest::size,
+                std::numeric_limits<std::uint8_t>::max());
+        case BlobOEMCommands::bmcBlobOpen:
+            return request - OpenRequest::size - 1;
+        case BlobOEMCommands::bmcBlobStat:
+        case BlobOEMCommands::bmcBlobDelete:
+            return request - 1;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * How many data bytes a BMC takes in one blob request, which may be fewer
+ * than maxPayloadSize() allows.
+ */
+struct PayloadLimits
+{
+    /* Data bytes in one bmcBlobWrite or bmcBlobWriteMeta request. */
+    std::size_t write = maxPayloadSize(BlobOEMCommands::bmcBlobWrite);
+    /* Data bytes asked for in one bmcBlobRead request. */
+    std::size_t read = maxPayloadSize(BlobOEMCommands::bmcBlobRead);
+
+    bool operator==(const PayloadLimits&) const = default;
+};
+
+/**
+ * The blob commands, synchronous and throwing, with try* variants that report
+ * failure by value.
+ *
+ * commit(), writeMeta(), writeBytes() and readBytes() each come as a vector
+ * overload, which must be implemented, and a span overload that copies
+ * through it unless overridden.  A subclass that overrides only one of a pair
+ * hides the other, so it should bring the base's back in scope:
+ *
+ *     using BlobInterface::writeBytes;
+ */
 class BlobInterface
 {
   public:
@@ -59,6 +132,27 @@ class BlobInterface
     virtual void commit(std::uint16_t session,
                         const std::vector<std::uint8_t>& bytes) = 0;
 
+    /**
+     * Call commit on a blob, with the bytes in caller-owned memory.  The
+     * default implementation copies them into a vector for commit() above.
+     *
+     * @param[in] session - the session id.
+     * @param[in] bytes - the bytes to send.
+     * @throws BlobException on failure.
+     */
+    virtual void commit(std::uint16_t session,
+                        std::span<const std::uint8_t> bytes)
+    {
+        commit(session, std::vector<std::uint8_t>(bytes.begin(), bytes.end()));
+    }
+
+    /* Keeps commit(session, {}) unambiguous between the overloads above. */
+    void commit(std::uint16_t session,
+                std::initializer_list<std::uint8_t> bytes)
+    {
+        commit(session, std::vector<std::uint8_t>(bytes));
+    }
+
     /**
      * Write metadata to a blob.
      *
@@ -70,6 +164,22 @@ class BlobInterface
     virtual void writeMeta(std::uint16_t session, std::uint32_t offset,
                            const std::vector<std::uint8_t>& bytes) = 0;
 
+    /**
+     * Write metadata to a blob from caller-owned memory.  The default
+     * implementation copies the bytes into a vector for writeMeta() above.
+     *
+     * @param[in] session - the session id.
+     * @param[in] offset - the offset for the metadata to write.
+     * @param[in] bytes - the bytes to send.
+     * @throws BlobException on failure.
+     */
+    virtual void writeMeta(std::uint16_t session, std::uint32_t offset,
+                           std::span<const std::uint8_t> bytes)
+    {
+        writeMeta(session, offset,
+                  std::vector<std::uint8_t>(bytes.begin(), bytes.end()));
+    }
+
     /**
      * Write bytes to a blob.
      *
@@ -81,6 +191,23 @@ class BlobInterface
     virtual void writeBytes(std::uint16_t session, std::uint32_t offset,
                             const std::vector<std::uint8_t>& bytes) = 0;
 
+    /**
+     * Write bytes to a blob from caller-owned memory, such as a slice of a
+     * mapped image.  The default implementation copies the bytes into a
+     * vector for writeBytes() above.
+     *
+     * @param[in] session - the session id.
+     * @param[in] offset - the offset to which to write the bytes.
+     * @param[in] bytes - the bytes to send.
+     * @throws BlobException on failure.
+     */
+    virtual void writeBytes(std::uint16_t session, std::uint32_t offset,
+                            std::span<const std::uint8_t> bytes)
+    {
+        writeBytes(session, offset,
+                   std::vector<std::uint8_t>(bytes.begin(), bytes.end()));
+    }
+
     /**
      * Get a list of the blob_ids provided by the BMC.
      *
@@ -140,6 +267,276 @@ class BlobInterface
      */
     virtual std::vector<std::uint8_t> readBytes(
         std::uint16_t session, std::uint32_t offset, std::uint32_t length) = 0;
+
+    /**
+     * Read bytes from a blob into a caller-owned buffer.  Up to out.size()
+     * bytes are requested.  The default implementation copies out of the
+     * vector returned by readBytes() above.
+     *
+     * @param[in] session - the session id.
+     * @param[in] offset - the offset from which to read the bytes.
+     * @param[out] out - where to place the bytes read.
+     * @return the number of bytes read, which may be short of out.size().
+     * @throws BlobException on failure.
+     */
+    virtual std::size_t readBytes(std::uint16_t session, std::uint32_t offset,
+                                  std::span<std::uint8_t> out)
+    {
+        std::vector<std::uint8_t> bytes =
+            readBytes(session, offset, static_cast<std::uint32_t>(out.size()));
+        if (bytes.size() > out.size())
+        {
+            throw BlobException("Read returned more bytes than requested");
+        }
+
+        std::copy(bytes.begin(), bytes.end(), out.begin());
+        return bytes.size();
+    }
+
+    /**
+     * Read a whole blob into sink, from the start to the size its session
+     * stat reports, in the largest chunks an IPMI message carries.  Only one
+     * chunk is held at a time, so memory stays flat however large the blob.
+     *
+     * @param[in] session - the session id.
+     * @param[in] sink - where to put the bytes.
+     * @return the number of bytes read.
+     * @throws BlobException on failure, including one from the sink.
+     */
+    std::uint32_t readBlob(std::uint16_t session, BlobSink& sink)
+    {
+        auto read = tryReadBlob(session, sink);
+        if (!read)
+        {
+            throw BlobException(read.error());
+        }
+
+        return *read;
+    }
+
+    /**
+     * Write a whole file to a blob, from offset 0, in chunks no larger than
+     * one bmcBlobWrite carries.
+     *
+     * @param[in] session - the session id.
+     * @param[in] path - the file to upload.
+     * @return the number of bytes written.
+     * @throws BlobException on failure.
+     */
+    std::uint32_t uploadFile(std::uint16_t session, const std::string& path)
+    {
+        auto uploaded = tryUploadFile(session, path);
+        if (!uploaded)
+        {
+            throw BlobException(uploaded.error());
+        }
+
+        return *uploaded;
+    }
+
+    /*
+     * Non-throwing variants of the operations above.  Each reports failure as
+     * a BlobError, which carries the IPMI completion code when the BMC
+     * rejected the request, so a retry loop never has to unwind an exception.
+     *
+     * Implementations should override these and wrap them for the throwing
+     * API.  The defaults here run the throwing call and catch its
+     * BlobException, so they only keep the completion code of a failure.
+     */
+
+    virtual BlobResult<void> tryCommit(std::uint16_t session,
+                                       std::span<const std::uint8_t> bytes)
+    {
+        return catchBlobException([&] { commit(session, bytes); });
+    }
+
+    virtual BlobResult<void> tryWriteMeta(std::uint16_t session,
+                                          std::uint32_t offset,
+                                          std::span<const std::uint8_t> bytes)
+    {
+        return catchBlobException([&] { writeMeta(session, offset, bytes); });
+    }
+
+    virtual BlobResult<void> tryWriteBytes(std::uint16_t session,
+                                           std::uint32_t offset,
+                                           std::span<const std::uint8_t> bytes)
+    {
+        return catchBlobException([&] { writeBytes(session, offset, bytes); });
+    }
+
+    virtual BlobResult<std::vector<std::string>> tryGetBlobList()
+    {
+        return catchBlobException([&] { return getBlobList(); });
+    }
+
+    virtual BlobResult<StatResponse> tryGetStat(const std::string& id)
+    {
+        return catchBlobException([&] { return getStat(id); });
+    }
+
+    virtual BlobResult<StatResponse> tryGetStat(std::uint16_t session)
+    {
+        return catchBlobException([&] { return getStat(session); });
+    }
+
+    /**
+     * Stat a blob into stat, reusing the capacity of its metadata, so polling
+     * with the same StatResponse need not allocate.  The default
+     * implementations call tryGetStat().
+     *
+     * @param[in] id - the blob_id.
+     * @param[out] stat - the stat, left unspecified on failure.
+     */
+    virtual BlobResult<void> tryGetStatInto(std::string_view id,
+                                            StatResponse& stat)
+    {
+        return assignStat(tryGetStat(std::string(id)), stat);
+    }
+
+    /**
+     * @param[in] session - the blob session.
+     * @param[out] stat - the stat, left unspecified on failure.
+     */
+    virtual BlobResult<void> tryGetStatInto(std::uint16_t session,
+                                            StatResponse& stat)
+    {
+        return assignStat(tryGetStat(session), stat);
+    }
+
+    virtual BlobResult<std::uint16_t> tryOpenBlob(const std::string& id,
+                                                  std::uint16_t handlerFlags)
+    {
+        return catchBlobException([&] { return openBlob(id, handlerFlags); });
+    }
+
+    /**
+     * Unlike closeBlob(), a failure to close is reported.
+     */
+    virtual BlobResult<void> tryCloseBlob(std::uint16_t session)
+    {
+        return catchBlobException([&] { closeBlob(session); });
+    }
+
+    /**
+     * Unlike deleteBlob(), a failure is returned as an error.  The default
+     * implementation only learns that deleteBlob() failed, not why;
+     * BlobHandler reports the reason.
+     */
+    virtual BlobResult<void> tryDeleteBlob(const std::string& id)
+    {
+        if (!deleteBlob(id))
+        {
+            return std::unexpected("Delete failed");
+        }
+        return {};
+    }
+
+    virtual BlobResult<std::vector<std::uint8_t>> tryReadBytes(
+        std::uint16_t session, std::uint32_t offset, std::uint32_t length)
+    {
+        return catchBlobException(
+            [&] { return readBytes(session, offset, length); });
+    }
+
+    virtual BlobResult<std::size_t> tryReadBytes(std::uint16_t session,
+                                                 std::uint32_t offset,
+                                                 std::span<std::uint8_t> out)
+    {
+        return catchBlobException(
+            [&] { return readBytes(session, offset, out); });
+    }
+
+    /**
+     * readBlob(), reporting failure by value.  The default implementation
+     * reads each chunk into a buffer on the stack with tryReadBytes().
+     */
+    virtual BlobResult<std::uint32_t> tryReadBlob(std::uint16_t session,
+                                                  BlobSink& sink)
+    {
+        auto stat = tryGetStat(session);
+        if (!stat)
+        {
+            return std::unexpected(stat.error());
+        }
+
+        std::array<std::uint8_t, layout::maxReadPayload> chunk;
+        std::uint32_t offset = 0;
+        while (offset < stat->size)
+        {
+            std::size_t wanted =
+                std::min<std::size_t>(chunk.size(), stat->size - offset);
+            auto read =
+                tryReadBytes(session, offset, std::span(chunk).first(wanted));
+            if (!read)
+            {
+                return std::unexpected(read.error());
+            }
+            if (*read == 0)
+            {
+                return std::unexpected("Blob ended before its reported size");
+            }
+
+            auto written = sink.write(std::span(chunk).first(*read));
+            if (!written)
+            {
+                return std::unexpected(written.error());
+            }
+            offset += static_cast<std::uint32_t>(*read);
+        }
+
+        if (auto finished = sink.finish(); !finished)
+        {
+            return std::unexpected(finished.error());
+        }
+        return offset;
+    }
+
+    /**
+     * uploadFile(), reporting failure by value.  The default implementation
+     * read()s each chunk into a buffer on the stack for tryWriteBytes().
+     */
+    virtual BlobResult<std::uint32_t> tryUploadFile(std::uint16_t session,
+                                                    const std::string& path);
+
+  protected:
+    /* Move a stat into the caller's StatResponse. */
+    static BlobResult<void> assignStat(BlobResult<StatResponse>&& got,
+                                       StatResponse& stat)
+    {
+        if (!got)
+        {
+            return std::unexpected(got.error());
+        }
+        stat = std::move(*got);
+        return {};
+    }
+
+    /* Run a throwing call and return its result or failure by value. */
+    template <typename Call>
+    static auto catchBlobException(Call&& call)
+        -> BlobResult<std::invoke_result_t<Call>>
+    {
+        try
+        {
+            if constexpr (std::is_void_v<std::invoke_result_t<Call>>)
+            {
+                call();
+                return {};
+            }
+            else
+            {
+                return call();
+            }
+        }
+        catch (const BlobException& e)
+        {
+            if (e.code() != 0)
+            {
+                return std::unexpected(BlobError(IpmiError{e.code()}));
+            }
+            return std::unexpected(BlobError(std::string(e.what())));
+        }
+    }
 };
 
 } // namespace ipmiblob
@@ -0,0 +1,221 @@
+#pragma once
+
+/* Wire layouts of the blob OEM commands.
+ *
+ * Each request and response is described as a list of fixed-offset
+ * little-endian fields, which may be followed by a variable length tail
+ * (data bytes or a nul-terminated string) that is not part of the layout.
+ * Encoding and decoding are constexpr and compile down to fixed-offset
+ * loads and stores; the field offsets are checked at compile time.
+ */
+
+#include "ipmi_interface.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <tuple>
+#include <utility>
+
+namespace ipmiblob
+{
+namespace layout
+{
+
+/**
+ * An unsigned little-endian integer of Size bytes at a fixed offset.
+ *
+ * @tparam Offset - the byte offset of the field within its layout.
+ * @tparam T - the host type used to hold the value.
+ * @tparam Size - the number of bytes on the wire, sizeof(T) by default.
+ */
+template <std::size_t Offset, typename T, std::size_t Size = sizeof(T)>
+struct Field
+{
+    static_assert(Size <= sizeof(T));
+
+    using type = T;
+    static constexpr std::size_t offset = Offset;
+    static constexpr std::size_t size = Size;
+    static constexpr std::size_t end = Offset + Size;
+
+    static constexpr void store(std::uint8_t* buffer, T value)
+    {
+        [&]<std::size_t... I>(std::index_sequence<I...>) {
+            ((buffer[Offset + I] = static_cast<std::uint8_t>(value >> (8 * I))),
+             ...);
+        }(std::make_index_sequence<Size>{});
+    }
+
+    static constexpr T load(const std::uint8_t* buffer)
+    {
+        return [&]<std::size_t... I>(std::index_sequence<I...>) {
+            return static_cast<T>(
+                ((static_cast<T>(buffer[Offset + I]) << (8 * I)) | ...));
+        }(std::make_index_sequence<Size>{});
+    }
+};
+
+/**
+ * A fixed layout made of Fields, which must follow each other without gaps
+ * starting at offset 0.
+ */
+template <typename... Fields>
+struct Layout
+{
+  private:
+    static constexpr bool contiguous()
+    {
+        std::size_t next = 0;
+        return ((Fields::offset == next ? (next = Fields::end, true) : false) &&
+                ...);
+    }
+
+  public:
+    static_assert(contiguous(), "layout fields must be back to back");
+
+    /* The size of the fixed part on the wire. */
+    static constexpr std::size_t size = (std::size_t{0} + ... + Fields::size);
+
+    /* The Ith field, for naming the fields of a layout without repeating
+     * their offsets and types.
+     */
+    template <std::size_t I>
+    using field = std::tuple_element_t<I, std::tuple<Fields...>>;
+
+    using Buffer = std::span<std::uint8_t, size>;
+    using ConstBuffer = std::span<const std::uint8_t, size>;
+
+    static constexpr void encode(Buffer out, typename Fields::type... values)
+    {
+        (Fields::store(out.data(), values), ...);
+    }
+
+    static constexpr std::tuple<typename Fields::type...> decode(
+        ConstBuffer in)
+    {
+        return {Fields::load(in.data())...};
+    }
+};
+
+/* The OpenBMC IANA enterprise number, sent least significant byte first. */
+constexpr std::uint32_t phosphorOen = 0x00c2cf;
+
+/* OEN, subcommand and CRC, which precede every request payload.  The CRC is
+ * only present when there is a payload.
+ */
+struct RequestHeader :
+    Layout<Field<0, std::uint32_t, 3>, Field<3, std::uint8_t>,
+           Field<4, std::uint16_t>>
+{
+    using oen = field<0>;
+    using command = field<1>;
+    using crc = field<2>;
+};
+
+/* OEN and CRC, which precede every response payload.  The CRC is only
+ * present when there is a payload.
+ */
+struct ResponseHeader :
+    Layout<Field<0, std::uint32_t, 3>, Field<3, std::uint16_t>>
+{
+    using oen = field<0>;
+    using crc = field<1>;
+};
+
+/* bmcBlobGetCount reply. */
+struct GetCountResponse : Layout<Field<0, std::uint32_t>>
+{
+    using count = field<0>;
+};
+
+/* bmcBlobEnumerate request; the reply is a nul-terminated blob id. */
+struct EnumerateRequest : Layout<Field<0, std::uint32_t>>
+{
+    using index = field<0>;
+};
+
+/* bmcBlobOpen request, followed by the nul-terminated blob id. */
+struct OpenRequest : Layout<Field<0, std::uint16_t>>
+{
+    using flags = field<0>;
+};
+
+/* bmcBlobOpen reply. */
+struct OpenResponse : Layout<Field<0, std::uint16_t>>
+{
+    using session = field<0>;
+};
+
+/* bmcBlobRead request; the reply is the data read. */
+struct ReadRequest :
+    Layout<Field<0, std::uint16_t>, Field<2, std::uint32_t>,
+           Field<6, std::uint32_t>>
+{
+    using session = field<0>;
+    using offset = field<1>;
+    using length = field<2>;
+};
+
+/* bmcBlobWrite and bmcBlobWriteMeta request, followed by the data. */
+struct WriteRequest : Layout<Field<0, std::uint16_t>, Field<2, std::uint32_t>>
+{
+    using session = field<0>;
+    using offset = field<1>;
+};
+
+/* bmcBlobCommit request, followed by up to 255 bytes of commit data. */
+struct CommitRequest : Layout<Field<0, std::uint16_t>, Field<2, std::uint8_t>>
+{
+    using session = field<0>;
+    using length = field<1>;
+};
+
+/* bmcBlobClose and bmcBlobSessionStat request. */
+struct SessionRequest : Layout<Field<0, std::uint16_t>>
+{
+    using session = field<0>;
+};
+
+/* bmcBlobStat and bmcBlobSessionStat reply, followed by the metadata. */
+struct StatReply :
+    Layout<Field<0, std::uint16_t>, Field<2, std::uint32_t>,
+           Field<6, std::uint8_t>>
+{
+    using state = field<0>;
+    using blobSize = field<1>;
+    using metadataLength = field<2>;
+};
+
+/* The largest IPMI message, completion code included: what an IpmiReply
+ * holds, which ipmi_handler.cpp checks is IPMI_MAX_MSG_LENGTH.
+ */
+constexpr std::size_t maxMessage = IpmiReply::capacity;
+
+/* The most data one bmcBlobRead reply can carry: a whole message, less the
+ * completion code and the response header.
+ */
+constexpr std::size_t maxReadPayload = maxMessage - 1 - ResponseHeader::size;
+
+/* The most data one bmcBlobWrite request can carry, after the request header
+ * and the session and offset.
+ */
+constexpr std::size_t maxWritePayload =
+    maxMessage - RequestHeader::size - WriteRequest::size;
+
+static_assert(RequestHeader::size == 6);
+static_assert(ResponseHeader::size == 5);
+static_assert(ReadRequest::size == 10);
+static_assert(WriteRequest::size == 6);
+static_assert(CommitRequest::size == 3);
+static_assert(StatReply::size == 7);
+static_assert(maxReadPayload == 266);
+static_assert(maxWritePayload == 260);
+
+} // namespace layout
+
+/* The IPMI netfn and command every blob request is sent with. */
+constexpr int ipmiOEMNetFn = 46;
+constexpr int ipmiOEMBlobCmd = 128;
+
+} // namespace ipmiblob
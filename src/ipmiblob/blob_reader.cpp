@@ -0,0 +1,214 @@
+#include "blob_reader.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace ipmiblob
+{
+
+BlobReader::BlobReader(BlobInterface& blob, std::uint16_t session,
+                       std::size_t chunk) :
+    blob(blob), session(session),
+    chunk(std::clamp<std::size_t>(chunk, 1, layout::maxReadPayload))
+{}
+
+BlobReader::BlobReader(BlobHandler& blob, std::uint16_t session,
+                       std::size_t chunk) :
+    BlobReader(static_cast<BlobInterface&>(blob), session, chunk)
+{
+    handler = &blob;
+}
+
+void BlobReader::setPipelining(std::size_t depth, Pump pump)
+{
+    if (!handler)
+    {
+        return;
+    }
+
+    this->depth = std::max<std::size_t>(depth, 1);
+    this->pump = std::move(pump);
+}
+
+BlobResult<std::size_t> BlobReader::read(std::uint32_t offset,
+                                         std::span<std::uint8_t> out)
+{
+    discardBefore(offset);
+    if (chunks.empty() && offset != next)
+    {
+        /* Nothing to read ahead of a read out of sequence. */
+        packets++;
+        auto read = blob.tryReadBytes(session, offset, out);
+        if (read)
+        {
+            next = offset + static_cast<std::uint32_t>(*read);
+        }
+        return read;
+    }
+
+    std::size_t copied = 0;
+    auto fail = [&](const BlobError& error) -> BlobResult<std::size_t> {
+        chunks.clear();
+        next = offset + static_cast<std::uint32_t>(copied);
+        if (copied)
+        {
+            return copied;
+        }
+        return std::unexpected(error);
+    };
+
+    while (copied < out.size())
+    {
+        std::uint32_t at = offset + static_cast<std::uint32_t>(copied);
+        discardBefore(at);
+        if (chunks.size() < depth)
+        {
+            if (auto started = readAhead(at); !started)
+            {
+                return fail(started.error());
+            }
+            if (chunks.empty())
+            {
+                /* At or past the end of the blob. */
+                break;
+            }
+        }
+
+        Chunk& front = *chunks.front();
+        if (auto arrived = await(front); !arrived)
+        {
+            return fail(arrived.error());
+        }
+        if (!*front.bytes)
+        {
+            return fail(front.bytes->error());
+        }
+
+        const std::vector<std::uint8_t>& bytes = **front.bytes;
+        if (bytes.size() > front.length)
+        {
+            return fail("Read returned more bytes than requested");
+        }
+        if (bytes.size() < front.length)
+        {
+            /* The blob ends here, whatever its stat said. */
+            size = front.offset + static_cast<std::uint32_t>(bytes.size());
+            chunks.resize(1);
+        }
+
+        std::size_t skip = at - front.offset;
+        if (skip >= bytes.size())
+        {
+            break;
+        }
+        std::size_t taken = std::min(bytes.size() - skip, out.size() - copied);
+        std::copy_n(bytes.begin() + skip, taken, out.begin() + copied);
+        copied += taken;
+    }
+
+    next = offset + static_cast<std::uint32_t>(copied);
+    return copied;
+}
+
+BlobResult<void> BlobReader::write(std::uint32_t offset,
+                                   std::span<const std::uint8_t> bytes)
+{
+    invalidate();
+    return blob.tryWriteBytes(session, offset, bytes);
+}
+
+void BlobReader::invalidate()
+{
+    chunks.clear();
+    size.reset();
+}
+
+BlobResult<void> BlobReader::readAhead(std::uint32_t at)
+{
+    if (!size)
+    {
+        auto stat = blob.tryGetStat(session);
+        if (!stat)
+        {
+            return std::unexpected(stat.error());
+        }
+        size = stat->size;
+    }
+
+    std::uint32_t from =
+        chunks.empty() ? at : chunks.back()->offset + chunks.back()->length;
+    while (chunks.size() < depth && from < *size)
+    {
+        auto fetched = std::make_shared<Chunk>();
+        fetched->offset = from;
+        fetched->length = static_cast<std::uint32_t>(
+            std::min<std::size_t>(chunk, *size - from));
+        chunks.push_back(fetched);
+        packets++;
+
+        if (handler)
+        {
+            handler->readBytesAsync(
+                session, fetched->offset, fetched->length,
+                [arrivals = arrivals,
+                 fetched](BlobResult<std::vector<std::uint8_t>> bytes) {
+                    std::lock_guard lock(arrivals->lock);
+                    fetched->bytes = std::move(bytes);
+                    arrivals->arrived.notify_all();
+                });
+        }
+        else
+        {
+            fetched->bytes =
+                blob.tryReadBytes(session, fetched->offset, fetched->length);
+        }
+        from += fetched->length;
+    }
+
+    return {};
+}
+
+void BlobReader::discardBefore(std::uint32_t at)
+{
+    if (!chunks.empty() && at < chunks.front()->offset)
+    {
+        chunks.clear();
+    }
+    while (!chunks.empty() &&
+           at >= chunks.front()->offset + chunks.front()->length)
+    {
+        chunks.pop_front();
+    }
+}
+
+BlobResult<void> BlobReader::await(Chunk& fetched)
+{
+    std::unique_lock lock(arrivals->lock);
+    while (!fetched.bytes)
+    {
+        if (!pump)
+        {
+            arrivals->arrived.wait(lock);
+            continue;
+        }
+
+        /* The reply may be delivered by the pump itself. */
+        lock.unlock();
+        auto pumped = pump();
+        lock.lock();
+        if (!pumped && !fetched.bytes)
+        {
+            return std::unexpected(pumped.error());
+        }
+    }
+
+    return {};
+}
+
+} // namespace ipmiblob
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "blob_errors.hpp"
+#include "blob_handler.hpp"
+#include "blob_interface.hpp"
+#include "ipmi_errors.hpp"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace ipmiblob
+{
+
+/**
+ * Serves small reads of one session from chunks read ahead of them, for
+ * consumers that parse a blob a header or record at a time, such as BMC
+ * logs.  A read that starts where the last one ended, or at the start of the
+ * blob, reads ahead in full bmcBlobRead chunks up to the size the session
+ * stat reports; reads of bytes already fetched are served from memory, and
+ * any other read goes straight to the BMC.
+ *
+ *     BlobReader reader(blob, session, blob.payloadLimits().read);
+ *     std::array<std::uint8_t, 16> record;
+ *     std::uint32_t offset = 0;
+ *     while (reader.read(offset, record).value_or(0) == record.size())
+ *     {
+ *         parse(record);
+ *         offset += record.size();
+ *     }
+ *
+ * The size is taken once, when reading ahead first starts; invalidate()
+ * forgets it along with the chunks, as does writing through write().  Not
+ * safe to share between threads.
+ */
+class BlobReader
+{
+  public:
+    /* Drives the transport until some submitted request completes, such as
+     * IpmiHandler::processEvents().
+     */
+    using Pump = std::function<IpmiResult<void>()>;
+
+    /**
+     * @param[in] blob - where to read; must outlive the reader.
+     * @param[in] session - the session to read.
+     * @param[in] chunk - the data bytes asked for per packet, between one
+     *     and maxPayloadSize(BlobOEMCommands::bmcBlobRead).
+     */
+    BlobReader(BlobInterface& blob, std::uint16_t session,
+               std::size_t chunk =
+                   maxPayloadSize(BlobOEMCommands::bmcBlobRead));
+
+    /**
+     * Like the above, for a blob that can also be read with pipelining.
+     */
+    BlobReader(BlobHandler& blob, std::uint16_t session,
+               std::size_t chunk =
+                   maxPayloadSize(BlobOEMCommands::bmcBlobRead));
+
+    BlobReader(const BlobReader&) = delete;
+    BlobReader& operator=(const BlobReader&) = delete;
+
+    /**
+     * Keep up to depth chunks in flight ahead of the reader, requested with
+     * BlobHandler::readBytesAsync(), so sequential reads are limited by
+     * bandwidth rather than round trips.  Without this, one chunk is read at
+     * a time.  Only a reader made with a BlobHandler pipelines; for any
+     * other this does nothing.
+     *
+     * @param[in] depth - the chunks to keep requested, at least one.
+     * @param[in] pump - called to wait for a chunk when the transport only
+     *     completes requests from an event loop, as IpmiHandler does; empty
+     *     if it completes them by itself, before submit() returns or from a
+     *     thread of its own.
+     */
+    void setPipelining(std::size_t depth, Pump pump = {});
+
+    /**
+     * Read bytes at offset.
+     *
+     * @return the number of bytes read, short of out.size() only at the end
+     *     of the blob; or a failure, reported once any bytes already read
+     *     have been returned.
+     */
+    BlobResult<std::size_t> read(std::uint32_t offset,
+                                 std::span<std::uint8_t> out);
+
+    /**
+     * Write bytes at offset, dropping what was read ahead first.
+     */
+    BlobResult<void> write(std::uint32_t offset,
+                           std::span<const std::uint8_t> bytes);
+
+    /**
+     * Drop the chunks read ahead and the size, for when the session was
+     * written other than through write().  Chunks in flight are ignored.
+     */
+    void invalidate();
+
+    /**
+     * @return the bmcBlobRead packets requested so far.
+     */
+    std::size_t packetsRequested() const
+    {
+        return packets;
+    }
+
+  private:
+    /* A chunk read ahead, filled in when its reply arrives. */
+    struct Chunk
+    {
+        std::uint32_t offset;
+        std::uint32_t length;
+        std::optional<BlobResult<std::vector<std::uint8_t>>> bytes;
+    };
+
+    /* Shared with the callbacks of chunks in flight, which may outlive the
+     * reader.
+     */
+    struct Arrivals
+    {
+        std::mutex lock;
+        std::condition_variable arrived;
+    };
+
+    /* Request chunks from at until depth are queued or the size is reached,
+     * taking the size first if it is not known.
+     */
+    BlobResult<void> readAhead(std::uint32_t at);
+
+    /* Drop the chunks that end at or before at, or all if at is before them.
+     */
+    void discardBefore(std::uint32_t at);
+
+    /* Wait for the reply to fetched. */
+    BlobResult<void> await(Chunk& fetched);
+
+    BlobInterface& blob;
+    const std::uint16_t session;
+    const std::size_t chunk;
+
+    /* The blob, when it can be read asynchronously. */
+    BlobHandler* handler = nullptr;
+    std::size_t depth = 1;
+    Pump pump;
+
+    std::shared_ptr<Arrivals> arrivals = std::make_shared<Arrivals>();
+    std::deque<std::shared_ptr<Chunk>> chunks;
+    std::optional<std::uint32_t> size;
+    /* Where a sequential read would start. */
+    std::uint32_t next = 0;
+    std::size_t packets = 0;
+};
+
+} // namespace ipmiblob
@@ -0,0 +1,75 @@
+#include "blob_sink.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <string>
+
+namespace ipmiblob
+{
+
+BlobResult<void> FdSink::write(std::span<const std::uint8_t> bytes)
+{
+    while (!bytes.empty())
+    {
+        ssize_t written = ::write(fd, bytes.data(), bytes.size());
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return std::unexpected("Unable to write blob data to sink");
+        }
+        bytes = bytes.subspan(written);
+    }
+
+    return {};
+}
+
+FileSink::FileSink(const std::string& path) :
+    FdSink(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                  0644))
+{}
+
+FileSink::~FileSink()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+    }
+}
+
+BlobResult<void> FileSink::write(std::span<const std::uint8_t> bytes)
+{
+    if (fd < 0)
+    {
+        return std::unexpected("Unable to open file for blob data");
+    }
+
+    return FdSink::write(bytes);
+}
+
+BlobResult<void> FileSink::finish()
+{
+    if (fd < 0)
+    {
+        return std::unexpected("Unable to open file for blob data");
+    }
+
+    /* Delayed write errors, such as a full disk, only show up here. */
+    int rc = ::close(fd);
+    fd = -1;
+    if (rc < 0)
+    {
+        return std::unexpected("Unable to write blob data to sink");
+    }
+
+    return {};
+}
+
+} // namespace ipmiblob
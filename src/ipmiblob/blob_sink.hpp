@@ -0,0 +1,102 @@
+#pragma once
+
+#include "blob_errors.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <utility>
+
+namespace ipmiblob
+{
+
+/**
+ * Where BlobInterface::readBlob() puts the bytes of a blob, chunk by chunk
+ * and in order, so that the blob never has to be held in memory whole.
+ */
+class BlobSink
+{
+  public:
+    virtual ~BlobSink() = default;
+
+    /**
+     * Take the next bytes of the blob.
+     *
+     * @param[in] bytes - only valid during the call.
+     * @return a failure, which stops the read.
+     */
+    virtual BlobResult<void> write(std::span<const std::uint8_t> bytes) = 0;
+
+    /**
+     * Called once the last bytes have been written.
+     */
+    virtual BlobResult<void> finish()
+    {
+        return {};
+    }
+};
+
+/**
+ * Writes to a descriptor the caller owns, such as a pipe or socket.
+ */
+class FdSink : public BlobSink
+{
+  public:
+    explicit FdSink(int fd) : fd(fd) {}
+
+    /**
+     * Writes every byte, retrying short and interrupted writes.
+     */
+    BlobResult<void> write(std::span<const std::uint8_t> bytes) override;
+
+  protected:
+    int fd;
+};
+
+/**
+ * Writes to a file, created or truncated when the sink is made.
+ */
+class FileSink : public FdSink
+{
+  public:
+    /**
+     * @param[in] path - the file to write; a failure to open it is reported
+     *     by write() and finish().
+     */
+    explicit FileSink(const std::string& path);
+
+    ~FileSink();
+    FileSink(const FileSink&) = delete;
+    FileSink& operator=(const FileSink&) = delete;
+
+    BlobResult<void> write(std::span<const std::uint8_t> bytes) override;
+
+    /**
+     * Closes the file, reporting a failure to open or close it.
+     */
+    BlobResult<void> finish() override;
+};
+
+/**
+ * Hands each chunk to a callback, to be parsed or forwarded as it arrives.
+ */
+class CallbackSink : public BlobSink
+{
+  public:
+    using Callback =
+        std::function<BlobResult<void>(std::span<const std::uint8_t>)>;
+
+    explicit CallbackSink(Callback callback) : callback(std::move(callback))
+    {}
+
+    BlobResult<void> write(std::span<const std::uint8_t> bytes) override
+    {
+        return callback(bytes);
+    }
+
+  private:
+    Callback callback;
+};
+
+} // namespace ipmiblob
@@ -0,0 +1,132 @@
+#include "blob_writer.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <expected>
+#include <span>
+
+namespace ipmiblob
+{
+
+BlobWriter::BlobWriter(BlobInterface& blob, std::uint16_t session,
+                       std::size_t chunk) :
+    blob(blob), session(session),
+    chunk(std::clamp<std::size_t>(chunk, 1, layout::maxWritePayload))
+{}
+
+BlobWriter::~BlobWriter()
+{
+    auto flushed = flush();
+    if (!flushed)
+    {
+        std::fprintf(stderr, "Received failure on flush: %s\n",
+                     flushed.error().message().c_str());
+    }
+}
+
+BlobResult<void> BlobWriter::write(std::uint32_t at,
+                                   std::span<const std::uint8_t> bytes)
+{
+    if (bytes.empty())
+    {
+        return {};
+    }
+
+    /* Only bytes that follow on from the buffer can join it. */
+    if (length && at != offset + length)
+    {
+        if (auto flushed = flush(); !flushed)
+        {
+            return flushed;
+        }
+    }
+    if (!length)
+    {
+        offset = at;
+    }
+
+    /* Top up the buffer, and send it if that fills it. */
+    if (length)
+    {
+        std::size_t taken = std::min(chunk - length, bytes.size());
+        std::copy_n(bytes.begin(), taken, buffer.begin() + length);
+        length += taken;
+        bytes = bytes.subspan(taken);
+        at += static_cast<std::uint32_t>(taken);
+        if (length < chunk)
+        {
+            return {};
+        }
+        if (auto flushed = flush(); !flushed)
+        {
+            /* Leave the buffer as it was before this write. */
+            length -= taken;
+            return flushed;
+        }
+    }
+
+    /* Whole packets straight from the caller's memory. */
+    while (bytes.size() >= chunk)
+    {
+        if (auto sent = send(at, bytes.first(chunk)); !sent)
+        {
+            return sent;
+        }
+        bytes = bytes.subspan(chunk);
+        at += static_cast<std::uint32_t>(chunk);
+    }
+
+    std::copy(bytes.begin(), bytes.end(), buffer.begin());
+    offset = at;
+    length = bytes.size();
+    return {};
+}
+
+BlobResult<void> BlobWriter::flush()
+{
+    if (!length)
+    {
+        return {};
+    }
+
+    if (auto sent = send(offset, std::span(buffer).first(length)); !sent)
+    {
+        return sent;
+    }
+    length = 0;
+    return {};
+}
+
+BlobResult<void> BlobWriter::commit(std::span<const std::uint8_t> bytes)
+{
+    if (auto flushed = flush(); !flushed)
+    {
+        return flushed;
+    }
+
+    return blob.tryCommit(session, bytes);
+}
+
+BlobResult<void> BlobWriter::close()
+{
+    if (auto flushed = flush(); !flushed)
+    {
+        return flushed;
+    }
+
+    return blob.tryCloseBlob(session);
+}
+
+BlobResult<void> BlobWriter::send(std::uint32_t at,
+                                  std::span<const std::uint8_t> bytes)
+{
+    auto sent = blob.tryWriteBytes(session, at, bytes);
+    if (sent)
+    {
+        packets++;
+    }
+    return sent;
+}
+
+} // namespace ipmiblob
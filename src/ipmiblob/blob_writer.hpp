@@ -0,0 +1,111 @@
+#pragma once
+
+#include "blob_errors.hpp"
+#include "blob_interface.hpp"
+#include "blob_layout.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace ipmiblob
+{
+
+/**
+ * Collects small writes to one session and sends them as full bmcBlobWrite
+ * packets, for producers that write a little at a time, such as log records.
+ * Contiguous writes are merged into a chunk buffer that is sent when full,
+ * when a write does not follow on from it, before commit() and close(), and
+ * on flush().  A write larger than the buffer goes out in full packets
+ * straight from the caller's memory.
+ *
+ *     BlobWriter writer(blob, session, blob.payloadLimits().write);
+ *     for (const Record& record : records)
+ *     {
+ *         writer.write(offset, record.bytes());
+ *         offset += record.size();
+ *     }
+ *     writer.commit();
+ *
+ * A failure to send is reported by the call that sent, whichever that was;
+ * the buffered bytes are then kept, so that flush() may be retried.  Not safe
+ * to share between threads.
+ */
+class BlobWriter
+{
+  public:
+    /**
+     * @param[in] blob - where to write; must outlive the writer.
+     * @param[in] session - the session to write to.
+     * @param[in] chunk - the data bytes per packet, between one and
+     *     maxPayloadSize(BlobOEMCommands::bmcBlobWrite).
+     */
+    BlobWriter(BlobInterface& blob, std::uint16_t session,
+               std::size_t chunk =
+                   maxPayloadSize(BlobOEMCommands::bmcBlobWrite));
+
+    /**
+     * Flushes, reporting a failure on stderr, as closeBlob() does.
+     */
+    ~BlobWriter();
+
+    BlobWriter(const BlobWriter&) = delete;
+    BlobWriter& operator=(const BlobWriter&) = delete;
+
+    /**
+     * Write bytes at offset, buffering them unless the buffer fills.
+     *
+     * @return a failure to send.  What was buffered before stays buffered,
+     *     and of these bytes only whole packets already sent were written.
+     */
+    BlobResult<void> write(std::uint32_t offset,
+                           std::span<const std::uint8_t> bytes);
+
+    /**
+     * Send whatever is buffered.
+     */
+    BlobResult<void> flush();
+
+    /**
+     * Flush, then commit the session.
+     */
+    BlobResult<void> commit(std::span<const std::uint8_t> bytes = {});
+
+    /**
+     * Flush, then close the session.  A failure to flush leaves it open.
+     */
+    BlobResult<void> close();
+
+    /**
+     * @return the bytes waiting to be sent.
+     */
+    std::size_t buffered() const
+    {
+        return length;
+    }
+
+    /**
+     * @return the bmcBlobWrite packets sent so far.
+     */
+    std::size_t packetsSent() const
+    {
+        return packets;
+    }
+
+  private:
+    BlobResult<void> send(std::uint32_t at,
+                          std::span<const std::uint8_t> bytes);
+
+    BlobInterface& blob;
+    const std::uint16_t session;
+    const std::size_t chunk;
+
+    std::array<std::uint8_t, layout::maxWritePayload> buffer;
+    /* Where the buffered bytes go, and how many there are. */
+    std::uint32_t offset = 0;
+    std::size_t length = 0;
+    std::size_t packets = 0;
+};
+
+} // namespace ipmiblob
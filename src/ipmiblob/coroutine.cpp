@@ -0,0 +1,92 @@
+#include "coroutine.hpp"
+
+#include "ipmi_handler.hpp"
+
+#include <algorithm>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <utility>
+
+namespace ipmiblob
+{
+
+Executor::Executor(IpmiHandler& ipmi) :
+    wait([&ipmi]() { return ipmi.processEvents(); })
+{}
+
+void Executor::spawn(Task<void> task)
+{
+    task.handle.promise().executor = this;
+    schedule(task.handle);
+    spawned.push_back(std::move(task));
+}
+
+void Executor::run()
+{
+    while (true)
+    {
+        runReady();
+
+        std::exception_ptr error;
+        auto finished = std::remove_if(
+            spawned.begin(), spawned.end(), [&error](const Task<void>& task) {
+                if (task.done() && !error)
+                {
+                    error = task.handle.promise().error;
+                }
+                return task.done();
+            });
+        spawned.erase(finished, spawned.end());
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+        if (spawned.empty())
+        {
+            return;
+        }
+
+        waitForCompletion();
+    }
+}
+
+void Executor::schedule(std::coroutine_handle<> handle)
+{
+    std::lock_guard lock(readyMutex);
+    ready.push_back(handle);
+}
+
+void Executor::runReady()
+{
+    while (true)
+    {
+        std::coroutine_handle<> next;
+        {
+            std::lock_guard lock(readyMutex);
+            if (ready.empty())
+            {
+                return;
+            }
+            next = ready.front();
+            ready.pop_front();
+        }
+        next.resume();
+    }
+}
+
+void Executor::waitForCompletion()
+{
+    if (!wait)
+    {
+        throw IpmiException("No task can make progress.");
+    }
+
+    if (auto waited = wait(); !waited)
+    {
+        throw IpmiException(waited.error());
+    }
+}
+
+} // namespace ipmiblob
@@ -0,0 +1,291 @@
+#pragma once
+
+/* Coroutine support for the asynchronous blob and IPMI calls.
+ *
+ * A Task is a lazily started coroutine.  Tasks run on an Executor, which
+ * resumes them one at a time on the thread calling Executor::run(), and which
+ * waits for replies (for instance through IpmiHandler::processEvents()) when
+ * every task is suspended on a request.  Awaiting a Task runs it on the
+ * awaiting task's executor and resumes the awaiting task once it finishes.
+ */
+
+#include "ipmi_errors.hpp"
+
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace ipmiblob
+{
+
+class Executor;
+class IpmiHandler;
+
+namespace internal
+{
+
+/* What every Task promise holds, whatever its result type. */
+struct TaskPromiseBase
+{
+    /* Hands control back to whoever awaited the finished task. */
+    struct FinalAwaiter
+    {
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<Promise> finished) noexcept
+        {
+            std::coroutine_handle<> next = finished.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept
+    {
+        return {};
+    }
+
+    FinalAwaiter final_suspend() const noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception() noexcept
+    {
+        error = std::current_exception();
+    }
+
+    /* Where operations awaited by this task reschedule it. */
+    Executor* executor = nullptr;
+    /* The coroutine awaiting this one, if any. */
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase
+{
+    void return_value(T result)
+    {
+        value.emplace(std::move(result));
+    }
+
+    T result()
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+        return std::move(*value);
+    }
+
+    std::optional<T> value;
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase
+{
+    void return_void() const noexcept {}
+
+    void result()
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+} // namespace internal
+
+/**
+ * A coroutine producing a T.  It does not start until it is awaited from
+ * another task or handed to an Executor, and an exception escaping it is
+ * rethrown to whoever collects the result.
+ */
+template <typename T = void>
+class [[nodiscard]] Task
+{
+  public:
+    struct promise_type : internal::TaskPromise<T>
+    {
+        Task get_return_object()
+        {
+            return Task(std::coroutine_handle<promise_type>::from_promise(
+                *this));
+        }
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            destroy();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task()
+    {
+        destroy();
+    }
+
+    /**
+     * @return whether the task has run to completion.
+     */
+    bool done() const
+    {
+        return !handle || handle.done();
+    }
+
+    /* Suspends the awaiting coroutine and runs the task in its place. */
+    struct Awaiter
+    {
+        std::coroutine_handle<promise_type> handle;
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<Promise> caller) noexcept
+        {
+            handle.promise().executor = caller.promise().executor;
+            handle.promise().continuation = caller;
+            return handle;
+        }
+
+        T await_resume()
+        {
+            return handle.promise().result();
+        }
+    };
+
+    Awaiter operator co_await() const noexcept
+    {
+        return Awaiter{handle};
+    }
+
+  private:
+    friend class Executor;
+
+    explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle)
+    {}
+
+    void destroy()
+    {
+        if (handle)
+        {
+            handle.destroy();
+            handle = {};
+        }
+    }
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+/**
+ * Runs tasks on the calling thread.  Completions may be scheduled from any
+ * thread, but tasks only ever resume inside run().
+ */
+class Executor
+{
+  public:
+    /**
+     * Blocks until some outstanding request may have completed, and
+     * completes it.
+     */
+    using Wait = std::function<IpmiResult<void>()>;
+
+    /**
+     * @param[in] wait - called whenever every task is waiting on a request.
+     *     Without one, requests must complete before their submit returns.
+     */
+    explicit Executor(Wait wait = {}) : wait(std::move(wait)) {}
+
+    /**
+     * Drive requests through ipmi.processEvents(), for callers without an
+     * event loop of their own.
+     */
+    explicit Executor(IpmiHandler& ipmi);
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    /**
+     * Start task in the background; it runs during the next call to run().
+     */
+    void spawn(Task<void> task);
+
+    /**
+     * Run until every spawned task has finished.
+     *
+     * @throws the first exception to escape a spawned task.
+     * @throws IpmiException if waiting for replies fails, or if no task can
+     *     make progress.
+     */
+    void run();
+
+    /**
+     * Run task, and any spawned tasks alongside it, until task finishes.
+     *
+     * @return the value task returned.
+     * @throws the exception that escaped task, or IpmiException as run().
+     */
+    template <typename T>
+    T run(Task<T> task)
+    {
+        task.handle.promise().executor = this;
+        schedule(task.handle);
+        while (true)
+        {
+            runReady();
+            if (task.done())
+            {
+                return task.handle.promise().result();
+            }
+            waitForCompletion();
+        }
+    }
+
+    /**
+     * Queue a suspended coroutine to be resumed by run().  Safe to call from
+     * any thread.
+     */
+    void schedule(std::coroutine_handle<> handle);
+
+  private:
+    /* Resume coroutines until none are ready. */
+    void runReady();
+
+    /* Call wait, or fail if there is nothing to wait on. */
+    void waitForCompletion();
+
+    Wait wait;
+
+    /* Protects ready. */
+    std::mutex readyMutex;
+    std::deque<std::coroutine_handle<>> ready;
+    std::vector<Task<void>> spawned;
+};
+
+} // namespace ipmiblob
@@ -1,39 +1,150 @@
 #include "crc.hpp"
 
+#include "internal/crc_kernels.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+
 namespace ipmiblob
 {
+namespace internal
+{
+
+namespace
+{
+
+template <std::size_t N>
+using CrcTables = std::array<std::array<std::uint16_t, 256>, N>;
+
+/* tables[k][b] is the register after feeding byte b followed by k zero bytes
+ * into a cleared register.  tables[0] is the classic byte-at-a-time table.
+ */
+template <std::size_t N>
+constexpr CrcTables<N> makeCrcTables()
+{
+    CrcTables<N> tables{};
+
+    for (std::size_t b = 0; b < 256; ++b)
+    {
+        std::uint16_t crc = static_cast<std::uint16_t>(b << 8);
+        for (int j = 0; j < 8; ++j)
+        {
+            crc = (crc & 0x8000) ? static_cast<std::uint16_t>((crc << 1) ^
+                                                              crcPoly)
+                                 : static_cast<std::uint16_t>(crc << 1);
+        }
+        tables[0][b] = crc;
+    }
+
+    for (std::size_t k = 1; k < N; ++k)
+    {
+        for (std::size_t b = 0; b < 256; ++b)
+        {
+            std::uint16_t prev = tables[k - 1][b];
+            tables[k][b] = static_cast<std::uint16_t>(
+                (prev << 8) ^ tables[0][prev >> 8]);
+        }
+    }
+
+    return tables;
+}
+
+constexpr CrcTables<16> crcTables = makeCrcTables<16>();
+
+inline std::uint16_t crcUpdateByte(std::uint16_t crc, std::uint8_t byte)
+{
+    return static_cast<std::uint16_t>((crc << 8) ^
+                                      crcTables[0][(crc >> 8) ^ byte]);
+}
+
+/* Fold the register into the first two bytes of the block, then look every
+ * byte up in the table matching the distance to the end of the block.
+ */
+template <std::size_t N>
+std::uint16_t crcUpdateSlicing(std::uint16_t crc,
+                               std::span<const std::uint8_t> data)
+{
+    static_assert(N >= 3 && N <= crcTables.size());
+
+    const std::uint8_t* p = data.data();
+    std::size_t size = data.size();
+
+    auto block = [&]<std::size_t... I>(std::index_sequence<I...>) {
+        return static_cast<std::uint16_t>(
+            crcTables[N - 1][p[0] ^ (crc >> 8)] ^
+            crcTables[N - 2][p[1] ^ (crc & 0xff)] ^
+            (crcTables[N - 3 - I][p[I + 2]] ^ ...));
+    };
+
+    while (size >= N)
+    {
+        crc = block(std::make_index_sequence<N - 2>{});
+        p += N;
+        size -= N;
+    }
+
+    while (size--)
+    {
+        crc = crcUpdateByte(crc, *p++);
+    }
+
+    return crc;
+}
+
+bool alwaysSupported()
+{
+    return true;
+}
+
+bool wordSizeAtLeast64()
+{
+    return sizeof(void*) >= sizeof(std::uint64_t);
+}
+
+constexpr std::array<CrcKernel, 4> kernels = {{
+    {"clmul", crcUpdateClmul, crcClmulSupported},
+    {"slicing16", crcUpdateSlicing16, wordSizeAtLeast64},
+    {"slicing8", crcUpdateSlicing8, alwaysSupported},
+    {"bitwise", crcUpdateBitwise, alwaysSupported},
+}};
+
+const CrcKernel& selectCrcKernel()
+{
+    for (const CrcKernel& kernel : kernels)
+    {
+        if (kernel.supported())
+        {
+            return kernel;
+        }
+    }
+
+    return kernels.back();
+}
+
+} // namespace
 
 /*
  * This implementation tracks the specification given at
  * http://srecord.sourceforge.net/crc16-ccitt.html
- * Code copied from internal portable sources.
+ * Code copied from internal portable sources, reworked to run on a
+ * pre-augmented register so it can be fed incrementally.
  */
-std::uint16_t generateCrc(const std::vector<std::uint8_t>& data)
+std::uint16_t crcUpdateBitwise(std::uint16_t crc,
+                               std::span<const std::uint8_t> data)
 {
-    const std::uint16_t kPoly = 0x1021;
-    const std::uint16_t kLeftBit = 0x8000;
-    const int kExtraRounds = 2;
-    const std::uint8_t* bytes = data.data();
-    std::uint16_t crc = 0xFFFF;
-    std::size_t i;
-    std::size_t j;
-    std::size_t size = data.size();
-
-    for (i = 0; i < size + kExtraRounds; ++i)
+    for (std::uint8_t byte : data)
     {
-        for (j = 0; j < 8; ++j)
+        crc ^= static_cast<std::uint16_t>(byte << 8);
+        for (int j = 0; j < 8; ++j)
         {
-            bool xor_flag = (crc & kLeftBit) ? 1 : 0;
+            bool xor_flag = crc & 0x8000;
             crc <<= 1;
-            // If this isn't an extra round and the current byte's j'th bit from
-            // the left is set, increment the CRC.
-            if (i < size && (bytes[i] & (1 << (7 - j))))
-            {
-                crc++;
-            }
             if (xor_flag)
             {
-                crc ^= kPoly;
+                crc ^= crcPoly;
             }
         }
     }
@@ -41,4 +152,67 @@ std::uint16_t generateCrc(const std::vector<std::uint8_t>& data)
     return crc;
 }
 
+std::uint16_t crcUpdateSlicing8(std::uint16_t crc,
+                                std::span<const std::uint8_t> data)
+{
+    return crcUpdateSlicing<8>(crc, data);
+}
+
+std::uint16_t crcUpdateSlicing16(std::uint16_t crc,
+                                 std::span<const std::uint8_t> data)
+{
+    return crcUpdateSlicing<16>(crc, data);
+}
+
+std::span<const CrcKernel> crcKernels()
+{
+    return kernels;
+}
+
+const CrcKernel& activeCrcKernel()
+{
+    static const CrcKernel& kernel = selectCrcKernel();
+    return kernel;
+}
+
+} // namespace internal
+
+Crc16::Crc16() : crc(internal::crcSeed) {}
+
+Crc16& Crc16::update(std::span<const std::uint8_t> data)
+{
+    crc = internal::activeCrcKernel().update(crc, data);
+    return *this;
+}
+
+Crc16& Crc16::update(std::span<const std::span<const std::uint8_t>> buffers)
+{
+    const internal::CrcKernel& kernel = internal::activeCrcKernel();
+    for (const auto& buffer : buffers)
+    {
+        crc = kernel.update(crc, buffer);
+    }
+    return *this;
+}
+
+std::uint16_t Crc16::finalize() const
+{
+    return crc;
+}
+
+void Crc16::reset()
+{
+    crc = internal::crcSeed;
+}
+
+std::uint16_t generateCrc(const std::vector<std::uint8_t>& data)
+{
+    return Crc16().update(data).finalize();
+}
+
+std::uint16_t generateCrc(std::span<const std::uint8_t> data)
+{
+    return Crc16().update(data).finalize();
+}
+
 } // namespace ipmiblob
@@ -1,11 +1,57 @@
 #pragma once
 
 #include <cstdint>
+#include <initializer_list>
+#include <span>
 #include <vector>
 
 namespace ipmiblob
 {
 
+/**
+ * Running CRC over bytes that arrive in pieces.
+ *
+ * Feeding the same bytes through any sequence of update() calls gives the
+ * same value as generateCrc() over their concatenation, so headers and
+ * caller-owned data can be checksummed where they sit.
+ */
+class Crc16
+{
+  public:
+    Crc16();
+
+    /**
+     * Feed bytes into the CRC.
+     *
+     * @param[in] data - the next bytes of the message.
+     * @return this object, for chaining.
+     */
+    Crc16& update(std::span<const std::uint8_t> data);
+
+    /**
+     * Feed several buffers into the CRC, in order.
+     *
+     * @param[in] buffers - the next pieces of the message.
+     * @return this object, for chaining.
+     */
+    Crc16& update(std::span<const std::span<const std::uint8_t>> buffers);
+    Crc16& update(std::initializer_list<std::span<const std::uint8_t>> buffers)
+    {
+        return update(std::span(buffers.begin(), buffers.size()));
+    }
+
+    /**
+     * @return the CRC of everything fed in since construction or reset().
+     */
+    std::uint16_t finalize() const;
+
+    /** Start over with an empty message. */
+    void reset();
+
+  private:
+    std::uint16_t crc;
+};
+
 /**
  * Generate the CRC for a payload (really any bytes).
  *
@@ -16,5 +62,6 @@ namespace ipmiblob
  * @return the CRC value
  */
 std::uint16_t generateCrc(const std::vector<std::uint8_t>& data);
+std::uint16_t generateCrc(std::span<const std::uint8_t> data);
 
 } // namespace ipmiblob
@@ -0,0 +1,266 @@
+/* Carry-less multiply folding for the blob CRC.
+ *
+ * The message is treated as one big polynomial, most significant bit first.
+ * It is consumed in 128-bit blocks: the running remainder X is split into
+ * 64-bit halves and moved D bits further along the message by multiplying
+ * each half by x^(D+64) mod P and x^D mod P, then xor'd into the block found
+ * D bits later.  The products stay well inside 128 bits because P is only of
+ * degree 16, and the result is congruent to the original prefix modulo P.
+ * Four independent accumulators fold by 512 bits to hide the multiplier
+ * latency; they are collapsed into one, and the final 16 bytes plus any tail
+ * go through the table kernel with a cleared register.
+ */
+
+#include "internal/crc_kernels.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+namespace ipmiblob
+{
+namespace internal
+{
+
+namespace
+{
+
+/* Below this the setup cost outweighs the table kernel. */
+constexpr std::size_t clmulMinSize = 64;
+
+#if defined(__x86_64__) || defined(__aarch64__)
+
+/* x^n mod P, for the 17-bit P = x^16 + poly. */
+constexpr std::uint64_t xPowModPoly(unsigned n)
+{
+    std::uint32_t r = 1;
+    for (unsigned i = 0; i < n; ++i)
+    {
+        r <<= 1;
+        if (r & 0x10000)
+        {
+            r ^= 0x10000 | crcPoly;
+        }
+    }
+    return r;
+}
+
+constexpr std::uint64_t fold128Hi = xPowModPoly(128 + 64);
+constexpr std::uint64_t fold128Lo = xPowModPoly(128);
+constexpr std::uint64_t fold512Hi = xPowModPoly(512 + 64);
+constexpr std::uint64_t fold512Lo = xPowModPoly(512);
+
+#endif
+
+} // namespace
+
+#if defined(__x86_64__)
+
+namespace
+{
+
+#define IPMIBLOB_TARGET_CLMUL __attribute__((target("pclmul,ssse3")))
+
+IPMIBLOB_TARGET_CLMUL inline __m128i loadBigEndian(const std::uint8_t* p)
+{
+    const __m128i reverse =
+        _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    return _mm_shuffle_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), reverse);
+}
+
+IPMIBLOB_TARGET_CLMUL inline void storeBigEndian(std::uint8_t* p, __m128i x)
+{
+    const __m128i reverse =
+        _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p),
+                     _mm_shuffle_epi8(x, reverse));
+}
+
+IPMIBLOB_TARGET_CLMUL inline __m128i fold(__m128i x, __m128i k)
+{
+    return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x11),
+                         _mm_clmulepi64_si128(x, k, 0x00));
+}
+
+IPMIBLOB_TARGET_CLMUL std::uint16_t crcUpdateFold(
+    std::uint16_t crc, std::span<const std::uint8_t> data)
+{
+    const std::uint8_t* p = data.data();
+    std::size_t size = data.size();
+
+    const __m128i k128 = _mm_set_epi64x(fold128Hi, fold128Lo);
+    const __m128i k512 = _mm_set_epi64x(fold512Hi, fold512Lo);
+
+    __m128i x0 = loadBigEndian(p);
+    __m128i x1 = loadBigEndian(p + 16);
+    __m128i x2 = loadBigEndian(p + 32);
+    __m128i x3 = loadBigEndian(p + 48);
+    /* The register lines up with the first two message bytes. */
+    x0 = _mm_xor_si128(x0, _mm_slli_si128(_mm_cvtsi32_si128(crc), 14));
+    p += 64;
+    size -= 64;
+
+    while (size >= 64)
+    {
+        x0 = _mm_xor_si128(fold(x0, k512), loadBigEndian(p));
+        x1 = _mm_xor_si128(fold(x1, k512), loadBigEndian(p + 16));
+        x2 = _mm_xor_si128(fold(x2, k512), loadBigEndian(p + 32));
+        x3 = _mm_xor_si128(fold(x3, k512), loadBigEndian(p + 48));
+        p += 64;
+        size -= 64;
+    }
+
+    x1 = _mm_xor_si128(x1, fold(x0, k128));
+    x2 = _mm_xor_si128(x2, fold(x1, k128));
+    __m128i x = _mm_xor_si128(x3, fold(x2, k128));
+
+    while (size >= 16)
+    {
+        x = _mm_xor_si128(fold(x, k128), loadBigEndian(p));
+        p += 16;
+        size -= 16;
+    }
+
+    std::uint8_t remainder[16];
+    storeBigEndian(remainder, x);
+
+    crc = crcUpdateSlicing16(0, remainder);
+    return crcUpdateSlicing16(crc, {p, size});
+}
+
+} // namespace
+
+bool crcClmulSupported()
+{
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+}
+
+#elif defined(__aarch64__)
+
+namespace
+{
+
+#if defined(__clang__)
+#define IPMIBLOB_TARGET_CLMUL __attribute__((target("aes")))
+#else
+#define IPMIBLOB_TARGET_CLMUL __attribute__((target("+crypto")))
+#endif
+
+IPMIBLOB_TARGET_CLMUL inline uint64x2_t loadBigEndian(const std::uint8_t* p)
+{
+    uint8x16_t v = vrev64q_u8(vld1q_u8(p));
+    return vreinterpretq_u64_u8(vextq_u8(v, v, 8));
+}
+
+IPMIBLOB_TARGET_CLMUL inline void storeBigEndian(std::uint8_t* p,
+                                                 uint64x2_t x)
+{
+    uint8x16_t v = vrev64q_u8(vreinterpretq_u8_u64(x));
+    vst1q_u8(p, vextq_u8(v, v, 8));
+}
+
+IPMIBLOB_TARGET_CLMUL inline uint64x2_t fold(uint64x2_t x, uint64x2_t k)
+{
+    poly128_t hi = vmull_p64(vgetq_lane_u64(x, 1), vgetq_lane_u64(k, 1));
+    poly128_t lo = vmull_p64(vgetq_lane_u64(x, 0), vgetq_lane_u64(k, 0));
+    return veorq_u64(vreinterpretq_u64_p128(hi), vreinterpretq_u64_p128(lo));
+}
+
+IPMIBLOB_TARGET_CLMUL std::uint16_t crcUpdateFold(
+    std::uint16_t crc, std::span<const std::uint8_t> data)
+{
+    const std::uint8_t* p = data.data();
+    std::size_t size = data.size();
+
+    const uint64x2_t k128 = vcombine_u64(vcreate_u64(fold128Lo),
+                                         vcreate_u64(fold128Hi));
+    const uint64x2_t k512 = vcombine_u64(vcreate_u64(fold512Lo),
+                                         vcreate_u64(fold512Hi));
+
+    uint64x2_t x0 = loadBigEndian(p);
+    uint64x2_t x1 = loadBigEndian(p + 16);
+    uint64x2_t x2 = loadBigEndian(p + 32);
+    uint64x2_t x3 = loadBigEndian(p + 48);
+    /* The register lines up with the first two message bytes. */
+    x0 = veorq_u64(x0, vcombine_u64(vcreate_u64(0),
+                                    vcreate_u64(std::uint64_t{crc} << 48)));
+    p += 64;
+    size -= 64;
+
+    while (size >= 64)
+    {
+        x0 = veorq_u64(fold(x0, k512), loadBigEndian(p));
+        x1 = veorq_u64(fold(x1, k512), loadBigEndian(p + 16));
+        x2 = veorq_u64(fold(x2, k512), loadBigEndian(p + 32));
+        x3 = veorq_u64(fold(x3, k512), loadBigEndian(p + 48));
+        p += 64;
+        size -= 64;
+    }
+
+    x1 = veorq_u64(x1, fold(x0, k128));
+    x2 = veorq_u64(x2, fold(x1, k128));
+    uint64x2_t x = veorq_u64(x3, fold(x2, k128));
+
+    while (size >= 16)
+    {
+        x = veorq_u64(fold(x, k128), loadBigEndian(p));
+        p += 16;
+        size -= 16;
+    }
+
+    std::uint8_t remainder[16];
+    storeBigEndian(remainder, x);
+
+    crc = crcUpdateSlicing16(0, remainder);
+    return crcUpdateSlicing16(crc, {p, size});
+}
+
+} // namespace
+
+bool crcClmulSupported()
+{
+    return (getauxval(AT_HWCAP) & HWCAP_PMULL) != 0;
+}
+
+#else
+
+namespace
+{
+
+std::uint16_t crcUpdateFold(std::uint16_t crc,
+                            std::span<const std::uint8_t> data)
+{
+    return crcUpdateSlicing16(crc, data);
+}
+
+} // namespace
+
+bool crcClmulSupported()
+{
+    return false;
+}
+
+#endif
+
+std::uint16_t crcUpdateClmul(std::uint16_t crc,
+                             std::span<const std::uint8_t> data)
+{
+    if (data.size() < clmulMinSize)
+    {
+        return crcUpdateSlicing16(crc, data);
+    }
+
+    return crcUpdateFold(crc, data);
+}
+
+} // namespace internal
+} // namespace ipmiblob
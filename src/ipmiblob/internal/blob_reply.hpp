@@ -0,0 +1,24 @@
+#pragma once
+
+#include <ipmiblob/blob_errors.hpp>
+#include <ipmiblob/ipmi_errors.hpp>
+
+#include <cstdint>
+#include <span>
+
+namespace ipmiblob
+{
+namespace internal
+{
+
+/**
+ * Check the OEN and CRC of a blob reply and return its payload, in place.
+ *
+ * @param[in] sent - the reply, or why the request failed.
+ * @return the payload, or why the reply was not valid.
+ */
+BlobResult<std::span<const std::uint8_t>> unwrapReply(
+    const IpmiResult<std::span<const std::uint8_t>>& sent);
+
+} // namespace internal
+} // namespace ipmiblob
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace ipmiblob
+{
+namespace internal
+{
+
+/* The blob CRC is CRC-16/CCITT (poly 0x1021, MSB first) seeded with 0xFFFF
+ * and augmented with two zero bytes.  Running the augmentation through the
+ * register ahead of time gives the equivalent non-augmented seed below, which
+ * lets every kernel work incrementally on a plain CRC register.
+ */
+constexpr std::uint16_t crcPoly = 0x1021;
+constexpr std::uint16_t crcSeed = 0x1D0F;
+
+/**
+ * Advance a CRC register over a run of bytes.
+ *
+ * @param[in] crc - the current register value.
+ * @param[in] data - the bytes to feed in.
+ * @return the new register value.
+ */
+using CrcUpdateFn = std::uint16_t (*)(std::uint16_t crc,
+                                      std::span<const std::uint8_t> data);
+
+struct CrcKernel
+{
+    const char* name;
+    CrcUpdateFn update;
+    /* Whether the running CPU can execute this kernel. */
+    bool (*supported)();
+};
+
+/** Reference shift-register implementation, one bit at a time. */
+std::uint16_t crcUpdateBitwise(std::uint16_t crc,
+                               std::span<const std::uint8_t> data);
+
+/** Table-driven implementations consuming 8 or 16 bytes per iteration. */
+std::uint16_t crcUpdateSlicing8(std::uint16_t crc,
+                                std::span<const std::uint8_t> data);
+std::uint16_t crcUpdateSlicing16(std::uint16_t crc,
+                                 std::span<const std::uint8_t> data);
+
+/**
+ * Carry-less multiply folding (PCLMULQDQ on x86-64, PMULL on AArch64).  Short
+ * inputs are handed to the table kernel.  Only callable when
+ * crcClmulSupported() says so.
+ */
+std::uint16_t crcUpdateClmul(std::uint16_t crc,
+                             std::span<const std::uint8_t> data);
+bool crcClmulSupported();
+
+/**
+ * All kernels compiled into the library, most preferred first.
+ */
+std::span<const CrcKernel> crcKernels();
+
+/**
+ * The kernel chosen for this process.  The choice is made once, the first
+ * time the library is used, by picking the first supported entry of
+ * crcKernels().
+ */
+const CrcKernel& activeCrcKernel();
+
+} // namespace internal
+} // namespace ipmiblob
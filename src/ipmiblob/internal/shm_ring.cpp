@@ -0,0 +1,187 @@
+#include "shm_ring.hpp"
+
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <new>
+#include <span>
+#include <string_view>
+
+namespace ipmiblob
+{
+namespace internal
+{
+
+namespace
+{
+
+/* Seals that keep the memory the size it was mapped at. */
+constexpr int channelSeals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL;
+
+/* Whether fd is an eventfd, made non-blocking if so. */
+bool adoptBell(int fd)
+{
+    std::array<char, 32> path;
+    std::snprintf(path.data(), path.size(), "/proc/self/fd/%d", fd);
+    std::array<char, 32> target;
+    ssize_t length = ::readlink(path.data(), target.data(), target.size());
+    if (length < 0 || std::string_view(target.data(), length) !=
+                          std::string_view("anon_inode:[eventfd]"))
+    {
+        return false;
+    }
+
+    int flags = ::fcntl(fd, F_GETFL);
+    return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+} // namespace
+
+std::span<std::uint8_t> ShmRing::reserve()
+{
+    std::uint32_t tail = shared->tail.load(std::memory_order_relaxed);
+    std::uint32_t head = shared->head.load(std::memory_order_acquire);
+    if (tail - head >= slots)
+    {
+        return {};
+    }
+
+    return shared->slot[tail % slots].data;
+}
+
+bool ShmRing::publish(std::size_t size)
+{
+    std::uint32_t tail = shared->tail.load(std::memory_order_relaxed);
+    shared->slot[tail % slots].size = static_cast<std::uint32_t>(size);
+    shared->tail.store(tail + 1, std::memory_order_seq_cst);
+
+    /* If the consumer had read everything before this frame it may have
+     * gone to sleep; otherwise it will find the frame before it does.
+     */
+    return shared->head.load(std::memory_order_seq_cst) == tail;
+}
+
+std::span<const std::uint8_t> ShmRing::front() const
+{
+    std::uint32_t head = shared->head.load(std::memory_order_relaxed);
+    std::uint32_t tail = shared->tail.load(std::memory_order_acquire);
+    if (head == tail)
+    {
+        return {};
+    }
+
+    const Shared::Slot& slot = shared->slot[head % slots];
+    std::size_t size = slot.size;
+    return std::span<const std::uint8_t>(slot.data,
+                                         size <= slotSize ? size : 0);
+}
+
+bool ShmRing::pop()
+{
+    std::uint32_t head = shared->head.load(std::memory_order_relaxed);
+    shared->head.store(head + 1, std::memory_order_seq_cst);
+
+    /* A producer that found the ring full may be waiting for this slot. */
+    return shared->tail.load(std::memory_order_seq_cst) - head == slots;
+}
+
+std::unique_ptr<ShmChannel> ShmChannel::create()
+{
+    int memFd =
+        ::memfd_create("ipmiblob-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memFd < 0)
+    {
+        return nullptr;
+    }
+    if (::ftruncate(memFd, sizeof(Shared)) < 0 ||
+        ::fcntl(memFd, F_ADD_SEALS, channelSeals) < 0)
+    {
+        ::close(memFd);
+        return nullptr;
+    }
+
+    void* base = ::mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE,
+                        MAP_SHARED, memFd, 0);
+    int serverBell = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    int clientBell = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (base == MAP_FAILED || serverBell < 0 || clientBell < 0)
+    {
+        if (base != MAP_FAILED)
+        {
+            ::munmap(base, sizeof(Shared));
+        }
+        ::close(serverBell);
+        ::close(clientBell);
+        ::close(memFd);
+        return nullptr;
+    }
+
+    return std::unique_ptr<ShmChannel>(new ShmChannel(
+        new (base) Shared{}, memFd, serverBell, clientBell));
+}
+
+std::unique_ptr<ShmChannel> ShmChannel::attach(int memFd, int serverBell,
+                                               int clientBell)
+{
+    /* Unsealed memory could be truncated under the mapping, and the next
+     * access to it would kill this process with SIGBUS.
+     */
+    struct stat info;
+    void* base = MAP_FAILED;
+    int seals = ::fcntl(memFd, F_GET_SEALS);
+    if (seals >= 0 && (seals & channelSeals) == channelSeals &&
+        ::fstat(memFd, &info) == 0 &&
+        info.st_size == static_cast<off_t>(sizeof(Shared)) &&
+        adoptBell(serverBell) && adoptBell(clientBell))
+    {
+        base = ::mmap(nullptr, sizeof(Shared), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, memFd, 0);
+    }
+    if (base == MAP_FAILED)
+    {
+        ::close(memFd);
+        ::close(serverBell);
+        ::close(clientBell);
+        return nullptr;
+    }
+
+    return std::unique_ptr<ShmChannel>(new ShmChannel(
+        static_cast<Shared*>(base), memFd, serverBell, clientBell));
+}
+
+ShmChannel::ShmChannel(Shared* shared, int memFd, int serverBell,
+                       int clientBell) :
+    requests(&shared->requests), replies(&shared->replies), memFd(memFd),
+    serverBell(serverBell), clientBell(clientBell), shared(shared)
+{}
+
+ShmChannel::~ShmChannel()
+{
+    ::munmap(shared, sizeof(Shared));
+    ::close(memFd);
+    ::close(serverBell);
+    ::close(clientBell);
+}
+
+void ShmChannel::ring(int bell)
+{
+    std::uint64_t one = 1;
+    [[maybe_unused]] auto written = ::write(bell, &one, sizeof(one));
+}
+
+void ShmChannel::drain(int bell)
+{
+    std::uint64_t count;
+    [[maybe_unused]] auto drained = ::read(bell, &count, sizeof(count));
+}
+
+} // namespace internal
+} // namespace ipmiblob
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+namespace ipmiblob
+{
+namespace internal
+{
+
+/**
+ * A single-producer single-consumer queue of frames in memory shared
+ * between two processes.  Frames are written and read in place; the only
+ * synchronisation is a pair of free-running indices.
+ *
+ * Each side tells the other when it may need waking: publish() when the
+ * consumer had caught up, and so may be asleep, and pop() when the ring was
+ * full, so the producer may be waiting for room.  Both checks are made with
+ * sequentially consistent accesses so that no wakeup is lost.
+ */
+class ShmRing
+{
+  public:
+    /* Frames the ring holds. */
+    static constexpr std::uint32_t slots = 64;
+    /* The largest frame, a proxy frame with the largest IPMI message. */
+    static constexpr std::size_t slotSize = 280;
+
+    /* The ring as laid out in the shared memory. */
+    struct Shared
+    {
+        /* The next slot to read, written by the consumer. */
+        alignas(64) std::atomic<std::uint32_t> head;
+        /* The next slot to write, written by the producer. */
+        alignas(64) std::atomic<std::uint32_t> tail;
+
+        struct Slot
+        {
+            std::uint32_t size;
+            std::uint8_t data[slotSize];
+        };
+        alignas(64) Slot slot[slots];
+    };
+
+    static_assert(std::atomic<std::uint32_t>::is_always_lock_free,
+                  "the indices must be usable across processes");
+
+    explicit ShmRing(Shared* shared) : shared(shared) {}
+
+    /**
+     * @return the next free slot to write a frame into, or an empty span if
+     *     the ring is full.
+     */
+    std::span<std::uint8_t> reserve();
+
+    /**
+     * Make the frame written into the reserved slot visible.
+     *
+     * @param[in] size - the bytes written.
+     * @return whether the consumer should be woken.
+     */
+    bool publish(std::size_t size);
+
+    /**
+     * @return the oldest frame, or an empty span if there is none.  The
+     *     size is checked, since the other side may be untrusted; the
+     *     contents may still change under the caller, who should copy what
+     *     it needs to validate.
+     */
+    std::span<const std::uint8_t> front() const;
+
+    /**
+     * Release the oldest frame.
+     *
+     * @return whether the producer should be woken.
+     */
+    bool pop();
+
+  private:
+    Shared* const shared;
+};
+
+/**
+ * The memory and doorbells a client and the proxy share: requests one way,
+ * replies the other, and an eventfd for each side to be woken through.
+ */
+class ShmChannel
+{
+  public:
+    /**
+     * Create a new channel in a memfd, for the client side.  The memfd is
+     * sealed at its size, so that the proxy can map it without the client
+     * being able to shrink it under the mapping.
+     *
+     * @return nullptr on failure.
+     */
+    static std::unique_ptr<ShmChannel> create();
+
+    /**
+     * Map a channel created by the other side, taking ownership of the
+     * descriptors.  Since the other side may be untrusted, the memory must
+     * be a memfd of the channel's size sealed against resizing, and the
+     * doorbells must be eventfds; they are made non-blocking, so ringing
+     * one never stalls the caller.
+     *
+     * @return nullptr if the memory is not a channel or a doorbell not an
+     *     eventfd.
+     */
+    static std::unique_ptr<ShmChannel> attach(int memFd, int serverBell,
+                                              int clientBell);
+
+    ~ShmChannel();
+    ShmChannel(const ShmChannel&) = delete;
+    ShmChannel& operator=(const ShmChannel&) = delete;
+
+    /* Requests from the client to the proxy. */
+    ShmRing requests;
+    /* Replies from the proxy to the client. */
+    ShmRing replies;
+
+    /* The memfd, for passing to the proxy. */
+    const int memFd;
+    /* Rung to wake the proxy, or the client. */
+    const int serverBell;
+    const int clientBell;
+
+    /* Wake a side through its doorbell. */
+    static void ring(int bell);
+
+    /* Clear a doorbell before looking for work. */
+    static void drain(int bell);
+
+  private:
+    struct Shared
+    {
+        ShmRing::Shared requests;
+        ShmRing::Shared replies;
+    };
+
+    ShmChannel(Shared* shared, int memFd, int serverBell, int clientBell);
+
+    Shared* const shared;
+};
+
+} // namespace internal
+} // namespace ipmiblob
@@ -19,6 +19,7 @@
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 namespace ipmiblob
@@ -57,6 +58,16 @@ int SysImpl::getpagesize() const
     return ::getpagesize();
 }
 
+int SysImpl::fstat(int fd, struct stat* buf) const
+{
+    return ::fstat(fd, buf);
+}
+
+int SysImpl::madvise(void* addr, std::size_t length, int advice) const
+{
+    return ::madvise(addr, length, advice);
+}
+
 int SysImpl::ioctl(int fd, unsigned long request, void* param) const
 {
     return ::ioctl(fd, request, param);
@@ -11,6 +11,7 @@
 
 #include <poll.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <cinttypes>
 #include <cstddef>
@@ -35,6 +36,8 @@ class SysImpl : public Sys
                off_t offset) const override;
     int munmap(void* addr, std::size_t length) const override;
     int getpagesize() const override;
+    int fstat(int fd, struct stat* buf) const override;
+    int madvise(void* addr, std::size_t length, int advice) const override;
     int ioctl(int fd, unsigned long request, void* param) const override;
     int poll(struct pollfd* fds, nfds_t nfds, int timeout) const override;
 };
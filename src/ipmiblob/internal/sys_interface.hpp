@@ -9,6 +9,7 @@
 
 #include <poll.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <cinttypes>
 #include <cstddef>
@@ -34,6 +35,8 @@ class Sys
                        int fd, off_t offset) const = 0;
     virtual int munmap(void* addr, std::size_t length) const = 0;
     virtual int getpagesize() const = 0;
+    virtual int fstat(int fd, struct stat* buf) const = 0;
+    virtual int madvise(void* addr, std::size_t length, int advice) const = 0;
     virtual int ioctl(int fd, unsigned long request, void* param) const = 0;
     virtual int poll(struct pollfd* fds, nfds_t nfds, int timeout) const = 0;
 };
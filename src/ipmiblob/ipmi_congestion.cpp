@@ -0,0 +1,124 @@
+#include "ipmi_congestion.hpp"
+
+#include "blob_interface.hpp"
+#include "blob_layout.hpp"
+#include "ipmi_timing.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <span>
+
+namespace ipmiblob
+{
+
+CongestionControl::CongestionControl(std::size_t limit,
+                                     const Options& options) :
+    options(options),
+    limit(static_cast<double>(std::max<std::size_t>(limit, 1))),
+    window(this->limit), jitter(std::random_device{}())
+{}
+
+bool CongestionControl::idempotent(std::uint8_t netfn, std::uint8_t cmd,
+                                   std::span<const std::uint8_t> data)
+{
+    using Kind = AdaptiveTiming::Kind;
+
+    if (netfn != ipmiOEMNetFn || cmd != ipmiOEMBlobCmd ||
+        data.size() <= layout::RequestHeader::command::offset)
+    {
+        return false;
+    }
+
+    Kind kind = AdaptiveTiming::kindOf(netfn, cmd, data);
+    switch (static_cast<BlobOEMCommands>(kind & 0xff))
+    {
+        case BlobOEMCommands::bmcBlobGetCount:
+        case BlobOEMCommands::bmcBlobEnumerate:
+        case BlobOEMCommands::bmcBlobRead:
+        case BlobOEMCommands::bmcBlobStat:
+        case BlobOEMCommands::bmcBlobSessionStat:
+            return true;
+        default:
+            return false;
+    }
+}
+
+std::size_t CongestionControl::allowed() const
+{
+    return std::max<std::size_t>(static_cast<std::size_t>(window), 1);
+}
+
+void CongestionControl::record(Signal signal)
+{
+    replies++;
+    switch (signal)
+    {
+        case Signal::success:
+            window = std::min(limit, window + options.increase / window);
+            break;
+        case Signal::busy:
+            counters.busy++;
+            shrink();
+            break;
+        case Signal::timeout:
+            counters.timeouts++;
+            shrink();
+            break;
+        case Signal::other:
+            break;
+    }
+}
+
+void CongestionControl::shrink()
+{
+    if (replies < shrinkAfter)
+    {
+        return;
+    }
+
+    shrinkAfter = replies + allowed();
+    window = std::max(1.0, window * options.decrease);
+}
+
+bool CongestionControl::shouldRetry(Signal signal, int attempt,
+                                    bool idempotent)
+{
+    bool retryable = signal == Signal::busy ||
+                     (signal == Signal::timeout && options.retryTimeouts &&
+                      idempotent);
+    if (!retryable || attempt >= options.maxRetries)
+    {
+        return false;
+    }
+
+    counters.retries++;
+    return true;
+}
+
+std::chrono::milliseconds CongestionControl::backoff(int attempt)
+{
+    using std::chrono::milliseconds;
+
+    milliseconds ceiling = options.baseBackoff;
+    for (int i = 0; i < attempt && ceiling < options.maxBackoff; ++i)
+    {
+        ceiling *= 2;
+    }
+    ceiling = std::min(ceiling, options.maxBackoff);
+
+    std::uniform_int_distribution<milliseconds::rep> spread(
+        ceiling.count() / 2, ceiling.count());
+    return milliseconds(spread(jitter));
+}
+
+CongestionStats CongestionControl::stats() const
+{
+    CongestionStats current = counters;
+    current.window = window;
+    return current;
+}
+
+} // namespace ipmiblob
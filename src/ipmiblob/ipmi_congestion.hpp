@@ -0,0 +1,123 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <span>
+
+namespace ipmiblob
+{
+
+/**
+ * Counters describing how a transport is coping with the BMC.
+ */
+struct CongestionStats
+{
+    /* Requests currently allowed in flight. */
+    double window = 0;
+    /* Requests resent after a busy or timed out reply. */
+    std::uint64_t retries = 0;
+    /* Busy completion codes seen. */
+    std::uint64_t busy = 0;
+    /* Requests that timed out, on the BMC or waiting for the reply. */
+    std::uint64_t timeouts = 0;
+};
+
+/**
+ * Additive-increase/multiplicative-decrease limit on requests in flight,
+ * plus the retry policy for requests the BMC turned away.  The window grows
+ * by about one request for every window's worth of successful replies and
+ * shrinks by a factor on a busy or timeout, at most once per window's worth
+ * of replies, so throughput settles at what the BMC sustains.  Not
+ * thread-safe; the owning transport serialises calls.
+ */
+class CongestionControl
+{
+  public:
+    struct Options
+    {
+        /* Resends of one request before its failure is reported. */
+        int maxRetries = 5;
+        /* Whether timeouts of idempotent() requests are retried as well as
+         * busy replies.  The BMC may have carried out a request whose reply
+         * timed out, so others never are.
+         */
+        bool retryTimeouts = false;
+        /* Backoff before the first resend, doubled for each one after. */
+        std::chrono::milliseconds baseBackoff{5};
+        std::chrono::milliseconds maxBackoff{500};
+        /* Window growth per window's worth of successes. */
+        double increase = 1.0;
+        /* Window factor applied on a busy or timeout. */
+        double decrease = 0.5;
+    };
+
+    /* What a completed request says about congestion. */
+    enum class Signal
+    {
+        success,
+        busy,
+        timeout,
+        /* Any other failure, which says nothing about load. */
+        other,
+    };
+
+    /**
+     * @param[in] limit - the most requests the window may grow to; it
+     *     starts there.
+     * @param[in] options - the policy.
+     */
+    CongestionControl(std::size_t limit, const Options& options);
+
+    /**
+     * @return whether sending this request again after a timeout is
+     *     harmless: the blob count, enumerate, stat and read requests.
+     */
+    static bool idempotent(std::uint8_t netfn, std::uint8_t cmd,
+                           std::span<const std::uint8_t> data);
+
+    /**
+     * @return how many requests may be in flight now, at least one.
+     */
+    std::size_t allowed() const;
+
+    /**
+     * Adjust the window for a completed request.
+     */
+    void record(Signal signal);
+
+    /**
+     * Decide whether to resend a request, counting the retry if so.
+     *
+     * @param[in] signal - how the latest attempt ended.
+     * @param[in] attempt - resends made so far.
+     * @param[in] idempotent - whether the request is, as idempotent() tells.
+     */
+    bool shouldRetry(Signal signal, int attempt, bool idempotent);
+
+    /**
+     * @return a jittered delay before resend number attempt + 1: somewhere
+     *     in the upper half of the exponential backoff.
+     */
+    std::chrono::milliseconds backoff(int attempt);
+
+    CongestionStats stats() const;
+
+  private:
+    /* Apply the decrease, unless it was applied within the last window's
+     * worth of replies, which were already in flight when it was.
+     */
+    void shrink();
+
+    const Options options;
+    const double limit;
+    double window;
+    /* Replies recorded, and how many there must be before shrinking again. */
+    std::uint64_t replies = 0;
+    std::uint64_t shrinkAfter = 0;
+    CongestionStats counters;
+    std::minstd_rand jitter;
+};
+
+} // namespace ipmiblob
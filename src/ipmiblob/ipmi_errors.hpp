@@ -1,12 +1,54 @@
 #pragma once
 
 #include <exception>
+#include <expected>
 #include <map>
+#include <memory>
 #include <string>
+#include <utility>
 
 namespace ipmiblob
 {
 
+/**
+ * An IPMI failure reported by value rather than thrown: either a completion
+ * code from the BMC, or a host-side failure described by a static string.
+ * Neither needs the heap, so an error can be returned, inspected and retried
+ * in a tight loop; only a reason made at run time is copied to it.
+ */
+struct IpmiError
+{
+    /* The completion code, or 0 for a host-side failure. */
+    int code = 0;
+    /* What went wrong on the host side, or nullptr when code is set. */
+    const char* reason = nullptr;
+
+    IpmiError() = default;
+    IpmiError(int code, const char* reason = nullptr) :
+        code(code), reason(reason)
+    {}
+
+    /* Keeps its own copy of a reason that would not outlive it, such as the
+     * message of a caught exception.
+     */
+    explicit IpmiError(std::string reason) :
+        owned(std::make_shared<const std::string>(std::move(reason)))
+    {
+        this->reason = owned->c_str();
+    }
+
+    std::string message() const;
+
+  private:
+    /* Shared with a BlobError made from this, which keeps the reason. */
+    friend struct BlobError;
+
+    std::shared_ptr<const std::string> owned;
+};
+
+template <typename T>
+using IpmiResult = std::expected<T, IpmiError>;
+
 class IpmiException : public std::exception
 {
   public:
@@ -39,6 +81,10 @@ class IpmiException : public std::exception
 
     explicit IpmiException(int cc) : IpmiException(messageFromIpmi(cc), cc) {}
 
+    explicit IpmiException(const IpmiError& error) :
+        IpmiException(error.message(), error.code)
+    {}
+
     virtual const char* what() const noexcept override
     {
         return _message.c_str();
@@ -54,4 +100,9 @@ class IpmiException : public std::exception
     int _ccode = 0;
 };
 
+inline std::string IpmiError::message() const
+{
+    return reason ? reason : IpmiException::messageFromIpmi(code);
+}
+
 } // namespace ipmiblob
@@ -23,30 +23,125 @@
 #include <linux/ipmi_msgdefs.h>
 #include <sys/ioctl.h>
 
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <cstring>
+#include <expected>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <span>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 namespace ipmiblob
 {
 
-std::unique_ptr<IpmiInterface> IpmiHandler::CreateIpmiHandler()
+static_assert(IpmiReply::capacity == IPMI_MAX_MSG_LENGTH);
+
+namespace
 {
-    return std::make_unique<IpmiHandler>(std::make_unique<internal::SysImpl>());
+
+/* How long to wait for a reply when no timing is set. */
+constexpr int fifteenMs = 15 * 1000;
+constexpr int ipmiReadTimeout = fifteenMs;
+
+/* Compared by address to tell our own timeouts from other failures. */
+constexpr const char* replyTimeout = "Timeout waiting for reply.";
+
+int millisecondsUntil(std::chrono::steady_clock::time_point deadline)
+{
+    auto left = std::chrono::ceil<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    return static_cast<int>(std::max<std::int64_t>(left.count(), 0));
+}
+
+/* Adds the time until it goes out of scope to a total, if given one, so
+ * that timing costs nothing but a branch when nobody is profiling.
+ */
+class Stopwatch
+{
+  public:
+    explicit Stopwatch(std::chrono::nanoseconds* total) :
+        total(total),
+        started(total ? std::chrono::steady_clock::now()
+                      : std::chrono::steady_clock::time_point())
+    {}
+
+    ~Stopwatch()
+    {
+        if (total)
+        {
+            *total += std::chrono::steady_clock::now() - started;
+        }
+    }
+
+    Stopwatch(const Stopwatch&) = delete;
+    Stopwatch& operator=(const Stopwatch&) = delete;
+
+  private:
+    std::chrono::nanoseconds* const total;
+    const std::chrono::steady_clock::time_point started;
+};
+
+CongestionControl::Signal signalOf(int cc)
+{
+    switch (cc)
+    {
+        case IPMI_CC_NO_ERROR:
+            return CongestionControl::Signal::success;
+        case IPMI_NODE_BUSY_ERR:
+            return CongestionControl::Signal::busy;
+        case IPMI_TIMEOUT_ERR:
+            return CongestionControl::Signal::timeout;
+        default:
+            return CongestionControl::Signal::other;
+    }
+}
+
+CongestionControl::Signal signalOf(const IpmiError& error)
+{
+    if (error.reason == replyTimeout)
+    {
+        return CongestionControl::Signal::timeout;
+    }
+
+    return error.reason ? CongestionControl::Signal::other
+                        : signalOf(error.code);
+}
+
+} // namespace
+
+std::unique_ptr<IpmiInterface> IpmiHandler::CreateIpmiHandler(
+    std::size_t window)
+{
+    return std::make_unique<IpmiHandler>(std::make_unique<internal::SysImpl>(),
+                                         window);
 }
 
 void IpmiHandler::open()
+{
+    auto opened = tryOpen();
+    if (!opened)
+    {
+        throw IpmiException(opened.error());
+    }
+}
+
+IpmiResult<void> IpmiHandler::tryOpen()
 {
     std::lock_guard<std::mutex> guard(openMutex);
     if (fd >= 0)
     {
-        return;
+        return {};
     }
 
     constexpr int device = 0;
@@ -67,23 +162,314 @@ void IpmiHandler::open()
 
     if (fd < 0)
     {
-        throw IpmiException("Unable to open any ipmi devices");
+        return std::unexpected(
+            IpmiError{0, "Unable to open any ipmi devices"});
     }
+
+    return {};
 }
 
 std::vector<std::uint8_t> IpmiHandler::sendPacket(
     std::uint8_t netfn, std::uint8_t cmd, std::vector<std::uint8_t>& data)
 {
-    open();
+    IpmiReply buffer;
+    auto returned = sendPacketInto(netfn, cmd, data, buffer);
 
-    constexpr int ipmiOEMLun = 0;
-    constexpr int fifteenMs = 15 * 1000;
-    constexpr int ipmiReadTimeout = fifteenMs;
-    constexpr int ipmiResponseBufferLen = IPMI_MAX_MSG_LENGTH;
-    constexpr int ipmiOk = 0;
+    return std::vector<std::uint8_t>(returned.begin(), returned.end());
+}
+
+std::span<const std::uint8_t> IpmiHandler::sendPacketInto(
+    std::uint8_t netfn, std::uint8_t cmd, std::span<const std::uint8_t> data,
+    IpmiReply& replyBuffer)
+{
+    auto returned = trySendPacketInto(netfn, cmd, data, replyBuffer);
+    if (!returned)
+    {
+        throw IpmiException(returned.error());
+    }
+
+    return *returned;
+}
+
+IpmiResult<std::span<const std::uint8_t>> IpmiHandler::trySendPacketInto(
+    std::uint8_t netfn, std::uint8_t cmd, std::span<const std::uint8_t> data,
+    IpmiReply& replyBuffer)
+{
+    for (int attempt = 0;; ++attempt)
+    {
+        auto ticket = submitTicket(netfn, cmd, data, replyBuffer, true);
+        if (!ticket)
+        {
+            return std::unexpected(ticket.error());
+        }
+
+        auto returned = tryWait(*ticket);
+        if (returned || !congestion)
+        {
+            return returned;
+        }
+
+        std::chrono::milliseconds delay;
+        {
+            std::lock_guard lock(stateMutex);
+            if (!congestion->shouldRetry(
+                    signalOf(returned.error()), attempt,
+                    CongestionControl::idempotent(netfn, cmd, data)))
+            {
+                return returned;
+            }
+            delay = congestion->backoff(attempt);
+        }
+        std::this_thread::sleep_for(delay);
+    }
+}
+
+IpmiResult<IpmiHandler::Ticket> IpmiHandler::trySubmit(
+    std::uint8_t netfn, std::uint8_t cmd, std::span<const std::uint8_t> data,
+    IpmiReply& replyBuffer)
+{
+    return submitTicket(netfn, cmd, data, replyBuffer, false);
+}
+
+IpmiResult<IpmiHandler::Ticket> IpmiHandler::submitTicket(
+    std::uint8_t netfn, std::uint8_t cmd, std::span<const std::uint8_t> data,
+    IpmiReply& replyBuffer, bool waitForSlot)
+{
+    if (auto opened = tryOpen(); !opened)
+    {
+        return std::unexpected(opened.error());
+    }
+
+    /* The slot is registered before sending, so that whichever thread is
+     * receiving can deliver the reply however early it turns up.
+     */
+    Budget budget = budgetFor(netfn, cmd, data);
+    long msgid;
+    Pending* slot;
+    {
+        std::unique_lock lock(stateMutex);
+        slot = claimSlot(lock, waitForSlot);
+        if (!slot)
+        {
+            return std::unexpected(
+                IpmiError{0, "IPMI request window is full."});
+        }
+
+        msgid = sequence.fetch_add(1, std::memory_order_relaxed);
+        slot->claim(msgid, &replyBuffer, nullptr);
+        slot->start(budget);
+    }
+
+    auto sent = sendRequest(msgid, netfn, cmd, data, budget);
+    if (!sent)
+    {
+        {
+            std::lock_guard lock(stateMutex);
+            slot->release();
+        }
+        stateChanged.notify_all();
+        return std::unexpected(sent.error());
+    }
+
+    return Ticket{msgid};
+}
+
+void IpmiHandler::submit(std::uint8_t netfn, std::uint8_t cmd,
+                         std::span<const std::uint8_t> data,
+                         IpmiCallback callback)
+{
+    if (auto opened = tryOpen(); !opened)
+    {
+        callback(std::unexpected(opened.error()));
+        return;
+    }
+
+    Budget budget = budgetFor(netfn, cmd, data);
+    long msgid;
+    Pending* slot;
+    {
+        std::unique_lock lock(stateMutex);
+        slot = claimSlot(lock, false);
+        if (!slot)
+        {
+            backlog.push_back(
+                Queued{netfn, cmd,
+                       std::vector<std::uint8_t>(data.begin(), data.end()),
+                       std::move(callback), 0, Clock::time_point()});
+            return;
+        }
+
+        msgid = sequence.fetch_add(1, std::memory_order_relaxed);
+        slot->claim(msgid, &slot->ownReply, std::move(callback));
+        slot->start(budget);
+        if (congestion)
+        {
+            slot->netfn = netfn;
+            slot->cmd = cmd;
+            slot->request.assign(data.begin(), data.end());
+        }
+    }
+
+    auto sent = sendRequest(msgid, netfn, cmd, data, budget);
+    if (!sent && failSent(slot, sent.error()))
+    {
+        finishAsync(slot);
+    }
+}
+
+void IpmiHandler::setCongestionControl(
+    const CongestionControl::Options& options)
+{
+    std::lock_guard lock(stateMutex);
+    congestion = std::make_unique<CongestionControl>(pending.size(), options);
+}
 
-    /* We have a handle to the IPMI device. */
-    std::array<std::uint8_t, ipmiResponseBufferLen> responseBuffer = {};
+CongestionStats IpmiHandler::congestionStats()
+{
+    std::lock_guard lock(stateMutex);
+    if (!congestion)
+    {
+        return {static_cast<double>(pending.size())};
+    }
+
+    return congestion->stats();
+}
+
+void IpmiHandler::setTiming(const IpmiTiming& timing)
+{
+    fixedTiming = timing;
+    adaptiveTiming.reset();
+}
+
+void IpmiHandler::setAdaptiveTiming(const AdaptiveTiming::Options& options)
+{
+    fixedTiming.reset();
+    adaptiveTiming = std::make_unique<AdaptiveTiming>(options);
+}
+
+void IpmiHandler::setLatencyProfiling(bool enabled)
+{
+    latency = enabled ? std::make_unique<LatencyProfile>() : nullptr;
+}
+
+IpmiResult<int> IpmiHandler::tryGetFd()
+{
+    if (auto opened = tryOpen(); !opened)
+    {
+        return std::unexpected(opened.error());
+    }
+
+    return fd;
+}
+
+IpmiResult<void> IpmiHandler::processReadable()
+{
+    while (true)
+    {
+        {
+            std::lock_guard lock(stateMutex);
+            /* Whoever is reading will deliver anything that is waiting. */
+            if (receiving)
+            {
+                return {};
+            }
+            receiving = true;
+        }
+
+        /* No request is waiting here, so nobody to charge wrong messages. */
+        ReceiveCost cost;
+        auto msgid = receiveNow(readableBuffer,
+                                latency ? &cost.receive : nullptr);
+
+        Pending* finished = nullptr;
+        {
+            std::lock_guard lock(stateMutex);
+            receiving = false;
+            if (msgid && *msgid)
+            {
+                finished = deliver(**msgid, readableBuffer, cost);
+            }
+        }
+        stateChanged.notify_all();
+
+        /* Not while receiving: the callback may make a synchronous call. */
+        if (finished)
+        {
+            finishAsync(finished);
+        }
+
+        if (!msgid)
+        {
+            return std::unexpected(msgid.error());
+        }
+
+        /* Keep reading until the queue is empty, rather than going back to
+         * poll for each reply; but once nothing is outstanding there is
+         * nothing to read, so skip the read that would only say so.
+         */
+        std::lock_guard lock(stateMutex);
+        if (!*msgid || !awaitingReplies())
+        {
+            return {};
+        }
+    }
+}
+
+IpmiHandler::Pending* IpmiHandler::claimSlot(
+    std::unique_lock<std::mutex>& lock, bool waitForSlot)
+{
+    auto isFree = [](const Pending& p) { return !p.inUse; };
+    auto findFree = [&]() {
+        /* The congestion window may allow fewer than every slot. */
+        if (congestion)
+        {
+            auto inUse = std::count_if(
+                pending.begin(), pending.end(),
+                [](const Pending& p) { return p.inUse; });
+            if (static_cast<std::size_t>(inUse) >= congestion->allowed())
+            {
+                return pending.end();
+            }
+        }
+        return std::find_if(pending.begin(), pending.end(), isFree);
+    };
+
+    auto found = findFree();
+    while (found == pending.end() && waitForSlot)
+    {
+        stateChanged.wait(lock);
+        found = findFree();
+    }
+
+    return (found == pending.end()) ? nullptr : &*found;
+}
+
+IpmiHandler::Budget IpmiHandler::budgetFor(std::uint8_t netfn,
+                                           std::uint8_t cmd,
+                                           std::span<const std::uint8_t> data)
+{
+    Budget budget{fixedTiming, 0, ipmiReadTimeout};
+    if (adaptiveTiming || latency)
+    {
+        budget.kind = AdaptiveTiming::kindOf(netfn, cmd, data);
+    }
+    if (adaptiveTiming)
+    {
+        budget.timing = adaptiveTiming->timingFor(budget.kind);
+    }
+    if (budget.timing)
+    {
+        budget.timeoutMs = budget.timing->pollTimeoutMs();
+    }
+
+    return budget;
+}
+
+IpmiResult<void> IpmiHandler::sendRequest(
+    long msgid, std::uint8_t netfn, std::uint8_t cmd,
+    std::span<const std::uint8_t> data, const Budget& budget)
+{
+    constexpr int ipmiOEMLun = 0;
 
     /* Build address. */
     ipmi_system_interface_addr systemAddress{};
@@ -95,71 +481,560 @@ std::vector<std::uint8_t> IpmiHandler::sendPacket(
     ipmi_req request{};
     request.addr = reinterpret_cast<unsigned char*>(&systemAddress);
     request.addr_len = sizeof(systemAddress);
-    request.msgid = sequence.fetch_add(1, std::memory_order_relaxed);
-    request.msg.data = reinterpret_cast<unsigned char*>(data.data());
+    request.msgid = msgid;
+    /* The kernel only reads from the request data. */
+    request.msg.data = const_cast<std::uint8_t*>(data.data());
     request.msg.data_len = data.size();
     request.msg.netfn = netfn;
     request.msg.cmd = cmd;
 
-    ipmi_recv reply{};
-    reply.addr = reinterpret_cast<unsigned char*>(&systemAddress);
-    reply.addr_len = sizeof(systemAddress);
-    reply.msg.data = reinterpret_cast<unsigned char*>(responseBuffer.data());
-    reply.msg.data_len = responseBuffer.size();
-
     /* Try to send request. */
-    int rc = sys->ioctl(fd, IPMICTL_SEND_COMMAND, &request);
+    int rc;
+    std::chrono::nanoseconds spent{0};
+    {
+        Stopwatch timed(latency ? &spent : nullptr);
+        if (budget.timing)
+        {
+            ipmi_req_settime timedRequest{};
+            timedRequest.req = request;
+            timedRequest.retries = budget.timing->retries;
+            timedRequest.retry_time_ms = budget.timing->retryTimeMs;
+            rc = sys->ioctl(fd, IPMICTL_SEND_COMMAND_SETTIME, &timedRequest);
+        }
+        else
+        {
+            rc = sys->ioctl(fd, IPMICTL_SEND_COMMAND, &request);
+        }
+    }
+    if (latency)
+    {
+        latency->recordSend(budget.kind, spent);
+    }
     if (rc < 0)
     {
-        throw IpmiException("Unable to send IPMI request.");
+        return std::unexpected(IpmiError{0, "Unable to send IPMI request."});
     }
 
+    return {};
+}
+
+bool IpmiHandler::startQueued()
+{
+    bool started = false;
+    while (true)
+    {
+        Queued next;
+        Budget budget;
+        long msgid;
+        Pending* slot;
+        {
+            std::unique_lock lock(stateMutex);
+            auto now = Clock::now();
+            auto due = std::find_if(
+                backlog.begin(), backlog.end(),
+                [now](const Queued& q) { return q.notBefore <= now; });
+            if (due == backlog.end())
+            {
+                return started;
+            }
+
+            slot = claimSlot(lock, false);
+            if (!slot)
+            {
+                return started;
+            }
+
+            next = std::move(*due);
+            backlog.erase(due);
+            budget = budgetFor(next.netfn, next.cmd, next.data);
+            msgid = sequence.fetch_add(1, std::memory_order_relaxed);
+            slot->claim(msgid, &slot->ownReply, std::move(next.callback));
+            slot->start(budget);
+            slot->netfn = next.netfn;
+            slot->cmd = next.cmd;
+            slot->request = std::move(next.data);
+            slot->attempt = next.attempt;
+        }
+
+        /* The slot is ours until its reply is delivered, so its copy of the
+         * request stays put while it is sent.
+         */
+        started = true;
+        auto sent = sendRequest(msgid, next.netfn, next.cmd, slot->request,
+                                budget);
+        if (!sent && failSent(slot, sent.error()))
+        {
+            /* Settled rather than finished, so a backlog that keeps failing
+             * is worked through here instead of by recursion.
+             */
+            settleAsync(slot);
+        }
+    }
+}
+
+bool IpmiHandler::failSent(Pending* entry, const IpmiError& error)
+{
+    std::lock_guard lock(stateMutex);
+    if (entry->done)
+    {
+        return false;
+    }
+
+    entry->done = true;
+    entry->result = std::unexpected(error);
+    return true;
+}
+
+void IpmiHandler::finishAsync(Pending* entry)
+{
+    settleAsync(entry);
+    startQueued();
+}
+
+void IpmiHandler::settleAsync(Pending* entry)
+{
+    if (!entry->result && congestion)
+    {
+        std::unique_lock lock(stateMutex);
+        auto signal = signalOf(entry->result.error());
+        if (congestion->shouldRetry(
+                signal, entry->attempt,
+                CongestionControl::idempotent(entry->netfn, entry->cmd,
+                                              entry->request)))
+        {
+            /* Back off, then go out again ahead of newer requests. */
+            backlog.push_front(
+                Queued{entry->netfn, entry->cmd, std::move(entry->request),
+                       std::move(entry->callback), entry->attempt + 1,
+                       Clock::now() + congestion->backoff(entry->attempt)});
+            entry->release();
+            lock.unlock();
+            stateChanged.notify_all();
+            return;
+        }
+    }
+
+    /* Nobody else touches a completed asynchronous slot until it is
+     * released, so its outcome is taken without the lock.  The slot is freed
+     * before the callback runs, as a synchronous call from the callback may
+     * need it when the window is one.
+     */
+    IpmiCallback callback = std::move(entry->callback);
+    IpmiResult<void> result = entry->result;
+    IpmiReply reply;
+    if (result)
+    {
+        reply = entry->ownReply;
+    }
+
+    {
+        std::lock_guard lock(stateMutex);
+        entry->release();
+    }
+    stateChanged.notify_all();
+
+    if (result)
+    {
+        callback(reply.data());
+    }
+    else
+    {
+        callback(std::unexpected(result.error()));
+    }
+}
+
+IpmiResult<std::span<const std::uint8_t>> IpmiHandler::tryWait(Ticket ticket)
+{
+    std::unique_lock lock(stateMutex);
+    Pending* entry = findPending(ticket.msgid);
+    if (!entry || entry->callback)
+    {
+        return std::unexpected(IpmiError{0, "Unknown IPMI request."});
+    }
+
+    /* Leader/follower: the first waiter to find nobody reading becomes the
+     * reader, receiving straight into its own buffer and delivering anything
+     * else that turns up first.  Everyone else sleeps until their reply is
+     * delivered or the reader steps down.
+     */
+    IpmiResult<void> received;
+    /* Whether the reader's last read found a message.  Replies to pipelined
+     * requests tend to arrive together, so read again before polling.
+     */
+    bool queued = false;
+    while (!entry->done && received)
+    {
+        if (receiving)
+        {
+            /* A reader blocked on a slower request must not hold this one
+             * past its own deadline.
+             */
+            queued = false;
+            if (stateChanged.wait_until(lock, entry->deadline) ==
+                    std::cv_status::timeout &&
+                !entry->done)
+            {
+                received = std::unexpected(IpmiError{0, replyTimeout});
+                recordTimeout(*entry);
+            }
+            continue;
+        }
+
+        receiving = true;
+        lock.unlock();
+        ReceiveCost cost{entry};
+        auto msgid = receiveOne(*entry->reply,
+                                millisecondsUntil(entry->deadline), queued,
+                                cost);
+        lock.lock();
+        receiving = false;
+
+        Pending* finished = nullptr;
+        queued = msgid.has_value();
+        if (msgid)
+        {
+            finished = deliver(*msgid, *entry->reply, cost);
+        }
+        else
+        {
+            received = std::unexpected(msgid.error());
+            if (msgid.error().reason == replyTimeout)
+            {
+                recordTimeout(*entry);
+            }
+        }
+        stateChanged.notify_all();
+
+        if (finished)
+        {
+            lock.unlock();
+            finishAsync(finished);
+            lock.lock();
+        }
+    }
+
+    IpmiResult<void> result = received ? entry->result : received;
+    IpmiReply* replyBuffer = entry->reply;
+    entry->release();
+    lock.unlock();
+    stateChanged.notify_all();
+
+    if (!result)
+    {
+        return std::unexpected(result.error());
+    }
+
+    return replyBuffer->data();
+}
+
+IpmiResult<void> IpmiHandler::processEvents()
+{
+    if (auto opened = tryOpen(); !opened)
+    {
+        return std::unexpected(opened.error());
+    }
+
+    if (auto readable = pollReadable(timerTimeoutMs()); !readable)
+    {
+        if (processTimers())
+        {
+            return {};
+        }
+        return std::unexpected(readable.error());
+    }
+
+    return processReadable();
+}
+
+ReceiveStats IpmiHandler::receiveStats() const
+{
+    return {polls.load(std::memory_order_relaxed),
+            receives.load(std::memory_order_relaxed),
+            completions.load(std::memory_order_relaxed)};
+}
+
+int IpmiHandler::timerTimeoutMs()
+{
+    std::lock_guard lock(stateMutex);
+    return nextTimeoutMs();
+}
+
+bool IpmiHandler::processTimers()
+{
+    bool expired = expireOverdue();
+    bool resent = startQueued();
+    return expired || resent;
+}
+
+int IpmiHandler::nextTimeoutMs() const
+{
+    int timeoutMs = ipmiReadTimeout;
+    for (const Pending& entry : pending)
+    {
+        if (entry.inUse && !entry.done)
+        {
+            timeoutMs = std::min(timeoutMs, millisecondsUntil(entry.deadline));
+        }
+    }
+    for (const Queued& queued : backlog)
+    {
+        timeoutMs = std::min(timeoutMs, millisecondsUntil(queued.notBefore));
+    }
+
+    return timeoutMs;
+}
+
+bool IpmiHandler::expireOverdue()
+{
+    std::vector<Pending*> overdue;
+    {
+        std::lock_guard lock(stateMutex);
+        auto now = Clock::now();
+        for (Pending& entry : pending)
+        {
+            if (entry.inUse && !entry.done && entry.callback &&
+                entry.deadline <= now)
+            {
+                entry.done = true;
+                entry.result = std::unexpected(IpmiError{0, replyTimeout});
+                overdue.push_back(&entry);
+                recordTimeout(entry);
+            }
+        }
+    }
+
+    for (Pending* entry : overdue)
+    {
+        finishAsync(entry);
+    }
+
+    return !overdue.empty();
+}
+
+IpmiResult<long> IpmiHandler::receiveOne(IpmiReply& buffer, int timeoutMs,
+                                         bool queued, ReceiveCost& cost)
+{
+    std::chrono::nanoseconds* pollSpent = latency ? &cost.poll : nullptr;
+    std::chrono::nanoseconds* receiveSpent =
+        latency ? &cost.receive : nullptr;
+
+    if (queued)
+    {
+        auto msgid = receiveNow(buffer, receiveSpent);
+        if (!msgid)
+        {
+            return std::unexpected(msgid.error());
+        }
+        if (*msgid)
+        {
+            return **msgid;
+        }
+    }
+
+    if (auto readable = pollReadable(timeoutMs, pollSpent); !readable)
+    {
+        return std::unexpected(readable.error());
+    }
+
+    /* Yay, happy case! */
+    auto msgid = receiveNow(buffer, receiveSpent);
+    if (!msgid)
+    {
+        return std::unexpected(msgid.error());
+    }
+    if (!*msgid)
+    {
+        return std::unexpected(IpmiError{0, "Unable to read reply."});
+    }
+
+    return **msgid;
+}
+
+IpmiResult<void> IpmiHandler::pollReadable(int timeoutMs,
+                                           std::chrono::nanoseconds* spent)
+{
+    Stopwatch timed(spent);
+
     /* Could use sdeventplus, but for only one type of event is it worth it? */
     pollfd pfd{};
     pfd.fd = fd;
     pfd.events = POLLIN;
 
+    int rc;
     do
     {
-        rc = sys->poll(&pfd, 1, ipmiReadTimeout);
-        if (rc < 0)
+        polls.fetch_add(1, std::memory_order_relaxed);
+        rc = sys->poll(&pfd, 1, timeoutMs);
+    } while (rc < 0 && errno == EINTR);
+
+    if (rc < 0)
+    {
+        return std::unexpected(IpmiError{0, "Polling Error occurred."});
+    }
+    else if (rc == 0)
+    {
+        return std::unexpected(IpmiError{0, replyTimeout});
+    }
+
+    return {};
+}
+
+IpmiResult<std::optional<long>> IpmiHandler::receiveNow(
+    IpmiReply& buffer, std::chrono::nanoseconds* spent)
+{
+    Stopwatch timed(spent);
+    constexpr int ipmiOk = 0;
+
+    std::span<std::uint8_t> responseBuffer = buffer.raw();
+    responseBuffer[0] = ipmiOk;
+
+    ipmi_system_interface_addr systemAddress{};
+    ipmi_recv reply{};
+    reply.addr = reinterpret_cast<unsigned char*>(&systemAddress);
+    reply.addr_len = sizeof(systemAddress);
+    reply.msg.data = responseBuffer.data();
+    reply.msg.data_len = responseBuffer.size();
+
+    errno = 0;
+    receives.fetch_add(1, std::memory_order_relaxed);
+    int rc = sys->ioctl(fd, IPMICTL_RECEIVE_MSG_TRUNC, &reply);
+    if (rc < 0)
+    {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
         {
-            if (errno == EINTR)
-            {
-                continue;
-            }
-            throw IpmiException("Polling Error occurred.");
+            return std::nullopt;
         }
-        else if (rc == 0)
+        return std::unexpected(IpmiError{0, "Unable to read reply."});
+    }
+
+    buffer.setData(0, reply.msg.data_len);
+    return reply.msgid;
+}
+
+void IpmiHandler::recordTimeout(const Pending& entry)
+{
+    if (congestion)
+    {
+        congestion->record(CongestionControl::Signal::timeout);
+    }
+    if (adaptiveTiming)
+    {
+        adaptiveTiming->recordTimeout(
+            entry.kind, std::chrono::duration_cast<std::chrono::microseconds>(
+                            Clock::now() - entry.sentAt));
+    }
+}
+
+IpmiHandler::Pending* IpmiHandler::deliver(long msgid, IpmiReply& buffer,
+                                           const ReceiveCost& cost)
+{
+    constexpr int ipmiOk = 0;
+
+    Pending* entry = findPending(msgid);
+    if (!entry || entry->done)
+    {
+        std::fprintf(stderr, "Received wrong message, trying again.\n");
+        if (latency && cost.waiter)
         {
-            throw IpmiException("Timeout waiting for reply.");
+            cost.waiter->wrongMessage += cost.poll + cost.receive;
         }
+        return nullptr;
+    }
+
+    /* The whole message, completion code included. */
+    std::span<const std::uint8_t> message = buffer.data();
+    if (entry->reply != &buffer)
+    {
+        std::copy(message.begin(), message.end(),
+                  entry->reply->raw().begin());
+    }
 
-        /* Yay, happy case! */
-        rc = sys->ioctl(fd, IPMICTL_RECEIVE_MSG_TRUNC, &reply);
-        if (rc < 0)
+    entry->done = true;
+    completions.fetch_add(1, std::memory_order_relaxed);
+    if (adaptiveTiming || latency)
+    {
+        auto roundTrip = Clock::now() - entry->sentAt;
+        if (adaptiveTiming)
         {
-            throw IpmiException("Unable to read reply.");
+            adaptiveTiming->record(
+                entry->kind,
+                std::chrono::duration_cast<std::chrono::microseconds>(
+                    roundTrip));
         }
-
-        if (request.msgid != reply.msgid)
+        if (latency)
         {
-            std::fprintf(stderr, "Received wrong message, trying again.\n");
+            latency->recordReply(entry->kind,
+                                 {cost.poll, cost.receive,
+                                  entry->wrongMessage, roundTrip});
         }
-    } while (request.msgid != reply.msgid);
+    }
+
+    std::uint8_t cc = message.empty() ? ipmiOk : message[0];
+    if (congestion)
+    {
+        congestion->record(signalOf(cc));
+    }
+    if (cc != ipmiOk)
+    {
+        entry->result = std::unexpected(IpmiError{cc, nullptr});
+    }
+    else
+    {
+        /* Strip the completion code. */
+        std::size_t size = message.empty() ? 0 : message.size() - 1;
+        entry->reply->setData(1, size);
+    }
 
-    if (responseBuffer[0] != ipmiOk)
+    return entry->callback ? entry : nullptr;
+}
+
+IpmiHandler::Pending* IpmiHandler::findPending(long msgid)
+{
+    for (Pending& entry : pending)
     {
-        throw IpmiException(static_cast<int>(responseBuffer[0]));
+        if (entry.inUse && entry.msgid == msgid)
+        {
+            return &entry;
+        }
     }
 
-    std::vector<std::uint8_t> returning;
-    auto dataLen = reply.msg.data_len - 1;
+    return nullptr;
+}
+
+bool IpmiHandler::awaitingReplies() const
+{
+    return std::any_of(pending.begin(), pending.end(), [](const Pending& p) {
+        return p.inUse && !p.done;
+    });
+}
+
+void IpmiHandler::Pending::claim(long id, IpmiReply* buffer,
+                                 IpmiCallback&& onReply)
+{
+    inUse = true;
+    done = false;
+    msgid = id;
+    reply = buffer;
+    result = {};
+    callback = std::move(onReply);
+    attempt = 0;
+    wrongMessage = std::chrono::nanoseconds(0);
+}
 
-    returning.insert(returning.begin(), responseBuffer.begin() + 1,
-                     responseBuffer.begin() + dataLen + 1);
+void IpmiHandler::Pending::start(const Budget& budget)
+{
+    kind = budget.kind;
+    sentAt = Clock::now();
+    deadline = sentAt + std::chrono::milliseconds(budget.timeoutMs);
+}
 
-    return returning;
+void IpmiHandler::Pending::release()
+{
+    inUse = false;
+    done = false;
+    reply = nullptr;
+    result = {};
+    callback = nullptr;
 }
 
 } // namespace ipmiblob
@@ -1,26 +1,77 @@
 #pragma once
 
 #include "internal/sys.hpp"
+#include "ipmi_congestion.hpp"
 #include "ipmi_interface.hpp"
+#include "ipmi_latency.hpp"
+#include "ipmi_timing.hpp"
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <span>
 #include <vector>
 
 namespace ipmiblob
 {
 
+/**
+ * System calls spent receiving replies, to tell how well each wakeup is
+ * amortised over the replies it collects.
+ */
+struct ReceiveStats
+{
+    std::uint64_t polls = 0;
+    std::uint64_t receives = 0;
+    /* Replies delivered to a request still waiting for them. */
+    std::uint64_t completions = 0;
+
+    /**
+     * @return polls and receives per reply delivered, or 0 before any.
+     */
+    double syscallsPerCompletion() const
+    {
+        return completions ? static_cast<double>(polls + receives) /
+                                 static_cast<double>(completions)
+                           : 0.0;
+    }
+};
+
 class IpmiHandler : public IpmiInterface
 {
   public:
-    /* Create an IpmiHandler object with default inputs. It is ill-advised to
-     * share IpmiHandlers between objects.
+    /* Create an IpmiHandler object with default inputs.  One handler may be
+     * shared by any number of threads: whichever thread is receiving hands
+     * each reply to the thread waiting on it.
+     */
+    static std::unique_ptr<IpmiInterface> CreateIpmiHandler(
+        std::size_t window = defaultWindow);
+
+    /**
+     * @param[in] sys - the system calls to use.
+     * @param[in] window - the most requests that may be submitted and not yet
+     *     waited for at any one time.
      */
-    static std::unique_ptr<IpmiInterface> CreateIpmiHandler();
+    explicit IpmiHandler(std::unique_ptr<internal::Sys> sys,
+                         std::size_t window = defaultWindow) :
+        sys(std::move(sys)), pending(window ? window : 1) {};
 
-    explicit IpmiHandler(std::unique_ptr<internal::Sys> sys) :
-        sys(std::move(sys)) {};
+    /* Requests in flight allowed by default. */
+    static constexpr std::size_t defaultWindow = 8;
+
+    /**
+     * A request submitted with trySubmit(), to be redeemed with tryWait().
+     */
+    struct Ticket
+    {
+        long msgid;
+    };
 
     ~IpmiHandler() = default;
     IpmiHandler(const IpmiHandler&) = delete;
@@ -42,7 +93,347 @@ class IpmiHandler : public IpmiInterface
         std::uint8_t netfn, std::uint8_t cmd,
         std::vector<std::uint8_t>& data) override;
 
+    /**
+     * Sends straight from data and has the kernel write the reply directly
+     * into the reply buffer, so a call on an open handler neither copies nor
+     * allocates.
+     *
+     * @throws IpmiException on failure.
+     */
+    std::span<const std::uint8_t> sendPacketInto(
+        std::uint8_t netfn, std::uint8_t cmd,
+        std::span<const std::uint8_t> data, IpmiReply& reply) override;
+
+    /**
+     * The primary implementation, which the throwing calls above wrap.  No
+     * exception is thrown on any failure, including a BMC completion code.
+     */
+    IpmiResult<std::span<const std::uint8_t>> trySendPacketInto(
+        std::uint8_t netfn, std::uint8_t cmd,
+        std::span<const std::uint8_t> data, IpmiReply& reply) override;
+
+    /**
+     * Send a request without waiting for its reply, so several can be in
+     * flight at once.  Replies are matched to requests by msgid and may
+     * arrive in any order; each is received into the reply buffer given
+     * here, which must stay alive until the ticket is waited for.
+     *
+     * @param[in] netfn - the netfn for the IPMI packet.
+     * @param[in] cmd - the command.
+     * @param[in] data - the IPMI packet contents, only read during the call.
+     * @param[out] reply - where to receive the reply.
+     * @return a ticket for tryWait(), or the failure, including a full
+     *     window.  The synchronous calls wait for a free slot instead.
+     */
+    IpmiResult<Ticket> trySubmit(std::uint8_t netfn, std::uint8_t cmd,
+                                 std::span<const std::uint8_t> data,
+                                 IpmiReply& reply);
+
+    /**
+     * Wait for the reply to a submitted request.  One waiting thread at a
+     * time reads from the device; replies to other outstanding requests are
+     * delivered to their own buffers and their waiters woken.  The ticket is
+     * spent whether or not the request succeeded.
+     *
+     * @param[in] ticket - from trySubmit().
+     * @return the bytes returned, as a view into the request's reply buffer.
+     */
+    IpmiResult<std::span<const std::uint8_t>> tryWait(Ticket ticket);
+
+    /**
+     * Send a request and return at once; callback is called when the reply
+     * arrives, from whichever thread receives it: processReadable(), or a
+     * thread blocked in a synchronous call on this handler.  Requests beyond
+     * the window are queued and sent as slots free up.
+     */
+    void submit(std::uint8_t netfn, std::uint8_t cmd,
+                std::span<const std::uint8_t> data,
+                IpmiCallback callback) override;
+
+    /**
+     * Open the device if needed and return its descriptor, for an event loop
+     * to watch for POLLIN.  The descriptor stays owned by this handler.
+     */
+    IpmiResult<int> tryGetFd();
+
+    /**
+     * Receive every reply already queued, without blocking, and complete
+     * their requests.  Call when the descriptor from tryGetFd() polls
+     * readable.  Stops at the first empty read, or as soon as no request is
+     * left waiting, so draining costs one read per reply and at most one
+     * more.
+     *
+     * @return a failure reading from the device; an empty queue is not one.
+     */
+    IpmiResult<void> processReadable();
+
+    /**
+     * Wait for the device to become readable, up to timerTimeoutMs(), then
+     * processReadable(), or processTimers() if it did not.  For callers
+     * without an event loop of their own.
+     *
+     * @return a failure to open, poll or read the device, or a timeout that
+     *     did not fail any request.
+     */
+    IpmiResult<void> processEvents();
+
+    /**
+     * @return how long an event loop may wait for the descriptor to become
+     *     readable before it must call processTimers(), in milliseconds.
+     */
+    int timerTimeoutMs();
+
+    /**
+     * Fail submit() requests whose replies are overdue, and resend those
+     * that are done backing off.
+     *
+     * @return whether any request was failed or resent.
+     */
+    bool processTimers();
+
+    /**
+     * Send every request with these kernel retry parameters, through
+     * IPMICTL_SEND_COMMAND_SETTIME, and wait for each reply only as long as
+     * they allow.  By default the kernel's own parameters apply and replies
+     * are waited for up to 15 seconds.  Set before making requests.
+     */
+    void setTiming(const IpmiTiming& timing);
+
+    /**
+     * Like setTiming(), but pick the timing of each request from the round
+     * trips seen so far for the same kind of request.
+     */
+    void setAdaptiveTiming(const AdaptiveTiming::Options& options);
+
+    /**
+     * Resend requests the BMC reports busy after a jittered exponential
+     * backoff, and limit the requests in flight to an AIMD window within
+     * window().  Requests that time out are resent only if
+     * options.retryTimeouts is set, which it is not by default, and only if
+     * they are idempotent, since the BMC may have carried out the first.
+     * Synchronous callers sleep through the backoff; submit() requests are
+     * requeued and resent by processTimers() once it has passed.  Set
+     * before making requests.
+     */
+    void setCongestionControl(const CongestionControl::Options& options);
+
+    /**
+     * @return the current window and retry counts; all zero but the window
+     *     unless setCongestionControl() was called.
+     */
+    CongestionStats congestionStats();
+
+    /**
+     * @return the polls and reads made so far and the replies they brought.
+     */
+    ReceiveStats receiveStats() const;
+
+    /**
+     * Time the send, poll and receive of every request from now on, and the
+     * wrong messages read while waiting for it, into histograms per kind of
+     * request.  While off this costs a branch per system call, and while on
+     * two clock reads per system call and a lock per request.  Set before
+     * making requests.
+     */
+    void setLatencyProfiling(bool enabled);
+
+    /**
+     * @return the latencies recorded since profiling was turned on, or
+     *     nullptr while it is off.
+     */
+    const LatencyProfile* latencyProfile() const
+    {
+        return latency.get();
+    }
+
+    /**
+     * @return the most requests that may be outstanding at once.
+     */
+    std::size_t window() const
+    {
+        return pending.size();
+    }
+
   private:
+    using Clock = std::chrono::steady_clock;
+
+    /* How a request is sent, and how long its reply may take. */
+    struct Budget
+    {
+        /* Kernel retry parameters, if the request is sent with them. */
+        std::optional<IpmiTiming> timing;
+        /* Where the round trip is recorded, for adaptive timing and the
+         * latency profile.
+         */
+        AdaptiveTiming::Kind kind;
+        int timeoutMs;
+    };
+
+    /* A submitted request, and its outcome once the reply is in. */
+    struct Pending
+    {
+        bool inUse = false;
+        bool done = false;
+        long msgid = 0;
+        IpmiReply* reply = nullptr;
+        IpmiResult<void> result;
+        /* Set for requests made with submit(), which reply into ownReply. */
+        IpmiCallback callback;
+        IpmiReply ownReply;
+        AdaptiveTiming::Kind kind = 0;
+        Clock::time_point sentAt;
+        /* When to give up waiting for the reply. */
+        Clock::time_point deadline;
+        /* With congestion control, what a submit() request needs to be
+         * resent, and how many times it has been.
+         */
+        std::uint8_t netfn = 0;
+        std::uint8_t cmd = 0;
+        std::vector<std::uint8_t> request;
+        int attempt = 0;
+        /* When profiling, time lost to wrong messages while waiting. */
+        std::chrono::nanoseconds wrongMessage{0};
+
+        void claim(long id, IpmiReply* buffer, IpmiCallback&& onReply);
+        /* Start the clock on a claimed slot. */
+        void start(const Budget& budget);
+        void release();
+    };
+
+    /* A submit() waiting for a free slot, or to be resent. */
+    struct Queued
+    {
+        std::uint8_t netfn;
+        std::uint8_t cmd;
+        std::vector<std::uint8_t> data;
+        IpmiCallback callback;
+        int attempt = 0;
+        /* Not to be sent before this, while backing off. */
+        Clock::time_point notBefore;
+    };
+
+    /* What receiving one message cost, when profiling latency. */
+    struct ReceiveCost
+    {
+        /* The request whose wait the message was received in, if any. */
+        Pending* waiter = nullptr;
+        std::chrono::nanoseconds poll{0};
+        std::chrono::nanoseconds receive{0};
+    };
+
+    /* open(), reporting failure by value. */
+    IpmiResult<void> tryOpen();
+
+    IpmiResult<Ticket> submitTicket(std::uint8_t netfn, std::uint8_t cmd,
+                                    std::span<const std::uint8_t> data,
+                                    IpmiReply& reply, bool waitForSlot);
+
+    /**
+     * Find a free slot, waiting for one if asked to.  Called with stateMutex
+     * held through lock.
+     */
+    Pending* claimSlot(std::unique_lock<std::mutex>& lock, bool waitForSlot);
+
+    Budget budgetFor(std::uint8_t netfn, std::uint8_t cmd,
+                     std::span<const std::uint8_t> data);
+
+    IpmiResult<void> sendRequest(long msgid, std::uint8_t netfn,
+                                 std::uint8_t cmd,
+                                 std::span<const std::uint8_t> data,
+                                 const Budget& budget);
+
+    /**
+     * Send queued submit() requests that are due while there are free slots.
+     * Those that cannot be sent are settled here, in the same loop.
+     *
+     * @return whether any were sent.
+     */
+    bool startQueued();
+
+    /* Run the callback of a completed submit() and free its slot, then send
+     * what was queued behind it.
+     */
+    void finishAsync(Pending* entry);
+
+    /* Requeue a failed submit() for retry, or run its callback, and free its
+     * slot; finishAsync() without starting the backlog.
+     */
+    void settleAsync(Pending* entry);
+
+    /**
+     * Complete a submit() whose request could not be sent.
+     *
+     * @return whether the caller should settle it, as nobody else has
+     *     completed it meanwhile.
+     */
+    bool failSent(Pending* entry, const IpmiError& error);
+
+    /**
+     * Wait for the next message from the driver and receive it into buffer.
+     * Called without stateMutex held.
+     *
+     * @param[in] queued - whether the last read found a message, so another
+     *     may already be queued; if so, read before polling.
+     * @param[in,out] cost - what the polls and reads took, when profiling.
+     * @return the msgid of the message.
+     */
+    IpmiResult<long> receiveOne(IpmiReply& buffer, int timeoutMs, bool queued,
+                                ReceiveCost& cost);
+
+    /**
+     * Wait for the device to become readable.
+     *
+     * @param[in,out] spent - if given, the time taken is added to it.
+     */
+    IpmiResult<void> pollReadable(int timeoutMs,
+                                  std::chrono::nanoseconds* spent = nullptr);
+
+    /**
+     * @return how long until the first outstanding request is overdue.
+     *     Called with stateMutex held.
+     */
+    int nextTimeoutMs() const;
+
+    /**
+     * Fail the submit() requests whose replies are overdue.
+     *
+     * @return whether any were failed.
+     */
+    bool expireOverdue();
+
+    /**
+     * Receive a message into buffer without waiting.
+     *
+     * @param[in,out] spent - if given, the time taken is added to it.
+     * @return the msgid of the message, or nullopt if none was queued.
+     */
+    IpmiResult<std::optional<long>> receiveNow(
+        IpmiReply& buffer, std::chrono::nanoseconds* spent = nullptr);
+
+    /**
+     * Complete the request answered by the message in buffer, if it is still
+     * pending.  Called with stateMutex held.
+     *
+     * @param[in] cost - what receiving the message took, recorded against
+     *     the request it answers, or against the waiter if none.
+     * @return the entry if it was made with submit(), for finishAsync().
+     */
+    Pending* deliver(long msgid, IpmiReply& buffer, const ReceiveCost& cost);
+
+    /**
+     * Account for the reply to entry not coming in time, in the congestion
+     * window and the adaptive timing.  Called with stateMutex held.
+     */
+    void recordTimeout(const Pending& entry);
+
+    Pending* findPending(long msgid);
+
+    /**
+     * @return whether any sent request still waits for its reply.  Called
+     *     with stateMutex held.
+     */
+    bool awaitingReplies() const;
+
     const std::unique_ptr<internal::Sys> sys;
     /** TODO: Use a smart file descriptor when it's ready.  Until then only
      * allow moving this object.
@@ -53,6 +444,36 @@ class IpmiHandler : public IpmiInterface
 
     // Protect the open fd between different threads
     std::mutex openMutex;
+
+    /* Protects pending, backlog and receiving. */
+    std::mutex stateMutex;
+    /* Signalled when a request completes, a slot frees up, or the receiving
+     * thread steps down.
+     */
+    std::condition_variable stateChanged;
+    /* Whether some thread is reading from the device. */
+    bool receiving = false;
+
+    /* One slot per request that may be outstanding; sized once so that
+     * submitting never allocates.
+     */
+    std::vector<Pending> pending;
+    std::deque<Queued> backlog;
+    /* Where processReadable() receives. */
+    IpmiReply readableBuffer;
+
+    /* Kernel retry parameters for every request, if set. */
+    std::optional<IpmiTiming> fixedTiming;
+    std::unique_ptr<AdaptiveTiming> adaptiveTiming;
+    /* Guarded by stateMutex once requests are being made. */
+    std::unique_ptr<CongestionControl> congestion;
+    /* Set before requests are made, if profiling. */
+    std::unique_ptr<LatencyProfile> latency;
+
+    /* For receiveStats(); bumped without stateMutex. */
+    std::atomic<std::uint64_t> polls = 0;
+    std::atomic<std::uint64_t> receives = 0;
+    std::atomic<std::uint64_t> completions = 0;
 };
 
 } // namespace ipmiblob
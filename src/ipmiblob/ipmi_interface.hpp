@@ -1,11 +1,74 @@
 #pragma once
 
+#include "ipmi_errors.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
 #include <vector>
 
 namespace ipmiblob
 {
 
+/**
+ * Receive buffer for an IPMI reply.  The object owns the storage so it can
+ * be kept and reused from one request to the next; data() is a view of the
+ * reply within it and is valid until the object is used again.
+ */
+class IpmiReply
+{
+  public:
+    /* The largest message the kernel passes, IPMI_MAX_MSG_LENGTH. */
+    static constexpr std::size_t capacity = 272;
+
+    /**
+     * @return the reply bytes, without the completion code.
+     */
+    std::span<const std::uint8_t> data() const
+    {
+        return std::span(buffer).subspan(offset, length);
+    }
+
+    /**
+     * The whole buffer, for a transport to receive into.
+     */
+    std::span<std::uint8_t> raw()
+    {
+        return buffer;
+    }
+
+    /**
+     * Record where in raw() the transport left the reply bytes.
+     *
+     * @throws IpmiException if the range is outside the buffer.
+     */
+    void setData(std::size_t start, std::size_t size)
+    {
+        if (start > buffer.size() || size > buffer.size() - start)
+        {
+            throw IpmiException("Reply too large for buffer.");
+        }
+        offset = start;
+        length = size;
+    }
+
+  private:
+    std::array<std::uint8_t, capacity> buffer;
+    std::size_t offset = 0;
+    std::size_t length = 0;
+};
+
+/**
+ * Receives the outcome of a request made with IpmiInterface::submit().  The
+ * reply bytes are only valid for the duration of the call.
+ */
+using IpmiCallback =
+    std::function<void(IpmiResult<std::span<const std::uint8_t>>)>;
+
 class IpmiInterface
 {
   public:
@@ -23,6 +86,82 @@ class IpmiInterface
     virtual std::vector<std::uint8_t> sendPacket(
         std::uint8_t netfn, std::uint8_t cmd,
         std::vector<std::uint8_t>& data) = 0;
+
+    /**
+     * Send an IPMI packet to the BMC, receiving the reply into a caller-owned
+     * buffer.  Implementations that can should override this to receive in
+     * place without any heap allocation; the default forwards to
+     * sendPacket() and copies the result.
+     *
+     * @param[in] netfn - the netfn for the IPMI packet.
+     * @param[in] cmd - the command.
+     * @param[in] data - the IPMI packet contents.
+     * @param[out] reply - where to receive the reply.
+     * @return the bytes returned, as a view into reply.
+     * @throws IpmiException on failure, or if the reply does not fit.
+     */
+    virtual std::span<const std::uint8_t> sendPacketInto(
+        std::uint8_t netfn, std::uint8_t cmd,
+        std::span<const std::uint8_t> data, IpmiReply& reply)
+    {
+        std::vector<std::uint8_t> request(data.begin(), data.end());
+        std::vector<std::uint8_t> returned = sendPacket(netfn, cmd, request);
+
+        reply.setData(0, returned.size());
+        std::copy(returned.begin(), returned.end(), reply.raw().begin());
+        return reply.data();
+    }
+
+    /**
+     * Send an IPMI packet to the BMC like sendPacketInto(), but report
+     * failures by value.  A completion code from the BMC comes back in the
+     * error rather than as an exception, which keeps busy retries cheap.
+     * Implementations should override this; the default catches the
+     * IpmiException thrown by sendPacketInto(), copying the text of a
+     * host-side failure.
+     *
+     * @param[in] netfn - the netfn for the IPMI packet.
+     * @param[in] cmd - the command.
+     * @param[in] data - the IPMI packet contents.
+     * @param[out] reply - where to receive the reply.
+     * @return the bytes returned, as a view into reply, or the failure.
+     */
+    virtual IpmiResult<std::span<const std::uint8_t>> trySendPacketInto(
+        std::uint8_t netfn, std::uint8_t cmd,
+        std::span<const std::uint8_t> data, IpmiReply& reply)
+    {
+        try
+        {
+            return sendPacketInto(netfn, cmd, data, reply);
+        }
+        catch (const IpmiException& e)
+        {
+            if (e.code() != 0)
+            {
+                return std::unexpected(IpmiError{e.code()});
+            }
+            return std::unexpected(IpmiError(std::string(e.what())));
+        }
+    }
+
+    /**
+     * Send an IPMI packet to the BMC and have callback called with the
+     * outcome, without waiting for it.  Implementations backed by an event
+     * loop complete the request later; the default completes it before
+     * returning, through trySendPacketInto().
+     *
+     * @param[in] netfn - the netfn for the IPMI packet.
+     * @param[in] cmd - the command.
+     * @param[in] data - the IPMI packet contents, only read during the call.
+     * @param[in] callback - called exactly once with the reply or failure.
+     */
+    virtual void submit(std::uint8_t netfn, std::uint8_t cmd,
+                        std::span<const std::uint8_t> data,
+                        IpmiCallback callback)
+    {
+        IpmiReply reply;
+        callback(trySendPacketInto(netfn, cmd, data, reply));
+    }
 };
 
 } // namespace ipmiblob
@@ -0,0 +1,136 @@
+#include "ipmi_latency.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace ipmiblob
+{
+
+void LatencyHistogram::record(std::chrono::nanoseconds duration)
+{
+    auto ns = static_cast<std::uint64_t>(
+        std::max<std::chrono::nanoseconds::rep>(duration.count(), 0));
+    std::size_t bucket =
+        std::min<std::size_t>(std::bit_width(ns), buckets - 1);
+    bucketCounts[bucket]++;
+    samples++;
+    sum += std::chrono::nanoseconds(ns);
+    longest = std::max(longest, std::chrono::nanoseconds(ns));
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    for (std::size_t i = 0; i < buckets; ++i)
+    {
+        bucketCounts[i] += other.bucketCounts[i];
+    }
+    samples += other.samples;
+    sum += other.sum;
+    longest = std::max(longest, other.longest);
+}
+
+std::chrono::nanoseconds LatencyHistogram::mean() const
+{
+    if (!samples)
+    {
+        return std::chrono::nanoseconds(0);
+    }
+
+    return sum / samples;
+}
+
+std::chrono::nanoseconds LatencyHistogram::percentile(double fraction) const
+{
+    if (!samples)
+    {
+        return std::chrono::nanoseconds(0);
+    }
+
+    /* The rank of the duration wanted, counting from 1. */
+    auto rank = static_cast<std::uint64_t>(
+        std::ceil(std::clamp(fraction, 0.0, 1.0) * samples));
+    rank = std::max<std::uint64_t>(rank, 1);
+
+    std::uint64_t seen = 0;
+    std::size_t bucket = 0;
+    for (; bucket < buckets - 1; ++bucket)
+    {
+        seen += bucketCounts[bucket];
+        if (seen >= rank)
+        {
+            break;
+        }
+    }
+
+    if (bucket == buckets - 1)
+    {
+        return longest;
+    }
+    return std::min(longest,
+                    std::chrono::nanoseconds(std::int64_t{1} << bucket));
+}
+
+void LatencyBreakdown::merge(const LatencyBreakdown& other)
+{
+    send.merge(other.send);
+    poll.merge(other.poll);
+    receive.merge(other.receive);
+    wrongMessage.merge(other.wrongMessage);
+    roundTrip.merge(other.roundTrip);
+}
+
+void LatencyProfile::recordSend(Kind kind, std::chrono::nanoseconds duration)
+{
+    std::lock_guard lock(profileMutex);
+    breakdowns[kind].send.record(duration);
+}
+
+void LatencyProfile::recordReply(Kind kind, const ReplyCost& cost)
+{
+    std::lock_guard lock(profileMutex);
+    LatencyBreakdown& breakdown = breakdowns[kind];
+    if (cost.poll.count())
+    {
+        breakdown.poll.record(cost.poll);
+    }
+    breakdown.receive.record(cost.receive);
+    if (cost.wrongMessage.count())
+    {
+        breakdown.wrongMessage.record(cost.wrongMessage);
+    }
+    breakdown.roundTrip.record(cost.roundTrip);
+}
+
+LatencyProfile::Report LatencyProfile::byKind() const
+{
+    std::lock_guard lock(profileMutex);
+    return Report(breakdowns.begin(), breakdowns.end());
+}
+
+LatencyProfile::Report LatencyProfile::byCommand() const
+{
+    /* kindOf() keeps the blob subcommand in the low byte. */
+    constexpr Kind commandMask = ~Kind{0xff};
+
+    std::lock_guard lock(profileMutex);
+    Report report;
+    for (const auto& [kind, breakdown] : breakdowns)
+    {
+        report[kind & commandMask].merge(breakdown);
+    }
+
+    return report;
+}
+
+void LatencyProfile::reset()
+{
+    std::lock_guard lock(profileMutex);
+    breakdowns.clear();
+}
+
+} // namespace ipmiblob
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "ipmi_timing.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace ipmiblob
+{
+
+/**
+ * Counts durations in power-of-two buckets of nanoseconds, so recording is
+ * a few instructions and the histogram a fixed size whatever the range.
+ */
+class LatencyHistogram
+{
+  public:
+    /* Bucket i counts durations below 2^i ns and at least 2^(i-1) ns; the
+     * last also counts anything longer, from about 9 minutes.
+     */
+    static constexpr std::size_t buckets = 40;
+
+    void record(std::chrono::nanoseconds duration);
+
+    /* Add the counts of another histogram to this one. */
+    void merge(const LatencyHistogram& other);
+
+    std::uint64_t count() const
+    {
+        return samples;
+    }
+
+    std::chrono::nanoseconds total() const
+    {
+        return sum;
+    }
+
+    std::chrono::nanoseconds max() const
+    {
+        return longest;
+    }
+
+    /**
+     * @return the mean duration, or 0 before any.
+     */
+    std::chrono::nanoseconds mean() const;
+
+    /**
+     * @param[in] fraction - of the durations, between 0 and 1.
+     * @return an upper bound on that fraction of the durations: the top of
+     *     the bucket holding it, or the longest seen if that is lower.  0
+     *     before any.
+     */
+    std::chrono::nanoseconds percentile(double fraction) const;
+
+    const std::array<std::uint64_t, buckets>& counts() const
+    {
+        return bucketCounts;
+    }
+
+  private:
+    std::array<std::uint64_t, buckets> bucketCounts{};
+    std::uint64_t samples = 0;
+    std::chrono::nanoseconds sum{0};
+    std::chrono::nanoseconds longest{0};
+};
+
+/**
+ * Where the time of the requests of one kind went.
+ */
+struct LatencyBreakdown
+{
+    /* The ioctl sending the request. */
+    LatencyHistogram send;
+    /* Waiting in poll for the reply; nothing is recorded for replies read
+     * without polling, such as those already queued or those read by
+     * processReadable() when an event loop saw the device readable.
+     */
+    LatencyHistogram poll;
+    /* The ioctl receiving the reply. */
+    LatencyHistogram receive;
+    /* Polls and reads that brought a message for no request, made while
+     * waiting for one of this kind; recorded per request that was delayed.
+     */
+    LatencyHistogram wrongMessage;
+    /* From sending the request to its reply being delivered. */
+    LatencyHistogram roundTrip;
+
+    void merge(const LatencyBreakdown& other);
+};
+
+/**
+ * Latency of each stage of a request, per kind of request as told apart by
+ * AdaptiveTiming::kindOf(): netfn, command and, for blob requests, the blob
+ * subcommand.  Safe to use from several threads.
+ */
+class LatencyProfile
+{
+  public:
+    using Kind = AdaptiveTiming::Kind;
+    using Report = std::map<Kind, LatencyBreakdown>;
+
+    /* What receiving the reply to one request cost. */
+    struct ReplyCost
+    {
+        /* Zero if the reply was read without polling. */
+        std::chrono::nanoseconds poll{0};
+        std::chrono::nanoseconds receive{0};
+        /* Spent on wrong messages while waiting for this reply. */
+        std::chrono::nanoseconds wrongMessage{0};
+        std::chrono::nanoseconds roundTrip{0};
+    };
+
+    void recordSend(Kind kind, std::chrono::nanoseconds duration);
+
+    void recordReply(Kind kind, const ReplyCost& cost);
+
+    /**
+     * @return the breakdown of every kind seen so far.
+     */
+    Report byKind() const;
+
+    /**
+     * @return the breakdown per netfn and command, with the blob
+     *     subcommands of each merged; the subcommand byte of each kind is 0.
+     */
+    Report byCommand() const;
+
+    void reset();
+
+  private:
+    mutable std::mutex profileMutex;
+    std::unordered_map<Kind, LatencyBreakdown> breakdowns;
+};
+
+} // namespace ipmiblob
@@ -0,0 +1,178 @@
+#include "ipmi_pool.hpp"
+
+#include "blob_handler.hpp"
+#include "blob_interface.hpp"
+#include "blob_layout.hpp"
+#include "internal/blob_reply.hpp"
+#include "ipmi_handler.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace ipmiblob
+{
+
+std::unique_ptr<IpmiInterface> IpmiPool::CreateIpmiPool(std::size_t size)
+{
+    std::vector<std::unique_ptr<IpmiInterface>> handles;
+    for (std::size_t i = 0; i < std::max<std::size_t>(size, 1); ++i)
+    {
+        handles.push_back(IpmiHandler::CreateIpmiHandler());
+    }
+
+    return std::make_unique<IpmiPool>(std::move(handles));
+}
+
+IpmiPool::IpmiPool(std::vector<std::unique_ptr<IpmiInterface>> handles) :
+    handles(std::move(handles)), load(this->handles.size(), 0)
+{
+    if (this->handles.empty())
+    {
+        throw IpmiException("IPMI pool needs at least one handle.");
+    }
+}
+
+std::vector<std::uint8_t> IpmiPool::sendPacket(std::uint8_t netfn,
+                                               std::uint8_t cmd,
+                                               std::vector<std::uint8_t>& data)
+{
+    IpmiReply reply;
+    std::span<const std::uint8_t> returned =
+        sendPacketInto(netfn, cmd, data, reply);
+    return std::vector<std::uint8_t>(returned.begin(), returned.end());
+}
+
+std::span<const std::uint8_t> IpmiPool::sendPacketInto(
+    std::uint8_t netfn, std::uint8_t cmd, std::span<const std::uint8_t> data,
+    IpmiReply& reply)
+{
+    auto returned = trySendPacketInto(netfn, cmd, data, reply);
+    if (!returned)
+    {
+        throw IpmiException(returned.error());
+    }
+
+    return *returned;
+}
+
+IpmiResult<std::span<const std::uint8_t>> IpmiPool::trySendPacketInto(
+    std::uint8_t netfn, std::uint8_t cmd, std::span<const std::uint8_t> data,
+    IpmiReply& reply)
+{
+    Route route = acquire(netfn, cmd, data);
+    auto returned =
+        handles[route.index]->trySendPacketInto(netfn, cmd, data, reply);
+    release(route, returned);
+    return returned;
+}
+
+void IpmiPool::submit(std::uint8_t netfn, std::uint8_t cmd,
+                      std::span<const std::uint8_t> data,
+                      IpmiCallback callback)
+{
+    Route route = acquire(netfn, cmd, data);
+    handles[route.index]->submit(
+        netfn, cmd, data,
+        [this, route, callback = std::move(callback)](
+            IpmiResult<std::span<const std::uint8_t>> returned) {
+            release(route, returned);
+            callback(std::move(returned));
+        });
+}
+
+IpmiPool::Route IpmiPool::acquire(std::uint8_t netfn, std::uint8_t cmd,
+                                  std::span<const std::uint8_t> data)
+{
+    using layout::RequestHeader;
+    using layout::SessionRequest;
+
+    Route route;
+    std::optional<std::uint16_t> session;
+
+    if (netfn == ipmiOEMNetFn && cmd == ipmiOEMBlobCmd &&
+        data.size() > RequestHeader::command::offset)
+    {
+        auto command = static_cast<BlobOEMCommands>(
+            RequestHeader::command::load(data.data()));
+        switch (command)
+        {
+            case BlobOEMCommands::bmcBlobOpen:
+                route.learn = Route::Learn::opened;
+                break;
+            case BlobOEMCommands::bmcBlobClose:
+                route.learn = Route::Learn::closed;
+                [[fallthrough]];
+            case BlobOEMCommands::bmcBlobRead:
+            case BlobOEMCommands::bmcBlobWrite:
+            case BlobOEMCommands::bmcBlobCommit:
+            case BlobOEMCommands::bmcBlobSessionStat:
+            case BlobOEMCommands::bmcBlobWriteMeta:
+                /* Every session command leads with the session id. */
+                if (data.size() >= RequestHeader::size + SessionRequest::size)
+                {
+                    session = SessionRequest::session::load(
+                        data.data() + RequestHeader::size);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    std::lock_guard lock(routeMutex);
+
+    auto known = session ? sessions.find(*session) : sessions.end();
+    if (known != sessions.end())
+    {
+        route.index = known->second;
+        route.session = *session;
+    }
+    else
+    {
+        route.index = std::min_element(load.begin(), load.end()) - load.begin();
+        route.learn = (route.learn == Route::Learn::opened)
+                          ? Route::Learn::opened
+                          : Route::Learn::nothing;
+    }
+
+    load[route.index]++;
+    return route;
+}
+
+void IpmiPool::release(const Route& route,
+                       const IpmiResult<std::span<const std::uint8_t>>& outcome)
+{
+    using layout::OpenResponse;
+
+    std::lock_guard lock(routeMutex);
+    load[route.index]--;
+
+    if (!outcome)
+    {
+        return;
+    }
+
+    if (route.learn == Route::Learn::opened)
+    {
+        /* Only a session the BMC really granted is worth routing by. */
+        auto payload = internal::unwrapReply(outcome);
+        if (payload && payload->size() == OpenResponse::size)
+        {
+            sessions[OpenResponse::session::load(payload->data())] =
+                route.index;
+        }
+    }
+    else if (route.learn == Route::Learn::closed)
+    {
+        sessions.erase(route.session);
+    }
+}
+
+} // namespace ipmiblob
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "ipmi_interface.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace ipmiblob
+{
+
+/**
+ * Spreads requests over several handles to the IPMI device.  The kernel
+ * queues requests per open file, so one handle serialises every caller; a
+ * pool lets concurrent blob sessions proceed in parallel, up to what the BMC
+ * itself allows.
+ *
+ * Each request goes to the handle with the fewest requests outstanding,
+ * except that blob requests naming a session go to the handle the session
+ * was opened on, which keeps each session's requests in order.  Sessions are
+ * learned from the replies to blob opens and forgotten once closed.
+ */
+class IpmiPool : public IpmiInterface
+{
+  public:
+    /* Handles opened by default. */
+    static constexpr std::size_t defaultSize = 4;
+
+    /**
+     * Create a pool of IpmiHandlers, each with its own descriptor.
+     *
+     * @param[in] size - the number of handles to open.
+     */
+    static std::unique_ptr<IpmiInterface> CreateIpmiPool(
+        std::size_t size = defaultSize);
+
+    /**
+     * @param[in] handles - the transports to spread requests over.
+     * @throws IpmiException if handles is empty.
+     */
+    explicit IpmiPool(std::vector<std::unique_ptr<IpmiInterface>> handles);
+
+    ~IpmiPool() = default;
+    IpmiPool(const IpmiPool&) = delete;
+    IpmiPool& operator=(const IpmiPool&) = delete;
+    IpmiPool(IpmiPool&&) = delete;
+    IpmiPool& operator=(IpmiPool&&) = delete;
+
+    /**
+     * @throws IpmiException on failure.
+     */
+    std::vector<std::uint8_t> sendPacket(
+        std::uint8_t netfn, std::uint8_t cmd,
+        std::vector<std::uint8_t>& data) override;
+
+    /**
+     * @throws IpmiException on failure.
+     */
+    std::span<const std::uint8_t> sendPacketInto(
+        std::uint8_t netfn, std::uint8_t cmd,
+        std::span<const std::uint8_t> data, IpmiReply& reply) override;
+
+    /**
+     * The primary implementation, which the throwing calls above wrap.
+     */
+    IpmiResult<std::span<const std::uint8_t>> trySendPacketInto(
+        std::uint8_t netfn, std::uint8_t cmd,
+        std::span<const std::uint8_t> data, IpmiReply& reply) override;
+
+    /**
+     * Hand the request to the chosen handle's submit(); callback runs
+     * wherever that handle completes it.
+     */
+    void submit(std::uint8_t netfn, std::uint8_t cmd,
+                std::span<const std::uint8_t> data,
+                IpmiCallback callback) override;
+
+    /**
+     * @return the number of handles in the pool.
+     */
+    std::size_t size() const
+    {
+        return handles.size();
+    }
+
+  private:
+    /* Where a request went, and what its reply may teach about sessions. */
+    struct Route
+    {
+        enum class Learn
+        {
+            nothing,
+            opened,
+            closed,
+        };
+
+        std::size_t index = 0;
+        Learn learn = Learn::nothing;
+        std::uint16_t session = 0;
+    };
+
+    /* Choose a handle for a request and count the request against it. */
+    Route acquire(std::uint8_t netfn, std::uint8_t cmd,
+                  std::span<const std::uint8_t> data);
+
+    /**
+     * Count the request as finished, and record or forget its session.
+     *
+     * @param[in] route - from acquire().
+     * @param[in] outcome - the reply or failure.
+     */
+    void release(const Route& route,
+                 const IpmiResult<std::span<const std::uint8_t>>& outcome);
+
+    const std::vector<std::unique_ptr<IpmiInterface>> handles;
+
+    /* Protects load and sessions. */
+    std::mutex routeMutex;
+    /* Requests outstanding on each handle. */
+    std::vector<std::size_t> load;
+    /* The handle each open blob session lives on. */
+    std::unordered_map<std::uint16_t, std::size_t> sessions;
+};
+
+} // namespace ipmiblob
@@ -0,0 +1,637 @@
+#include "ipmi_proxy.hpp"
+
+#include "ipmi_errors.hpp"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <expected>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ipmiblob
+{
+
+namespace
+{
+
+std::vector<std::uint8_t> replyFrame(
+    std::uint32_t id, const IpmiResult<std::span<const std::uint8_t>>& outcome)
+{
+    using proxy::ReplyFrame;
+    using proxy::Status;
+
+    std::size_t dataSize = outcome ? outcome->size() : 0;
+    std::vector<std::uint8_t> frame(ReplyFrame::size + dataSize);
+    Status status = outcome ? Status::ok : Status::failed;
+    std::uint8_t code =
+        outcome ? 0 : static_cast<std::uint8_t>(outcome.error().code);
+    ReplyFrame::encode(ReplyFrame::Buffer(frame.data(), ReplyFrame::size), id,
+                       static_cast<std::uint8_t>(status), code);
+    if (outcome)
+    {
+        std::copy(outcome->begin(), outcome->end(),
+                  frame.begin() + ReplyFrame::size);
+    }
+
+    return frame;
+}
+
+/* The descriptors passed with a message, which the caller must close. */
+std::vector<int> passedFds(const msghdr& message)
+{
+    std::vector<int> fds;
+    for (cmsghdr* header = CMSG_FIRSTHDR(&message); header;
+         header = CMSG_NXTHDR(const_cast<msghdr*>(&message), header))
+    {
+        if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+        {
+            continue;
+        }
+
+        std::size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const unsigned char* data = CMSG_DATA(header);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            int fd;
+            std::memcpy(&fd, data + i * sizeof(int), sizeof(int));
+            fds.push_back(fd);
+        }
+    }
+
+    return fds;
+}
+
+} // namespace
+
+namespace proxy
+{
+
+IpmiResult<int> connectTo(const std::string& path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        return std::unexpected(IpmiError{0, "IPMI proxy path is too long."});
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address),
+                            sizeof(address)) < 0)
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        return std::unexpected(
+            IpmiError{0, "Unable to connect to the IPMI proxy."});
+    }
+
+    return fd;
+}
+
+IpmiResult<std::span<const std::uint8_t>> decodeReply(
+    std::span<const std::uint8_t> frame)
+{
+    auto [id, status, code] = ReplyFrame::decode(
+        ReplyFrame::ConstBuffer(frame.data(), ReplyFrame::size));
+    if (status != static_cast<std::uint8_t>(Status::ok))
+    {
+        const char* reason =
+            code ? nullptr : "IPMI proxy could not complete the request.";
+        return std::unexpected(IpmiError{code, reason});
+    }
+
+    return frame.subspan(ReplyFrame::size);
+}
+
+} // namespace proxy
+
+IpmiProxyServer::IpmiProxyServer(std::unique_ptr<IpmiInterface> backend) :
+    IpmiProxyServer(std::move(backend), Options{})
+{}
+
+IpmiProxyServer::IpmiProxyServer(std::unique_ptr<IpmiInterface> backend,
+                                 const Options& options) :
+    options(options), backend(std::move(backend))
+{
+    if (!this->backend)
+    {
+        throw IpmiException("IPMI proxy needs a transport.");
+    }
+
+    handler = dynamic_cast<IpmiHandler*>(this->backend.get());
+    wakeFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wakeFd < 0)
+    {
+        throw IpmiException("Unable to create IPMI proxy wakeup.");
+    }
+}
+
+IpmiProxyServer::~IpmiProxyServer()
+{
+    /* Anything it completes on the way out still needs wakeFd. */
+    backend.reset();
+    for (auto& [id, client] : clients)
+    {
+        ::close(client.fd);
+    }
+    if (listenFd >= 0)
+    {
+        ::close(listenFd);
+        ::unlink(socketPath.c_str());
+    }
+    ::close(wakeFd);
+}
+
+IpmiResult<void> IpmiProxyServer::listen(const std::string& path)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        return std::unexpected(IpmiError{0, "IPMI proxy path is too long."});
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK,
+                      0);
+    if (fd < 0)
+    {
+        return std::unexpected(IpmiError{0, "Unable to create IPMI proxy."});
+    }
+
+    /* A socket left behind by an earlier run would fail the bind. */
+    ::unlink(path.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) <
+            0 ||
+        ::listen(fd, SOMAXCONN) < 0)
+    {
+        ::close(fd);
+        return std::unexpected(
+            IpmiError{0, "Unable to listen on IPMI proxy socket."});
+    }
+
+    listenFd = fd;
+    socketPath = path;
+    return {};
+}
+
+void IpmiProxyServer::stop()
+{
+    stopping = true;
+    std::uint64_t one = 1;
+    [[maybe_unused]] auto written = ::write(wakeFd, &one, sizeof(one));
+}
+
+IpmiResult<void> IpmiProxyServer::run()
+{
+    if (listenFd < 0)
+    {
+        return std::unexpected(IpmiError{0, "IPMI proxy is not listening."});
+    }
+
+    int backendFd = -1;
+    if (handler)
+    {
+        auto fd = handler->tryGetFd();
+        if (!fd)
+        {
+            return std::unexpected(fd.error());
+        }
+        backendFd = *fd;
+    }
+
+    /* wakeFd, listenFd and backendFd, then each client's socket and the
+     * doorbell of its channel, if any.
+     */
+    constexpr std::size_t fixedFds = 3;
+    struct Polled
+    {
+        std::uint64_t client;
+        bool bell;
+    };
+    std::vector<pollfd> fds;
+    std::vector<Polled> polled;
+    while (!stopping)
+    {
+        fds.assign(fixedFds, pollfd{});
+        fds[0] = {wakeFd, POLLIN, 0};
+        fds[1] = {listenFd, POLLIN, 0};
+        fds[2] = {backendFd, POLLIN, 0};
+        polled.clear();
+        int timeoutMs = handler ? handler->timerTimeoutMs() : -1;
+        for (auto& [id, client] : clients)
+        {
+            bool room = hasRoom(client);
+            short events = 0;
+            if (room)
+            {
+                events |= POLLIN;
+            }
+            if (!client.replies.empty() && !client.channel)
+            {
+                events |= POLLOUT;
+            }
+            fds.push_back({client.fd, events, 0});
+            polled.push_back({id, false});
+
+            if (client.channel)
+            {
+                fds.push_back({client.channel->serverBell, POLLIN, 0});
+                polled.push_back({id, true});
+                /* Frames left behind by a full queue ring no bell. */
+                if (room && !client.channel->requests.front().empty())
+                {
+                    timeoutMs = 0;
+                }
+            }
+        }
+
+        int rc = ::poll(fds.data(), fds.size(), timeoutMs);
+        if (rc < 0 && errno != EINTR)
+        {
+            return std::unexpected(IpmiError{0, "Polling Error occurred."});
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            std::uint64_t count;
+            [[maybe_unused]] auto drained =
+                ::read(wakeFd, &count, sizeof(count));
+        }
+        if (fds[1].revents & POLLIN)
+        {
+            acceptClients();
+        }
+        if (handler)
+        {
+            if (fds[2].revents & POLLIN)
+            {
+                if (auto processed = handler->processReadable(); !processed)
+                {
+                    std::fprintf(stderr, "IPMI proxy: %s\n",
+                                 processed.error().message().c_str());
+                }
+            }
+            handler->processTimers();
+        }
+
+        for (std::size_t i = 0; i < polled.size(); ++i)
+        {
+            const pollfd& entry = fds[fixedFds + i];
+            auto found = clients.find(polled[i].client);
+            if (found == clients.end())
+            {
+                continue;
+            }
+
+            Client& client = found->second;
+            bool alive = !(entry.revents & (POLLERR | POLLNVAL));
+            if (polled[i].bell)
+            {
+                if (entry.revents & POLLIN)
+                {
+                    internal::ShmChannel::drain(client.channel->serverBell);
+                }
+            }
+            else if (alive && (entry.revents & POLLHUP) && !hasRoom(client))
+            {
+                /* Gone, so nothing it is still to be sent is wanted. */
+                alive = false;
+            }
+            else if (alive && (entry.revents & (POLLIN | POLLHUP)))
+            {
+                alive = readRequests(client);
+            }
+            if (alive && client.channel)
+            {
+                alive = readChannel(client);
+            }
+            if (!alive)
+            {
+                dropClient(polled[i].client);
+            }
+        }
+
+        collectCompletions();
+        dispatch();
+        /* Completions made while dispatching can go out straight away. */
+        collectCompletions();
+
+        for (auto it = clients.begin(); it != clients.end();)
+        {
+            auto current = it++;
+            if (!sendReplies(current->second))
+            {
+                dropClient(current->first);
+            }
+        }
+    }
+
+    return {};
+}
+
+void IpmiProxyServer::acceptClients()
+{
+    while (true)
+    {
+        int fd = ::accept4(listenFd, nullptr, nullptr,
+                           SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (fd < 0)
+        {
+            return;
+        }
+
+        clients[nextClient++].fd = fd;
+    }
+}
+
+bool IpmiProxyServer::hasRoom(const Client& client) const
+{
+    /* A client that stops taking replies is stopped from sending more, so
+     * neither queue grows without bound.
+     */
+    return client.requests.size() < options.clientQueue &&
+           client.replies.size() < options.clientQueue;
+}
+
+bool IpmiProxyServer::readRequests(Client& client)
+{
+    using proxy::RequestFrame;
+
+    while (hasRoom(client))
+    {
+        /* One byte spare to tell an oversized frame from a full one. */
+        std::vector<std::uint8_t> frame(proxy::maxFrame + 1);
+        iovec io{frame.data(), frame.size()};
+        alignas(cmsghdr) char control[CMSG_SPACE(3 * sizeof(int))];
+        msghdr message{};
+        message.msg_iov = &io;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t rc = ::recvmsg(client.fd, &message,
+                               MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        if (rc < 0)
+        {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+
+        std::vector<int> fds = passedFds(message);
+        if (rc >= static_cast<ssize_t>(RequestFrame::size) &&
+            RequestFrame::netfn::load(frame.data()) == proxy::attachNetFn)
+        {
+            if ((message.msg_flags & MSG_CTRUNC) ||
+                !attachChannel(client, RequestFrame::id::load(frame.data()),
+                               fds))
+            {
+                return false;
+            }
+            continue;
+        }
+        for (int fd : fds)
+        {
+            ::close(fd);
+        }
+
+        if (rc < static_cast<ssize_t>(RequestFrame::size))
+        {
+            /* Hung up, or not speaking the protocol. */
+            return false;
+        }
+
+        frame.resize(static_cast<std::size_t>(rc));
+        if (frame.size() > proxy::maxFrame)
+        {
+            auto id = RequestFrame::id::load(frame.data());
+            client.replies.push_back(replyFrame(
+                id, std::unexpected(IpmiError{0, "Request too large."})));
+            continue;
+        }
+
+        client.requests.push_back(std::move(frame));
+    }
+
+    return true;
+}
+
+bool IpmiProxyServer::readChannel(Client& client)
+{
+    using proxy::RequestFrame;
+
+    internal::ShmChannel& channel = *client.channel;
+    while (hasRoom(client))
+    {
+        std::span<const std::uint8_t> slot = channel.requests.front();
+        if (slot.empty())
+        {
+            break;
+        }
+
+        /* Copied out before it is checked, since the client may still be
+         * writing to it.
+         */
+        std::vector<std::uint8_t> frame(slot.begin(), slot.end());
+        if (channel.requests.pop())
+        {
+            internal::ShmChannel::ring(channel.clientBell);
+        }
+
+        if (frame.size() < RequestFrame::size)
+        {
+            return false;
+        }
+        if (frame.size() > proxy::maxFrame)
+        {
+            auto id = RequestFrame::id::load(frame.data());
+            client.replies.push_back(replyFrame(
+                id, std::unexpected(IpmiError{0, "Request too large."})));
+            continue;
+        }
+
+        client.requests.push_back(std::move(frame));
+    }
+
+    return true;
+}
+
+bool IpmiProxyServer::attachChannel(Client& client, std::uint32_t id,
+                                    std::span<const int> fds)
+{
+    IpmiResult<std::span<const std::uint8_t>> outcome =
+        std::span<const std::uint8_t>();
+    if (fds.size() == 3 && !client.channel)
+    {
+        client.channel = internal::ShmChannel::attach(fds[0], fds[1], fds[2]);
+    }
+    else
+    {
+        for (int fd : fds)
+        {
+            ::close(fd);
+        }
+    }
+    if (!client.channel)
+    {
+        outcome = std::unexpected(
+            IpmiError{0, "Unable to attach shared-memory channel."});
+    }
+
+    /* Answered on the socket, whether or not the channel is in use. */
+    std::vector<std::uint8_t> frame = replyFrame(id, outcome);
+    return ::send(client.fd, frame.data(), frame.size(),
+                  MSG_DONTWAIT | MSG_NOSIGNAL) ==
+           static_cast<ssize_t>(frame.size());
+}
+
+bool IpmiProxyServer::sendReplies(Client& client)
+{
+    if (client.channel)
+    {
+        internal::ShmChannel& channel = *client.channel;
+        bool wake = false;
+        while (!client.replies.empty())
+        {
+            /* When the ring is full, the client rings once it makes room. */
+            std::span<std::uint8_t> slot = channel.replies.reserve();
+            if (slot.empty())
+            {
+                break;
+            }
+
+            const std::vector<std::uint8_t>& frame = client.replies.front();
+            std::copy(frame.begin(), frame.end(), slot.begin());
+            wake |= channel.replies.publish(frame.size());
+            client.replies.pop_front();
+        }
+
+        /* One doorbell for the whole batch. */
+        if (wake)
+        {
+            internal::ShmChannel::ring(channel.clientBell);
+        }
+        return true;
+    }
+
+    while (!client.replies.empty())
+    {
+        const std::vector<std::uint8_t>& frame = client.replies.front();
+        ssize_t rc = ::send(client.fd, frame.data(), frame.size(),
+                            MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (rc < 0)
+        {
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        }
+
+        client.replies.pop_front();
+    }
+
+    return true;
+}
+
+void IpmiProxyServer::dispatch()
+{
+    using proxy::RequestFrame;
+
+    while (inFlight < options.window)
+    {
+        /* The first client after the last one served that has a request
+         * waiting, wrapping around.
+         */
+        auto hasRequest = [](const auto& entry) {
+            return !entry.second.requests.empty();
+        };
+        auto next = std::find_if(clients.upper_bound(lastServed),
+                                 clients.end(), hasRequest);
+        if (next == clients.end())
+        {
+            next = std::find_if(clients.begin(), clients.end(), hasRequest);
+        }
+        if (next == clients.end())
+        {
+            return;
+        }
+
+        std::uint64_t clientId = next->first;
+        std::vector<std::uint8_t> frame =
+            std::move(next->second.requests.front());
+        next->second.requests.pop_front();
+        lastServed = clientId;
+        inFlight++;
+
+        auto [id, netfn, cmd] =
+            RequestFrame::decode(RequestFrame::ConstBuffer(frame.data(),
+                                                           RequestFrame::size));
+        std::span<const std::uint8_t> data =
+            std::span(frame).subspan(RequestFrame::size);
+        backend->submit(
+            netfn, cmd, data,
+            [this, clientId,
+             id](IpmiResult<std::span<const std::uint8_t>> outcome) {
+                complete(clientId, id, outcome);
+            });
+    }
+}
+
+void IpmiProxyServer::complete(
+    std::uint64_t client, std::uint32_t id,
+    const IpmiResult<std::span<const std::uint8_t>>& outcome)
+{
+    {
+        std::lock_guard lock(completionMutex);
+        completed.push_back(Completion{client, replyFrame(id, outcome)});
+    }
+
+    std::uint64_t one = 1;
+    [[maybe_unused]] auto written = ::write(wakeFd, &one, sizeof(one));
+}
+
+void IpmiProxyServer::collectCompletions()
+{
+    std::vector<Completion> ready;
+    {
+        std::lock_guard lock(completionMutex);
+        ready.swap(completed);
+    }
+
+    for (Completion& completion : ready)
+    {
+        inFlight--;
+        /* Replies for clients that have gone are dropped. */
+        auto found = clients.find(completion.client);
+        if (found != clients.end())
+        {
+            found->second.replies.push_back(std::move(completion.frame));
+        }
+    }
+}
+
+void IpmiProxyServer::dropClient(std::uint64_t id)
+{
+    auto found = clients.find(id);
+    if (found == clients.end())
+    {
+        return;
+    }
+
+    ::close(found->second.fd);
+    clients.erase(found);
+}
+
+} // namespace ipmiblob
@@ -0,0 +1,249 @@
+#pragma once
+
+#include "blob_layout.hpp"
+#include "internal/shm_ring.hpp"
+#include "ipmi_handler.hpp"
+#include "ipmi_interface.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace ipmiblob
+{
+namespace proxy
+{
+
+/* Where the proxy daemon listens unless told otherwise. */
+constexpr const char* defaultSocketPath = "/run/ipmiblob-proxy.sock";
+
+/* Frames travel over a SOCK_SEQPACKET socket, one frame per message, so
+ * the socket keeps their boundaries.
+ */
+
+/* Request id, netfn and command, followed by the request data. */
+struct RequestFrame :
+    layout::Layout<layout::Field<0, std::uint32_t>,
+                   layout::Field<4, std::uint8_t>,
+                   layout::Field<5, std::uint8_t>>
+{
+    using id = layout::Field<0, std::uint32_t>;
+    using netfn = layout::Field<4, std::uint8_t>;
+    using cmd = layout::Field<5, std::uint8_t>;
+};
+
+/* Request id, status and completion code, followed by the reply data when
+ * the status is ok.
+ */
+struct ReplyFrame :
+    layout::Layout<layout::Field<0, std::uint32_t>,
+                   layout::Field<4, std::uint8_t>,
+                   layout::Field<5, std::uint8_t>>
+{
+    using id = layout::Field<0, std::uint32_t>;
+    using status = layout::Field<4, std::uint8_t>;
+    using code = layout::Field<5, std::uint8_t>;
+};
+
+enum class Status : std::uint8_t
+{
+    ok = 0,
+    /* Failed with the completion code, or on the daemon's side if it is 0. */
+    failed = 1,
+};
+
+/* The largest frame either way. */
+constexpr std::size_t maxFrame = RequestFrame::size + IpmiReply::capacity;
+
+static_assert(internal::ShmRing::slotSize >= maxFrame);
+
+/* The netfn of a request that hands the proxy a shared-memory channel,
+ * which no IPMI request uses since netfns are six bits.  It carries no
+ * data, is sent over the socket with the memfd, the server's doorbell and
+ * the client's doorbell attached, in that order, and is answered over the
+ * socket with an empty reply.
+ */
+constexpr std::uint8_t attachNetFn = 0xff;
+
+/**
+ * Connect to the proxy listening at path.
+ *
+ * @return the connected socket.
+ */
+IpmiResult<int> connectTo(const std::string& path);
+
+/**
+ * @return the outcome a reply frame carries, as a view into it.
+ */
+IpmiResult<std::span<const std::uint8_t>> decodeReply(
+    std::span<const std::uint8_t> frame);
+
+} // namespace proxy
+
+/**
+ * Serves IPMI requests from many local processes over one transport.
+ * Clients connect to a Unix socket and send framed requests, which may be
+ * pipelined; the server queues them per client and hands them to the
+ * transport in round-robin order across clients, keeping up to a window of
+ * them in flight, so that one busy client cannot starve the others.
+ * Replies go back to the client that sent the request, tagged with its id.
+ *
+ * Clients may instead exchange frames through a shared-memory channel they
+ * hand over on the socket, which saves a send and a receive per request;
+ * the socket then only tells the server when the client goes away.
+ *
+ * An IpmiHandler transport is driven from the server's own loop through
+ * its descriptor; any other must complete submit() by itself, from any
+ * thread.
+ */
+class IpmiProxyServer
+{
+  public:
+    struct Options
+    {
+        /* Requests handed to the transport and not yet completed. */
+        std::size_t window = IpmiHandler::defaultWindow;
+        /* Requests read from one client and not yet handed on, or replies
+         * it has not yet taken; the client is not read from while it has
+         * this many of either.
+         */
+        std::size_t clientQueue = 32;
+    };
+
+    /**
+     * @param[in] backend - the transport to the BMC.
+     */
+    explicit IpmiProxyServer(std::unique_ptr<IpmiInterface> backend);
+
+    /**
+     * @param[in] backend - the transport to the BMC.
+     * @param[in] options - the limits.
+     */
+    IpmiProxyServer(std::unique_ptr<IpmiInterface> backend,
+                    const Options& options);
+
+    ~IpmiProxyServer();
+    IpmiProxyServer(const IpmiProxyServer&) = delete;
+    IpmiProxyServer& operator=(const IpmiProxyServer&) = delete;
+    IpmiProxyServer(IpmiProxyServer&&) = delete;
+    IpmiProxyServer& operator=(IpmiProxyServer&&) = delete;
+
+    /**
+     * Create the socket at path, replacing any stale one, and listen on it.
+     * The socket is removed again when the server is destroyed.
+     */
+    IpmiResult<void> listen(const std::string& path);
+
+    /**
+     * Serve clients until stop() is called.
+     *
+     * @return a failure to poll, or to open the transport's device.
+     */
+    IpmiResult<void> run();
+
+    /**
+     * Make run() return.  Safe to call from any thread, or from a signal
+     * handler.
+     */
+    void stop();
+
+  private:
+    /* A connected client and the frames queued each way. */
+    struct Client
+    {
+        int fd = -1;
+        /* Set once the client has handed over a shared-memory channel. */
+        std::unique_ptr<internal::ShmChannel> channel;
+        std::deque<std::vector<std::uint8_t>> requests;
+        std::deque<std::vector<std::uint8_t>> replies;
+    };
+
+    /* A reply frame ready for a client, from whichever thread completed
+     * the request.
+     */
+    struct Completion
+    {
+        std::uint64_t client;
+        std::vector<std::uint8_t> frame;
+    };
+
+    void acceptClients();
+
+    /* Whether to read more requests from the client. */
+    bool hasRoom(const Client& client) const;
+
+    /**
+     * Read the frames the client has sent, while it has room.
+     *
+     * @return false if the client hung up or broke the protocol.
+     */
+    bool readRequests(Client& client);
+
+    /**
+     * Read the frames in the client's shared-memory channel, while it has
+     * room.
+     *
+     * @return false if the client broke the protocol.
+     */
+    bool readChannel(Client& client);
+
+    /**
+     * Map the channel handed over with an attach request, and answer it.
+     *
+     * @return false if the answer could not be sent.
+     */
+    bool attachChannel(Client& client, std::uint32_t id,
+                       std::span<const int> fds);
+
+    /**
+     * Send the client as many of its queued replies as it will take, over
+     * its channel if it has one.
+     *
+     * @return false if the client hung up.
+     */
+    bool sendReplies(Client& client);
+
+    /* Hand queued requests to the transport, one client at a time. */
+    void dispatch();
+
+    /* Queue a request's outcome for its client and wake the loop. */
+    void complete(std::uint64_t client, std::uint32_t id,
+                  const IpmiResult<std::span<const std::uint8_t>>& outcome);
+
+    /* Move completed replies to their clients' queues. */
+    void collectCompletions();
+
+    void dropClient(std::uint64_t id);
+
+    const Options options;
+    /* Set when the backend is an IpmiHandler, to be driven from run(). */
+    IpmiHandler* handler = nullptr;
+
+    int listenFd = -1;
+    std::string socketPath;
+    /* Written by stop() and by completions to wake the loop. */
+    int wakeFd = -1;
+    std::atomic_bool stopping = false;
+
+    /* Ordered by id, so that the next client after the last one served is
+     * found in one lookup.
+     */
+    std::map<std::uint64_t, Client> clients;
+    std::uint64_t nextClient = 1;
+    std::uint64_t lastServed = 0;
+    std::size_t inFlight = 0;
+
+    std::mutex completionMutex;
+    std::vector<Completion> completed;
+
+    std::unique_ptr<IpmiInterface> backend;
+};
+
+} // namespace ipmiblob
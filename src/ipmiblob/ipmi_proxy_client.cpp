@@ -0,0 +1,316 @@
+#include "ipmi_proxy_client.hpp"
+
+#include "ipmi_errors.hpp"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ipmiblob
+{
+
+std::unique_ptr<IpmiInterface> IpmiProxyClient::CreateIpmiProxyClient(
+    const std::string& path)
+{
+    return std::make_unique<IpmiProxyClient>(path);
+}
+
+IpmiProxyClient::IpmiProxyClient(const std::string& path) : path(path) {}
+
+IpmiProxyClient::~IpmiProxyClient()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+    }
+}
+
+std::vector<std::uint8_t> IpmiProxyClient::sendPacket(
+    std::uint8_t netfn, std::uint8_t cmd, std::vector<std::uint8_t>& data)
+{
+    IpmiReply reply;
+    std::span<const std::uint8_t> returned =
+        sendPacketInto(netfn, cmd, data, reply);
+    return std::vector<std::uint8_t>(returned.begin(), returned.end());
+}
+
+std::span<const std::uint8_t> IpmiProxyClient::sendPacketInto(
+    std::uint8_t netfn, std::uint8_t cmd, std::span<const std::uint8_t> data,
+    IpmiReply& reply)
+{
+    auto returned = trySendPacketInto(netfn, cmd, data, reply);
+    if (!returned)
+    {
+        throw IpmiException(returned.error());
+    }
+
+    return *returned;
+}
+
+IpmiResult<std::span<const std::uint8_t>> IpmiProxyClient::trySendPacketInto(
+    std::uint8_t netfn, std::uint8_t cmd, std::span<const std::uint8_t> data,
+    IpmiReply& reply)
+{
+    std::vector<Ready> ready;
+    IpmiResult<std::span<const std::uint8_t>> result;
+    {
+        std::lock_guard lock(ioMutex);
+        auto id = sendRequest(netfn, cmd, data, ready);
+        if (!id)
+        {
+            result = std::unexpected(id.error());
+        }
+
+        while (id)
+        {
+            auto size = receiveFrame(true, ready);
+            if (!size)
+            {
+                result = std::unexpected(size.error());
+                break;
+            }
+
+            if (proxy::ReplyFrame::id::load(frame.data()) != *id)
+            {
+                collect(*size, ready);
+                continue;
+            }
+
+            auto outcome = proxy::decodeReply(std::span(frame).first(*size));
+            if (outcome && outcome->size() > reply.raw().size())
+            {
+                result = std::unexpected(
+                    IpmiError{0, "Reply too large for buffer."});
+            }
+            else if (outcome)
+            {
+                std::copy(outcome->begin(), outcome->end(),
+                          reply.raw().begin());
+                reply.setData(0, outcome->size());
+                result = reply.data();
+            }
+            else
+            {
+                result = std::unexpected(outcome.error());
+            }
+            break;
+        }
+    }
+
+    /* Callbacks may make calls of their own, so not under the lock. */
+    runReady(ready);
+    return result;
+}
+
+void IpmiProxyClient::submit(std::uint8_t netfn, std::uint8_t cmd,
+                             std::span<const std::uint8_t> data,
+                             IpmiCallback callback)
+{
+    std::vector<Ready> ready;
+    IpmiResult<std::uint32_t> id;
+    {
+        std::lock_guard lock(ioMutex);
+        id = sendRequest(netfn, cmd, data, ready);
+        if (id)
+        {
+            callbacks.emplace(*id, std::move(callback));
+        }
+    }
+
+    runReady(ready);
+    if (!id)
+    {
+        callback(std::unexpected(id.error()));
+    }
+}
+
+IpmiResult<int> IpmiProxyClient::tryGetFd()
+{
+    std::lock_guard lock(ioMutex);
+    if (auto connected = tryConnect(); !connected)
+    {
+        return std::unexpected(connected.error());
+    }
+
+    return fd;
+}
+
+IpmiResult<void> IpmiProxyClient::processReadable()
+{
+    std::vector<Ready> ready;
+    IpmiResult<void> result;
+    {
+        std::lock_guard lock(ioMutex);
+        while (true)
+        {
+            auto size = receiveFrame(false, ready);
+            if (!size)
+            {
+                result = std::unexpected(size.error());
+                break;
+            }
+            if (!*size)
+            {
+                break;
+            }
+            collect(*size, ready);
+        }
+    }
+
+    runReady(ready);
+    return result;
+}
+
+IpmiResult<void> IpmiProxyClient::tryConnect()
+{
+    if (fd >= 0)
+    {
+        return {};
+    }
+
+    auto connected = proxy::connectTo(path);
+    if (!connected)
+    {
+        return std::unexpected(connected.error());
+    }
+
+    fd = *connected;
+    return {};
+}
+
+IpmiResult<std::uint32_t> IpmiProxyClient::sendRequest(
+    std::uint8_t netfn, std::uint8_t cmd, std::span<const std::uint8_t> data,
+    std::vector<Ready>& ready)
+{
+    using proxy::RequestFrame;
+
+    if (auto connected = tryConnect(); !connected)
+    {
+        return std::unexpected(connected.error());
+    }
+    if (data.size() > frame.size() - RequestFrame::size)
+    {
+        return std::unexpected(IpmiError{0, "Request too large."});
+    }
+
+    std::uint32_t id = nextId++;
+    RequestFrame::encode(RequestFrame::Buffer(frame.data(), RequestFrame::size),
+                         id, netfn, cmd);
+    std::copy(data.begin(), data.end(), frame.begin() + RequestFrame::size);
+
+    ssize_t rc;
+    do
+    {
+        rc = ::send(fd, frame.data(), RequestFrame::size + data.size(),
+                    MSG_NOSIGNAL);
+    } while (rc < 0 && errno == EINTR);
+
+    if (rc < 0)
+    {
+        IpmiError error{0, "Unable to send to the IPMI proxy."};
+        disconnect(error, ready);
+        return std::unexpected(error);
+    }
+
+    return id;
+}
+
+IpmiResult<std::size_t> IpmiProxyClient::receiveFrame(
+    bool wait, std::vector<Ready>& ready)
+{
+    if (auto connected = tryConnect(); !connected)
+    {
+        return std::unexpected(connected.error());
+    }
+
+    ssize_t rc;
+    do
+    {
+        rc = ::recv(fd, frame.data(), frame.size(), wait ? 0 : MSG_DONTWAIT);
+    } while (rc < 0 && errno == EINTR);
+
+    if (rc < 0)
+    {
+        if (!wait && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            return 0;
+        }
+        IpmiError error{0, "Unable to read from the IPMI proxy."};
+        disconnect(error, ready);
+        return std::unexpected(error);
+    }
+    if (rc < static_cast<ssize_t>(proxy::ReplyFrame::size))
+    {
+        IpmiError error{0, "IPMI proxy closed the connection."};
+        disconnect(error, ready);
+        return std::unexpected(error);
+    }
+
+    return static_cast<std::size_t>(rc);
+}
+
+void IpmiProxyClient::disconnect(const IpmiError& error,
+                                 std::vector<Ready>& ready)
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+
+    for (auto& [id, callback] : callbacks)
+    {
+        ready.push_back(Ready{std::move(callback), std::unexpected(error)});
+    }
+    callbacks.clear();
+}
+
+void IpmiProxyClient::collect(std::size_t size, std::vector<Ready>& ready)
+{
+    auto found = callbacks.find(proxy::ReplyFrame::id::load(frame.data()));
+    if (found == callbacks.end())
+    {
+        return;
+    }
+
+    auto outcome = proxy::decodeReply(std::span(frame).first(size));
+    IpmiResult<std::vector<std::uint8_t>> owned;
+    if (outcome)
+    {
+        owned = std::vector<std::uint8_t>(outcome->begin(), outcome->end());
+    }
+    else
+    {
+        owned = std::unexpected(outcome.error());
+    }
+
+    ready.push_back(Ready{std::move(found->second), std::move(owned)});
+    callbacks.erase(found);
+}
+
+void IpmiProxyClient::runReady(std::vector<Ready>& ready)
+{
+    for (Ready& entry : ready)
+    {
+        if (entry.outcome)
+        {
+            entry.callback(std::span<const std::uint8_t>(*entry.outcome));
+        }
+        else
+        {
+            entry.callback(std::unexpected(entry.outcome.error()));
+        }
+    }
+}
+
+} // namespace ipmiblob
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "ipmi_interface.hpp"
+#include "ipmi_proxy.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ipmiblob
+{
+
+/**
+ * Sends requests through an IpmiProxyServer instead of opening the IPMI
+ * device, so that many processes share the BMC fairly.  A drop-in
+ * replacement for IpmiHandler:
+ *
+ *     BlobHandler blob(IpmiProxyClient::CreateIpmiProxyClient());
+ *
+ * Connects on first use.  Calls from several threads are serialised; each
+ * synchronous call delivers the replies to earlier submit() requests that
+ * arrive before its own.  If the connection fails, every request waiting on
+ * it fails too, and the next call connects again.
+ */
+class IpmiProxyClient : public IpmiInterface
+{
+  public:
+    static std::unique_ptr<IpmiInterface> CreateIpmiProxyClient(
+        const std::string& path = proxy::defaultSocketPath);
+
+    /**
+     * @param[in] path - the socket the server listens on.
+     */
+    explicit IpmiProxyClient(const std::string& path);
+
+    ~IpmiProxyClient();
+    IpmiProxyClient(const IpmiProxyClient&) = delete;
+    IpmiProxyClient& operator=(const IpmiProxyClient&) = delete;
+    IpmiProxyClient(IpmiProxyClient&&) = delete;
+    IpmiProxyClient& operator=(IpmiProxyClient&&) = delete;
+
+    /**
+     * @throws IpmiException on failure.
+     */
+    std::vector<std::uint8_t> sendPacket(
+        std::uint8_t netfn, std::uint8_t cmd,
+        std::vector<std::uint8_t>& data) override;
+
+    /**
+     * @throws IpmiException on failure.
+     */
+    std::span<const std::uint8_t> sendPacketInto(
+        std::uint8_t netfn, std::uint8_t cmd,
+        std::span<const std::uint8_t> data, IpmiReply& reply) override;
+
+    /**
+     * The primary implementation, which the throwing calls above wrap.  A
+     * failure on the server's side comes back without its text.
+     */
+    IpmiResult<std::span<const std::uint8_t>> trySendPacketInto(
+        std::uint8_t netfn, std::uint8_t cmd,
+        std::span<const std::uint8_t> data, IpmiReply& reply) override;
+
+    /**
+     * Send the request and return at once; callback runs when its reply is
+     * read, by processReadable() or a later synchronous call.
+     */
+    void submit(std::uint8_t netfn, std::uint8_t cmd,
+                std::span<const std::uint8_t> data,
+                IpmiCallback callback) override;
+
+    /**
+     * Connect if needed and return the socket, for an event loop to watch
+     * for POLLIN.  The descriptor stays owned by this client, and changes
+     * once a failed connection has been replaced; ask again after a failure.
+     */
+    IpmiResult<int> tryGetFd();
+
+    /**
+     * Read every reply already queued, without blocking, and run the
+     * callbacks of their submit() requests.
+     */
+    IpmiResult<void> processReadable();
+
+  private:
+    /* A submit() reply read while someone else held the socket. */
+    struct Ready
+    {
+        IpmiCallback callback;
+        IpmiResult<std::vector<std::uint8_t>> outcome;
+    };
+
+    /* Called with ioMutex held.  Those that fail the connection fail the
+     * submit() requests waiting on it into ready.
+     */
+    IpmiResult<void> tryConnect();
+    IpmiResult<std::uint32_t> sendRequest(std::uint8_t netfn,
+                                          std::uint8_t cmd,
+                                          std::span<const std::uint8_t> data,
+                                          std::vector<Ready>& ready);
+    /**
+     * Read one reply frame into frame, waiting for it if asked to.
+     *
+     * @return the frame's size, or 0 if none was queued.
+     */
+    IpmiResult<std::size_t> receiveFrame(bool wait, std::vector<Ready>& ready);
+
+    /* Close the socket, so the next call connects again, and fail every
+     * submit() request waiting on it with error.
+     */
+    void disconnect(const IpmiError& error, std::vector<Ready>& ready);
+
+    /* Hand a reply for a submit() request to its callback, later. */
+    void collect(std::size_t size, std::vector<Ready>& ready);
+
+    static void runReady(std::vector<Ready>& ready);
+
+    const std::string path;
+    /* Protects everything below. */
+    std::mutex ioMutex;
+    int fd = -1;
+    std::uint32_t nextId = 0;
+    std::unordered_map<std::uint32_t, IpmiCallback> callbacks;
+    std::array<std::uint8_t, proxy::maxFrame> frame;
+};
+
+} // namespace ipmiblob
@@ -0,0 +1,444 @@
+#include "ipmi_ring_client.hpp"
+
+#include "ipmi_errors.hpp"
+
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ipmiblob
+{
+
+using internal::ShmChannel;
+
+namespace
+{
+
+constexpr const char* proxyClosed = "IPMI proxy closed the connection.";
+
+} // namespace
+
+std::unique_ptr<IpmiInterface> IpmiRingClient::CreateIpmiRingClient(
+    const std::string& path)
+{
+    return std::make_unique<IpmiRingClient>(path);
+}
+
+IpmiRingClient::IpmiRingClient(const std::string& path) : path(path) {}
+
+IpmiRingClient::~IpmiRingClient()
+{
+    channel.reset();
+    if (fd >= 0)
+    {
+        ::close(fd);
+    }
+    if (watchFd >= 0)
+    {
+        ::close(watchFd);
+    }
+}
+
+std::vector<std::uint8_t> IpmiRingClient::sendPacket(
+    std::uint8_t netfn, std::uint8_t cmd, std::vector<std::uint8_t>& data)
+{
+    IpmiReply reply;
+    std::span<const std::uint8_t> returned =
+        sendPacketInto(netfn, cmd, data, reply);
+    return std::vector<std::uint8_t>(returned.begin(), returned.end());
+}
+
+std::span<const std::uint8_t> IpmiRingClient::sendPacketInto(
+    std::uint8_t netfn, std::uint8_t cmd, std::span<const std::uint8_t> data,
+    IpmiReply& reply)
+{
+    auto returned = trySendPacketInto(netfn, cmd, data, reply);
+    if (!returned)
+    {
+        throw IpmiException(returned.error());
+    }
+
+    return *returned;
+}
+
+IpmiResult<std::span<const std::uint8_t>> IpmiRingClient::trySendPacketInto(
+    std::uint8_t netfn, std::uint8_t cmd, std::span<const std::uint8_t> data,
+    IpmiReply& reply)
+{
+    std::vector<Ready> ready;
+    IpmiResult<std::span<const std::uint8_t>> result;
+    {
+        std::lock_guard lock(ioMutex);
+        auto id = sendRequest(netfn, cmd, data, ready);
+        if (!id)
+        {
+            result = std::unexpected(id.error());
+        }
+        else
+        {
+            Awaited awaited{*id, reply, std::nullopt};
+            while (true)
+            {
+                /* Cleared before looking, so a reply published after the
+                 * look still wakes the wait.
+                 */
+                ShmChannel::drain(channel->clientBell);
+                takeReplies(&awaited, ready);
+                if (awaited.result)
+                {
+                    result = *awaited.result;
+                    break;
+                }
+
+                if (auto woken = waitForBell(ready); !woken)
+                {
+                    result = std::unexpected(woken.error());
+                    break;
+                }
+            }
+        }
+    }
+
+    /* Callbacks may make calls of their own, so not under the lock. */
+    runReady(ready);
+    return result;
+}
+
+void IpmiRingClient::submit(std::uint8_t netfn, std::uint8_t cmd,
+                            std::span<const std::uint8_t> data,
+                            IpmiCallback callback)
+{
+    std::vector<Ready> ready;
+    IpmiResult<std::uint32_t> id;
+    {
+        std::lock_guard lock(ioMutex);
+        id = sendRequest(netfn, cmd, data, ready);
+        if (id)
+        {
+            callbacks.emplace(*id, std::move(callback));
+        }
+    }
+
+    if (!id)
+    {
+        callback(std::unexpected(id.error()));
+    }
+    runReady(ready);
+}
+
+IpmiResult<int> IpmiRingClient::tryGetFd()
+{
+    std::lock_guard lock(ioMutex);
+    if (auto connected = tryConnect(); !connected)
+    {
+        return std::unexpected(connected.error());
+    }
+
+    return watchFd;
+}
+
+IpmiResult<void> IpmiRingClient::processReadable()
+{
+    std::vector<Ready> ready;
+    IpmiResult<void> result;
+    {
+        std::lock_guard lock(ioMutex);
+        if (auto connected = tryConnect(); !connected)
+        {
+            return std::unexpected(connected.error());
+        }
+
+        /* Replies the proxy left before going are still delivered. */
+        ShmChannel::drain(channel->clientBell);
+        takeReplies(nullptr, ready);
+        if (hungUp())
+        {
+            IpmiError error{0, proxyClosed};
+            disconnect(error, ready);
+            result = std::unexpected(error);
+        }
+    }
+
+    runReady(ready);
+    return result;
+}
+
+IpmiResult<void> IpmiRingClient::tryConnect()
+{
+    using proxy::RequestFrame;
+
+    if (channel)
+    {
+        return {};
+    }
+
+    if (watchFd < 0)
+    {
+        watchFd = ::epoll_create1(EPOLL_CLOEXEC);
+        if (watchFd < 0)
+        {
+            return std::unexpected(
+                IpmiError{0, "Unable to create IPMI proxy watch."});
+        }
+    }
+
+    auto connected = proxy::connectTo(path);
+    if (!connected)
+    {
+        return std::unexpected(connected.error());
+    }
+    int socketFd = *connected;
+
+    std::unique_ptr<ShmChannel> created = ShmChannel::create();
+    if (!created)
+    {
+        ::close(socketFd);
+        return std::unexpected(
+            IpmiError{0, "Unable to create shared-memory channel."});
+    }
+
+    /* Hand over the memory and both doorbells with an attach request. */
+    std::array<std::uint8_t, RequestFrame::size> frame;
+    RequestFrame::encode(frame, 0, proxy::attachNetFn, 0);
+    iovec io{frame.data(), frame.size()};
+    int fds[] = {created->memFd, created->serverBell, created->clientBell};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+    msghdr message{};
+    message.msg_iov = &io;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(fds));
+    std::memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+    std::array<std::uint8_t, proxy::maxFrame> answer;
+    ssize_t sent = ::sendmsg(socketFd, &message, MSG_NOSIGNAL);
+    ssize_t received =
+        sent < 0 ? -1 : ::recv(socketFd, answer.data(), answer.size(), 0);
+    if (received < static_cast<ssize_t>(proxy::ReplyFrame::size) ||
+        !proxy::decodeReply(std::span(answer).first(received)))
+    {
+        ::close(socketFd);
+        return std::unexpected(
+            IpmiError{0, "IPMI proxy refused the shared-memory channel."});
+    }
+
+    /* A hangup is reported whatever the events asked for. */
+    epoll_event bell{};
+    bell.events = EPOLLIN;
+    epoll_event hangup{};
+    if (::epoll_ctl(watchFd, EPOLL_CTL_ADD, created->clientBell, &bell) < 0 ||
+        ::epoll_ctl(watchFd, EPOLL_CTL_ADD, socketFd, &hangup) < 0)
+    {
+        ::epoll_ctl(watchFd, EPOLL_CTL_DEL, created->clientBell, nullptr);
+        ::close(socketFd);
+        return std::unexpected(
+            IpmiError{0, "Unable to watch the IPMI proxy."});
+    }
+
+    fd = socketFd;
+    channel = std::move(created);
+    return {};
+}
+
+IpmiResult<std::uint32_t> IpmiRingClient::sendRequest(
+    std::uint8_t netfn, std::uint8_t cmd, std::span<const std::uint8_t> data,
+    std::vector<Ready>& ready)
+{
+    using proxy::RequestFrame;
+
+    if (auto connected = tryConnect(); !connected)
+    {
+        return std::unexpected(connected.error());
+    }
+    if (data.size() > proxy::maxFrame - RequestFrame::size)
+    {
+        return std::unexpected(IpmiError{0, "Request too large."});
+    }
+
+    std::span<std::uint8_t> slot = channel->requests.reserve();
+    while (slot.empty())
+    {
+        /* The proxy rings once it takes a request from the full ring.
+         * Replies are taken meanwhile, since the bell is shared and an
+         * event loop would not be woken for them again.
+         */
+        ShmChannel::drain(channel->clientBell);
+        takeReplies(nullptr, ready);
+        slot = channel->requests.reserve();
+        if (!slot.empty())
+        {
+            break;
+        }
+
+        if (auto woken = waitForBell(ready); !woken)
+        {
+            return std::unexpected(woken.error());
+        }
+    }
+
+    /* Written in place, payload and all. */
+    std::uint32_t id = nextId++;
+    RequestFrame::encode(RequestFrame::Buffer(slot.data(), RequestFrame::size),
+                         id, netfn, cmd);
+    std::copy(data.begin(), data.end(), slot.begin() + RequestFrame::size);
+    if (channel->requests.publish(RequestFrame::size + data.size()))
+    {
+        ShmChannel::ring(channel->serverBell);
+    }
+
+    return id;
+}
+
+void IpmiRingClient::takeReplies(Awaited* awaited, std::vector<Ready>& ready)
+{
+    using proxy::ReplyFrame;
+
+    while (true)
+    {
+        std::span<const std::uint8_t> frame = channel->replies.front();
+        if (frame.empty())
+        {
+            return;
+        }
+
+        if (frame.size() >= ReplyFrame::size)
+        {
+            std::uint32_t id = ReplyFrame::id::load(frame.data());
+            auto outcome = proxy::decodeReply(frame);
+            auto callback = callbacks.find(id);
+            if (awaited && id == awaited->id)
+            {
+                /* Straight from the ring into the caller's buffer. */
+                IpmiReply& reply = awaited->reply;
+                if (outcome && outcome->size() <= reply.raw().size())
+                {
+                    std::copy(outcome->begin(), outcome->end(),
+                              reply.raw().begin());
+                    reply.setData(0, outcome->size());
+                    awaited->result = reply.data();
+                }
+                else if (outcome)
+                {
+                    awaited->result = std::unexpected(
+                        IpmiError{0, "Reply too large for buffer."});
+                }
+                else
+                {
+                    awaited->result = std::unexpected(outcome.error());
+                }
+            }
+            else if (callback != callbacks.end())
+            {
+                IpmiResult<std::vector<std::uint8_t>> owned;
+                if (outcome)
+                {
+                    owned = std::vector<std::uint8_t>(outcome->begin(),
+                                                      outcome->end());
+                }
+                else
+                {
+                    owned = std::unexpected(outcome.error());
+                }
+                ready.push_back(
+                    Ready{std::move(callback->second), std::move(owned)});
+                callbacks.erase(callback);
+            }
+        }
+
+        if (channel->replies.pop())
+        {
+            ShmChannel::ring(channel->serverBell);
+        }
+    }
+}
+
+IpmiResult<void> IpmiRingClient::waitForBell(std::vector<Ready>& ready)
+{
+    /* Nothing else comes over the socket, but a hangup does. */
+    std::array<pollfd, 2> fds = {pollfd{channel->clientBell, POLLIN, 0},
+                                 pollfd{fd, 0, 0}};
+    int rc;
+    do
+    {
+        rc = ::poll(fds.data(), fds.size(), -1);
+    } while (rc < 0 && errno == EINTR);
+
+    if (rc < 0)
+    {
+        return std::unexpected(IpmiError{0, "Polling Error occurred."});
+    }
+    if (fds[1].revents & (POLLHUP | POLLERR))
+    {
+        IpmiError error{0, proxyClosed};
+        disconnect(error, ready);
+        return std::unexpected(error);
+    }
+
+    return {};
+}
+
+bool IpmiRingClient::hungUp() const
+{
+    pollfd socket{fd, 0, 0};
+    return ::poll(&socket, 1, 0) > 0 &&
+           (socket.revents & (POLLHUP | POLLERR));
+}
+
+void IpmiRingClient::disconnect(const IpmiError& error,
+                                std::vector<Ready>& ready)
+{
+    /* The proxy may hold the same doorbell, which would keep it watched. */
+    if (channel)
+    {
+        ::epoll_ctl(watchFd, EPOLL_CTL_DEL, channel->clientBell, nullptr);
+        channel.reset();
+    }
+    if (fd >= 0)
+    {
+        ::epoll_ctl(watchFd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        fd = -1;
+    }
+
+    for (auto& [id, callback] : callbacks)
+    {
+        ready.push_back(Ready{std::move(callback), std::unexpected(error)});
+    }
+    callbacks.clear();
+}
+
+void IpmiRingClient::runReady(std::vector<Ready>& ready)
+{
+    for (Ready& entry : ready)
+    {
+        if (entry.outcome)
+        {
+            entry.callback(std::span<const std::uint8_t>(*entry.outcome));
+        }
+        else
+        {
+            entry.callback(std::unexpected(entry.outcome.error()));
+        }
+    }
+}
+
+} // namespace ipmiblob
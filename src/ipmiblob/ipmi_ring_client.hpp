@@ -0,0 +1,154 @@
+#pragma once
+
+#include "internal/shm_ring.hpp"
+#include "ipmi_interface.hpp"
+#include "ipmi_proxy.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ipmiblob
+{
+
+/**
+ * Like IpmiProxyClient, but exchanges frames with the proxy through a
+ * shared-memory channel instead of the socket: requests are written
+ * straight into the request ring, with their payload, and replies read
+ * straight out of the reply ring into the caller's buffer.  An eventfd
+ * doorbell is only rung when the other side may be asleep, so a busy
+ * pipeline costs no system calls at all.  The socket stays open so that
+ * either side notices when the other goes away.
+ *
+ *     BlobHandler blob(IpmiRingClient::CreateIpmiRingClient());
+ *
+ * Connects on first use.  Calls from several threads are serialised.  If
+ * the proxy goes away, every request waiting on it fails, and the next call
+ * connects again with a new channel.
+ */
+class IpmiRingClient : public IpmiInterface
+{
+  public:
+    static std::unique_ptr<IpmiInterface> CreateIpmiRingClient(
+        const std::string& path = proxy::defaultSocketPath);
+
+    /**
+     * @param[in] path - the socket the server listens on.
+     */
+    explicit IpmiRingClient(const std::string& path);
+
+    ~IpmiRingClient();
+    IpmiRingClient(const IpmiRingClient&) = delete;
+    IpmiRingClient& operator=(const IpmiRingClient&) = delete;
+    IpmiRingClient(IpmiRingClient&&) = delete;
+    IpmiRingClient& operator=(IpmiRingClient&&) = delete;
+
+    /**
+     * @throws IpmiException on failure.
+     */
+    std::vector<std::uint8_t> sendPacket(
+        std::uint8_t netfn, std::uint8_t cmd,
+        std::vector<std::uint8_t>& data) override;
+
+    /**
+     * @throws IpmiException on failure.
+     */
+    std::span<const std::uint8_t> sendPacketInto(
+        std::uint8_t netfn, std::uint8_t cmd,
+        std::span<const std::uint8_t> data, IpmiReply& reply) override;
+
+    /**
+     * The primary implementation, which the throwing calls above wrap.
+     */
+    IpmiResult<std::span<const std::uint8_t>> trySendPacketInto(
+        std::uint8_t netfn, std::uint8_t cmd,
+        std::span<const std::uint8_t> data, IpmiReply& reply) override;
+
+    /**
+     * Queue the request and return at once; callback runs when its reply
+     * is read, by processReadable() or a later synchronous call.  Waits
+     * only if the request ring is full.
+     */
+    void submit(std::uint8_t netfn, std::uint8_t cmd,
+                std::span<const std::uint8_t> data,
+                IpmiCallback callback) override;
+
+    /**
+     * Connect if needed and return a descriptor, for an event loop to watch
+     * for POLLIN, that is readable when replies arrive or the proxy goes
+     * away.  It stays the same across reconnections.
+     */
+    IpmiResult<int> tryGetFd();
+
+    /**
+     * Read every reply in the ring and run the callbacks of their submit()
+     * requests; if the proxy has gone, fail the rest.
+     */
+    IpmiResult<void> processReadable();
+
+  private:
+    /* A submit() reply read while someone else held the channel. */
+    struct Ready
+    {
+        IpmiCallback callback;
+        IpmiResult<std::vector<std::uint8_t>> outcome;
+    };
+
+    /* The reply a synchronous call is waiting for. */
+    struct Awaited
+    {
+        std::uint32_t id;
+        IpmiReply& reply;
+        std::optional<IpmiResult<std::span<const std::uint8_t>>> result;
+    };
+
+    /* Called with ioMutex held, as are the rest. */
+    IpmiResult<void> tryConnect();
+
+    /**
+     * Write the request into the ring, first waiting for room if it is
+     * full, which delivers replies meanwhile.
+     */
+    IpmiResult<std::uint32_t> sendRequest(std::uint8_t netfn,
+                                          std::uint8_t cmd,
+                                          std::span<const std::uint8_t> data,
+                                          std::vector<Ready>& ready);
+
+    /**
+     * Take every reply in the ring, filling in the awaited one if it is
+     * there.  All are taken, since the doorbell has been cleared and would
+     * not ring for those left behind.
+     */
+    void takeReplies(Awaited* awaited, std::vector<Ready>& ready);
+
+    /* Sleep until the proxy rings, or disconnect and fail if it has gone.
+     */
+    IpmiResult<void> waitForBell(std::vector<Ready>& ready);
+
+    /* Whether the proxy has closed the socket. */
+    bool hungUp() const;
+
+    /* Drop the channel and the socket, so the next call connects again, and
+     * fail every submit() request waiting on them with error.
+     */
+    void disconnect(const IpmiError& error, std::vector<Ready>& ready);
+
+    static void runReady(std::vector<Ready>& ready);
+
+    const std::string path;
+    /* Protects everything below. */
+    std::mutex ioMutex;
+    int fd = -1;
+    /* An epoll set of the socket and the reply doorbell, for tryGetFd(). */
+    int watchFd = -1;
+    std::unique_ptr<internal::ShmChannel> channel;
+    std::uint32_t nextId = 0;
+    std::unordered_map<std::uint32_t, IpmiCallback> callbacks;
+};
+
+} // namespace ipmiblob
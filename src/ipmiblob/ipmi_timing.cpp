@@ -0,0 +1,111 @@
+#include "ipmi_timing.hpp"
+
+#include "blob_layout.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <span>
+
+namespace ipmiblob
+{
+
+int IpmiTiming::pollTimeoutMs() const
+{
+    /* Time for the driver to hand back the failure of the last attempt. */
+    constexpr std::int64_t driverSlackMs = 250;
+
+    std::int64_t attempts = std::max(retries, 0) + 1;
+    std::int64_t total = attempts * retryTimeMs + driverSlackMs;
+    return static_cast<int>(
+        std::min<std::int64_t>(total, std::numeric_limits<int>::max()));
+}
+
+AdaptiveTiming::AdaptiveTiming() : AdaptiveTiming(Options{}) {}
+
+AdaptiveTiming::AdaptiveTiming(const Options& options) : options(options) {}
+
+AdaptiveTiming::Kind AdaptiveTiming::kindOf(
+    std::uint8_t netfn, std::uint8_t cmd, std::span<const std::uint8_t> data)
+{
+    using layout::RequestHeader;
+
+    Kind kind = (Kind{netfn} << 16) | (Kind{cmd} << 8);
+    if (netfn == ipmiOEMNetFn && cmd == ipmiOEMBlobCmd &&
+        data.size() > RequestHeader::command::offset)
+    {
+        kind |= RequestHeader::command::load(data.data());
+    }
+
+    return kind;
+}
+
+IpmiTiming AdaptiveTiming::timingFor(Kind kind)
+{
+    std::lock_guard lock(historyMutex);
+    auto found = histories.find(kind);
+    if (found == histories.end() || found->second.count < options.minSamples)
+    {
+        return longest();
+    }
+
+    return found->second.timing;
+}
+
+void AdaptiveTiming::record(Kind kind, std::chrono::microseconds roundTrip)
+{
+    std::lock_guard lock(historyMutex);
+    add(histories[kind], roundTrip);
+}
+
+void AdaptiveTiming::recordTimeout(Kind kind,
+                                   std::chrono::microseconds waited)
+{
+    std::lock_guard lock(historyMutex);
+    History& history = histories[kind];
+    add(history, waited);
+    if (history.count < options.minSamples)
+    {
+        return;
+    }
+
+    history.timing.retryTimeMs = std::min(history.timing.retryTimeMs * 2,
+                                          options.maxRetryTimeMs);
+}
+
+void AdaptiveTiming::add(History& history, std::chrono::microseconds roundTrip)
+{
+    auto micros = std::clamp<std::chrono::microseconds::rep>(
+        roundTrip.count(), 0, std::numeric_limits<std::uint32_t>::max());
+
+    history.samples[history.count % historySize] =
+        static_cast<std::uint32_t>(micros);
+    history.count++;
+    if (history.count < options.minSamples)
+    {
+        return;
+    }
+
+    std::size_t n = std::min(history.count, historySize);
+    std::array<std::uint32_t, historySize> sorted = history.samples;
+    std::size_t rank = (n * 99 + 99) / 100 - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + rank,
+                     sorted.begin() + n);
+
+    double budgetMs = std::ceil(sorted[rank] * options.factor / 1000.0);
+    budgetMs = std::clamp<double>(budgetMs, options.minRetryTimeMs,
+                                  options.maxRetryTimeMs);
+    history.timing = {options.retries, static_cast<unsigned int>(budgetMs)};
+}
+
+IpmiTiming AdaptiveTiming::longest() const
+{
+    return {options.retries, options.maxRetryTimeMs};
+}
+
+} // namespace ipmiblob
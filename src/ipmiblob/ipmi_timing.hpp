@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+
+namespace ipmiblob
+{
+
+/**
+ * Kernel retry parameters for one request, as passed through
+ * IPMICTL_SEND_COMMAND_SETTIME.
+ */
+struct IpmiTiming
+{
+    /* Retransmissions after the first attempt. */
+    int retries = 0;
+    /* How long each attempt may take. */
+    unsigned int retryTimeMs = 0;
+
+    /**
+     * @return how long to wait for the reply: every attempt, plus some slack
+     *     for the driver to report the last one failing.
+     */
+    int pollTimeoutMs() const;
+
+    bool operator==(const IpmiTiming&) const = default;
+};
+
+/**
+ * Derives request timing from the round trips seen so far for the same kind
+ * of request, so that quick commands such as a session stat fail fast while
+ * slow ones such as a commit keep a long budget.  Each attempt is allowed the
+ * p99 of the recent round trips times a factor, within bounds.  Safe to use
+ * from several threads.
+ */
+class AdaptiveTiming
+{
+  public:
+    struct Options
+    {
+        /* Multiplies the p99 round trip into the budget for an attempt. */
+        double factor = 4.0;
+        /* Bounds on the budget for an attempt.  The upper one, over every
+         * attempt, makes the 15 seconds a request waits without timing, so
+         * a kind with too few samples waits no longer than it used to.
+         */
+        unsigned int minRetryTimeMs = 100;
+        unsigned int maxRetryTimeMs = 7500;
+        int retries = 1;
+        /* Round trips to see before trusting the estimate; until then the
+         * longest budget is used.
+         */
+        std::size_t minSamples = 8;
+    };
+
+    /* Requests are told apart by netfn, command and, for blob requests, the
+     * blob subcommand.
+     */
+    using Kind = std::uint32_t;
+
+    static Kind kindOf(std::uint8_t netfn, std::uint8_t cmd,
+                       std::span<const std::uint8_t> data);
+
+    AdaptiveTiming();
+    explicit AdaptiveTiming(const Options& options);
+
+    /**
+     * @return the timing for the next request of this kind.
+     */
+    IpmiTiming timingFor(Kind kind);
+
+    /**
+     * Account for the round trip of a request of this kind.
+     */
+    void record(Kind kind, std::chrono::microseconds roundTrip);
+
+    /**
+     * Account for a request of this kind whose reply did not come in time.
+     * What was waited is kept as a round trip, since the real one was at
+     * least that long, and the budget for the kind is doubled until the
+     * next reply, so that a BMC turned slow is waited for long enough to be
+     * sampled rather than timed out for good.
+     *
+     * @param[in] waited - from sending the request to giving up on it.
+     */
+    void recordTimeout(Kind kind, std::chrono::microseconds waited);
+
+  private:
+    /* Recent round trips kept per kind. */
+    static constexpr std::size_t historySize = 128;
+
+    struct History
+    {
+        /* Round trips in microseconds, oldest overwritten first. */
+        std::array<std::uint32_t, historySize> samples{};
+        std::size_t count = 0;
+        /* Timing derived from samples, once there are enough. */
+        IpmiTiming timing;
+    };
+
+    /* Add a round trip to history and derive its timing again. */
+    void add(History& history, std::chrono::microseconds roundTrip);
+
+    IpmiTiming longest() const;
+
+    const Options options;
+
+    std::mutex historyMutex;
+    std::unordered_map<Kind, History> histories;
+};
+
+} // namespace ipmiblob
@@ -9,16 +9,33 @@ class BlobInterfaceMock : public BlobInterface
 {
   public:
     virtual ~BlobInterfaceMock() = default;
+
+    /* Both overloads are mocked; these keep any left unmocked by a change
+     * to the interface reachable rather than hidden.
+     */
+    using BlobInterface::commit;
+    using BlobInterface::readBytes;
+    using BlobInterface::writeBytes;
+    using BlobInterface::writeMeta;
+
     MOCK_METHOD(void, commit, (std::uint16_t, const std::vector<std::uint8_t>&),
                 (override));
+    MOCK_METHOD(void, commit, (std::uint16_t, std::span<const std::uint8_t>),
+                (override));
     MOCK_METHOD(void, writeMeta,
                 (std::uint16_t, std::uint32_t,
                  const std::vector<std::uint8_t>&),
                 (override));
+    MOCK_METHOD(void, writeMeta,
+                (std::uint16_t, std::uint32_t, std::span<const std::uint8_t>),
+                (override));
     MOCK_METHOD(void, writeBytes,
                 (std::uint16_t, std::uint32_t,
                  const std::vector<std::uint8_t>&),
                 (override));
+    MOCK_METHOD(void, writeBytes,
+                (std::uint16_t, std::uint32_t, std::span<const std::uint8_t>),
+                (override));
     MOCK_METHOD(std::vector<std::string>, getBlobList, (), (override));
     MOCK_METHOD(StatResponse, getStat, (const std::string&), (override));
     MOCK_METHOD(StatResponse, getStat, (std::uint16_t), (override));
@@ -28,6 +45,9 @@ class BlobInterfaceMock : public BlobInterface
     MOCK_METHOD(bool, deleteBlob, (const std::string&), (override));
     MOCK_METHOD(std::vector<std::uint8_t>, readBytes,
                 (std::uint16_t, std::uint32_t, std::uint32_t), (override));
+    MOCK_METHOD(std::size_t, readBytes,
+                (std::uint16_t, std::uint32_t, std::span<std::uint8_t>),
+                (override));
 };
 
 } // namespace ipmiblob
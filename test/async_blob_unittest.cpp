@@ -0,0 +1,275 @@
+#include "fake_blob_bmc.hpp"
+
+#include <ipmiblob/async_blob_handler.hpp>
+#include <ipmiblob/blob_errors.hpp>
+#include <ipmiblob/blob_handler.hpp>
+#include <ipmiblob/blob_layout.hpp>
+#include <ipmiblob/coroutine.hpp>
+#include <ipmiblob/ipmi_errors.hpp>
+#include <ipmiblob/ipmi_interface.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace ipmiblob
+{
+
+using ::testing::ElementsAre;
+
+/* A FakeBlobBmc that holds on to every request until told to answer the
+ * oldest one, like a BMC with requests in flight.  It also lists two blobs,
+ * "b0" and "b1", opens any id with a session numbered after its length, and
+ * stats any id as its one blob of 0x5a bytes.
+ */
+class DeferredIpmi : public FakeBlobBmc
+{
+  public:
+    DeferredIpmi() : FakeBlobBmc(std::vector<std::uint8_t>(0x20, 0x5a))
+    {
+        deferred = true;
+    }
+
+    std::vector<std::uint8_t> sendPacket(
+        std::uint8_t netfn, std::uint8_t cmd,
+        std::vector<std::uint8_t>& data) override
+    {
+        using layout::RequestHeader;
+
+        auto command = static_cast<BlobOEMCommands>(
+            RequestHeader::command::load(data.data()));
+        if (command == failCommand)
+        {
+            throw IpmiException(IpmiError{0xc0});
+        }
+
+        std::span<const std::uint8_t> request =
+            std::span(data).subspan(RequestHeader::size);
+        std::vector<std::uint8_t> payload;
+        switch (command)
+        {
+            case BlobOEMCommands::bmcBlobGetCount:
+                payload.resize(layout::GetCountResponse::size);
+                layout::GetCountResponse::encode(
+                    std::span(payload).first<layout::GetCountResponse::size>(),
+                    2);
+                break;
+            case BlobOEMCommands::bmcBlobEnumerate:
+            {
+                auto index = layout::EnumerateRequest::index::load(
+                    request.data());
+                payload = {'b', static_cast<std::uint8_t>('0' + index), 0x00};
+                break;
+            }
+            case BlobOEMCommands::bmcBlobOpen:
+            {
+                /* The flags precede the nul-terminated id. */
+                auto session = static_cast<std::uint16_t>(
+                    request.size() - layout::OpenRequest::size - 1);
+                payload.resize(layout::OpenResponse::size);
+                layout::OpenResponse::encode(
+                    std::span(payload).first<layout::OpenResponse::size>(),
+                    session);
+                break;
+            }
+            case BlobOEMCommands::bmcBlobStat:
+                payload.resize(layout::StatReply::size);
+                layout::StatReply::encode(
+                    std::span(payload).first<layout::StatReply::size>(),
+                    committing,
+                    static_cast<std::uint32_t>(blob.size()), 0);
+                break;
+            case BlobOEMCommands::bmcBlobCommit:
+            case BlobOEMCommands::bmcBlobClose:
+                break;
+            default:
+                return FakeBlobBmc::sendPacket(netfn, cmd, data);
+        }
+
+        return blobReply(payload);
+    }
+
+    void submit(std::uint8_t netfn, std::uint8_t cmd,
+                std::span<const std::uint8_t> data,
+                IpmiCallback callback) override
+    {
+        commands.push_back(
+            layout::RequestHeader::command::load(data.data()));
+        FakeBlobBmc::submit(netfn, cmd, data, std::move(callback));
+    }
+
+    /* Answer the oldest request. */
+    IpmiResult<void> completeOne()
+    {
+        if (queued.empty())
+        {
+            return std::unexpected(IpmiError{0, "Nothing in flight."});
+        }
+
+        deliver();
+        return {};
+    }
+
+    std::vector<std::uint8_t> commands;
+    /* Answered with a busy completion code instead. */
+    std::optional<BlobOEMCommands> failCommand;
+};
+
+class AsyncBlobTest : public ::testing::Test
+{
+  protected:
+    AsyncBlobTest() :
+        blob(makeTransport()), async(blob),
+        executor([this]() { return ipmi->completeOne(); })
+    {}
+
+    std::unique_ptr<IpmiInterface> makeTransport()
+    {
+        auto transport = std::make_unique<DeferredIpmi>();
+        ipmi = transport.get();
+        return transport;
+    }
+
+    std::uint8_t command(BlobOEMCommands command)
+    {
+        return static_cast<std::uint8_t>(command);
+    }
+
+    DeferredIpmi* ipmi;
+    BlobHandler blob;
+    AsyncBlobHandler async;
+    Executor executor;
+};
+
+/* open, write in chunks, commit, poll, close, as a straight-line coroutine. */
+Task<BlobResult<std::uint16_t>> update(AsyncBlobHandler& blob,
+                                       std::string id, int chunks)
+{
+    std::vector<std::uint8_t> chunk(32, 0xa5);
+
+    auto session = co_await blob.openBlob(id, 0x0002);
+    if (!session)
+    {
+        co_return std::unexpected(session.error());
+    }
+
+    for (int i = 0; i < chunks; ++i)
+    {
+        auto written = co_await blob.writeBytes(*session, i * chunk.size(),
+                                                chunk);
+        if (!written)
+        {
+            co_return std::unexpected(written.error());
+        }
+    }
+
+    if (auto committed = co_await blob.commit(*session); !committed)
+    {
+        co_return std::unexpected(committed.error());
+    }
+    if (auto stat = co_await blob.getStat(*session); !stat)
+    {
+        co_return std::unexpected(stat.error());
+    }
+    if (auto closed = co_await blob.closeBlob(*session); !closed)
+    {
+        co_return std::unexpected(closed.error());
+    }
+
+    co_return *session;
+}
+
+TEST_F(AsyncBlobTest, FlowRunsInOrder)
+{
+    auto session = executor.run(update(async, "/flash/image", 2));
+
+    ASSERT_TRUE(session);
+    EXPECT_EQ(12, *session);
+    EXPECT_THAT(ipmi->commands,
+                ElementsAre(command(BlobOEMCommands::bmcBlobOpen),
+                            command(BlobOEMCommands::bmcBlobWrite),
+                            command(BlobOEMCommands::bmcBlobWrite),
+                            command(BlobOEMCommands::bmcBlobCommit),
+                            command(BlobOEMCommands::bmcBlobSessionStat),
+                            command(BlobOEMCommands::bmcBlobClose)));
+    EXPECT_EQ(1u, ipmi->mostInFlight);
+}
+
+TEST_F(AsyncBlobTest, ConcurrentFlowsShareTheTransport)
+{
+    std::vector<std::uint16_t> finished;
+    auto flow = [&](std::string id) -> Task<void> {
+        auto session = co_await update(async, id, 3);
+        EXPECT_TRUE(session);
+        finished.push_back(session.value_or(0));
+    };
+
+    executor.spawn(flow("/a"));
+    executor.spawn(flow("/bb"));
+    executor.spawn(flow("/ccc"));
+    executor.run();
+
+    /* Each flow always has one request outstanding. */
+    EXPECT_EQ(3u, ipmi->mostInFlight);
+    EXPECT_EQ(3u * 7, ipmi->commands.size());
+    EXPECT_THAT(finished, ElementsAre(2, 3, 4));
+}
+
+TEST_F(AsyncBlobTest, FailuresComeBackByValue)
+{
+    ipmi->failCommand = BlobOEMCommands::bmcBlobWrite;
+
+    auto session = executor.run(update(async, "/flash/image", 2));
+
+    ASSERT_FALSE(session);
+    EXPECT_EQ(0xc0, session.error().code);
+    /* The flow stops at the first failed write. */
+    EXPECT_EQ(2u, ipmi->commands.size());
+}
+
+TEST_F(AsyncBlobTest, ReadAndListBlobs)
+{
+    auto task = [&]() -> Task<std::vector<std::uint8_t>> {
+        auto list = co_await async.getBlobList();
+        EXPECT_EQ(std::vector<std::string>({"b0", "b1"}), list.value());
+        auto bytes = co_await async.readBytes(1, 0, 4);
+        co_return bytes.value_or(std::vector<std::uint8_t>());
+    };
+
+    EXPECT_THAT(executor.run(task()), ElementsAre(0x5a, 0x5a, 0x5a, 0x5a));
+}
+
+TEST_F(AsyncBlobTest, ExceptionsEscapeRun)
+{
+    auto task = [&]() -> Task<void> {
+        co_await async.closeBlob(1);
+        throw std::runtime_error("flow failed");
+    };
+
+    executor.spawn(task());
+    EXPECT_THROW(executor.run(), std::runtime_error);
+}
+
+TEST(AsyncBlobSyncTransportTest, CompletesWithoutWaiting)
+{
+    /* A transport that answers within submit() needs no wait hook. */
+    auto immediate = std::make_unique<DeferredIpmi>();
+    immediate->deferred = false;
+
+    BlobHandler blob(std::move(immediate));
+    AsyncBlobHandler async(blob);
+    Executor executor;
+
+    auto session = executor.run(update(async, "/flash/image", 4));
+    ASSERT_TRUE(session);
+    EXPECT_EQ(12, *session);
+}
+
+} // namespace ipmiblob
@@ -0,0 +1,227 @@
+#include "blob_reply_builder.hpp"
+
+#include <linux/ipmi.h>
+#include <sys/ioctl.h>
+
+#include <ipmiblob/blob_handler.hpp>
+#include <ipmiblob/internal/sys_interface.hpp>
+#include <ipmiblob/ipmi_handler.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace
+{
+std::atomic<std::size_t> allocations = 0;
+}
+
+/* Kept out of line, so GCC does not see malloc and free meet new and delete
+ * expressions once inlined, and report them as mismatched.
+ */
+__attribute__((noinline)) void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+__attribute__((noinline)) void operator delete(void* ptr,
+                                               std::size_t) noexcept
+{
+    ::operator delete(ptr);
+}
+
+namespace ipmiblob
+{
+
+/* A device that answers every request with a canned reply.  gmock allocates
+ * on every call, so this is a plain fake instead.
+ */
+class FakeIpmiSys : public internal::Sys
+{
+  public:
+    int open(const char*, int) const override
+    {
+        return 3;
+    }
+    int read(int, void*, std::size_t) const override
+    {
+        return -1;
+    }
+    int close(int) const override
+    {
+        return 0;
+    }
+    void* mmap(void*, std::size_t, int, int, int, off_t) const override
+    {
+        return MAP_FAILED;
+    }
+    int munmap(void*, std::size_t) const override
+    {
+        return -1;
+    }
+    int getpagesize() const override
+    {
+        return 4096;
+    }
+    int fstat(int, struct stat*) const override
+    {
+        return -1;
+    }
+    int madvise(void*, std::size_t, int) const override
+    {
+        return -1;
+    }
+    int poll(struct pollfd*, nfds_t, int) const override
+    {
+        return 1;
+    }
+
+    int ioctl(int, unsigned long request, void* param) const override
+    {
+        if (request == IPMICTL_SEND_COMMAND)
+        {
+            msgid = static_cast<ipmi_req*>(param)->msgid;
+            return 0;
+        }
+
+        if (request == IPMICTL_RECEIVE_MSG_TRUNC)
+        {
+            auto recv = static_cast<ipmi_recv*>(param);
+            recv->msgid = msgid;
+            recv->msg.data[0] = 0x00;
+            std::memcpy(&recv->msg.data[1], reply.data(), reply.size());
+            recv->msg.data_len = reply.size() + 1;
+            return 0;
+        }
+
+        return -1;
+    }
+
+    /* The reply payload, after the completion code. */
+    std::vector<std::uint8_t> reply;
+
+  private:
+    mutable long msgid = 0;
+};
+
+class BlobAllocTest : public ::testing::Test
+{
+  protected:
+    BlobAllocTest()
+    {
+        auto fake = std::make_unique<FakeIpmiSys>();
+        sys = fake.get();
+        blob = std::make_unique<BlobHandler>(
+            std::make_unique<IpmiHandler>(std::move(fake)));
+    }
+
+    /* Reply with the OEN followed by the CRC and data, if any. */
+    void setReply(const std::vector<std::uint8_t>& data)
+    {
+        sys->reply = blobReply(data);
+    }
+
+    FakeIpmiSys* sys;
+    std::unique_ptr<BlobHandler> blob;
+};
+
+TEST_F(BlobAllocTest, writeBytesDoesNotAllocate)
+{
+    std::vector<std::uint8_t> bytes(200, 0xa5);
+    setReply({});
+
+    /* The first call opens the device, which is allowed to allocate. */
+    blob->writeBytes(1, 0, bytes);
+
+    std::size_t before = allocations.load();
+    for (std::uint32_t offset = 0; offset < 100 * bytes.size();
+         offset += bytes.size())
+    {
+        blob->writeBytes(1, offset, bytes);
+    }
+    blob->writeMeta(1, 0, bytes);
+    blob->commit(1, {});
+    blob->closeBlob(1);
+    EXPECT_EQ(before, allocations.load());
+}
+
+TEST_F(BlobAllocTest, readBytesOnlyAllocatesResult)
+{
+    std::vector<std::uint8_t> data(128, 0x5a);
+    setReply(data);
+    EXPECT_EQ(data, blob->readBytes(1, 0, data.size()));
+
+    std::size_t before = allocations.load();
+    for (int i = 0; i < 100; ++i)
+    {
+        auto bytes = blob->readBytes(1, 0, data.size());
+    }
+    EXPECT_EQ(before + 100, allocations.load());
+}
+
+TEST_F(BlobAllocTest, spanTransfersDoNotAllocate)
+{
+    std::vector<std::uint8_t> data(128, 0x5a);
+    std::array<std::uint8_t, 256> image = {};
+    std::array<std::uint8_t, 128> out = {};
+
+    setReply({});
+    blob->writeBytes(1, 0, std::span(image).subspan(64, 128));
+
+    std::size_t before = allocations.load();
+    blob->writeBytes(1, 0, std::span(image).subspan(64, 128));
+    blob->writeMeta(1, 0, std::span(image).first(16));
+    blob->commit(1, std::span(image).first(4));
+    EXPECT_EQ(before, allocations.load());
+
+    setReply(data);
+    before = allocations.load();
+    EXPECT_EQ(out.size(), blob->readBytes(1, 0, out));
+    EXPECT_EQ(before, allocations.load());
+    EXPECT_TRUE(std::equal(out.begin(), out.end(), data.begin()));
+}
+
+TEST_F(BlobAllocTest, statPollDoesNotAllocate)
+{
+    /* blob_state, size and two bytes of metadata. */
+    setReply({0x04, 0x00, 0x10, 0x00, 0x00, 0x00, 0x02, 0xab, 0xcd});
+    BlobInterface& polled = *blob;
+    StatResponse session;
+    StatResponse named;
+    ASSERT_TRUE(polled.tryGetStatInto(std::uint16_t{1}, session));
+    ASSERT_TRUE(polled.tryGetStatInto("/flash/image", named));
+
+    std::size_t before = allocations.load();
+    for (int i = 0; i < 100; ++i)
+    {
+        ASSERT_TRUE(polled.tryGetStatInto(std::uint16_t{1}, session));
+        ASSERT_TRUE(polled.tryGetStatInto("/flash/image", named));
+        EXPECT_EQ(session, named);
+    }
+    EXPECT_EQ(before, allocations.load());
+
+    EXPECT_EQ(committing, named.blob_state);
+    EXPECT_EQ(0x10u, named.size);
+    EXPECT_EQ(std::vector<std::uint8_t>({0xab, 0xcd}), named.metadata);
+}
+
+} // namespace ipmiblob
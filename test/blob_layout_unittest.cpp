@@ -0,0 +1,82 @@
+#include <ipmiblob/blob_layout.hpp>
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <tuple>
+#include <type_traits>
+
+#include <gtest/gtest.h>
+
+namespace ipmiblob
+{
+namespace layout
+{
+
+namespace
+{
+
+constexpr std::array<std::uint8_t, ReadRequest::size> encodeRead()
+{
+    std::array<std::uint8_t, ReadRequest::size> out = {};
+    ReadRequest::encode(out, 0x0102, 0x03040506, 0x0708090a);
+    return out;
+}
+
+/* Encoding happens entirely at compile time. */
+static_assert(encodeRead() == std::array<std::uint8_t, ReadRequest::size>{
+                                  0x02, 0x01, 0x06, 0x05, 0x04, 0x03, 0x0a,
+                                  0x09, 0x08, 0x07});
+static_assert(ReadRequest::length::load(encodeRead().data()) == 0x0708090a);
+
+/* Named fields are the fields of the layout, in order. */
+static_assert(std::is_same_v<StatReply::blobSize, Field<2, std::uint32_t>>);
+static_assert(std::is_same_v<RequestHeader::oen, Field<0, std::uint32_t, 3>>);
+
+} // namespace
+
+TEST(BlobLayoutTest, RequestHeaderCarriesOenLittleEndian)
+{
+    std::array<std::uint8_t, RequestHeader::size> out = {};
+    RequestHeader::encode(out, phosphorOen, 0x05, 0xabcd);
+
+    std::array<std::uint8_t, RequestHeader::size> expected = {
+        0xcf, 0xc2, 0x00, 0x05, 0xcd, 0xab};
+    EXPECT_EQ(expected, out);
+}
+
+TEST(BlobLayoutTest, ThreeByteFieldLeavesNeighboursAlone)
+{
+    std::array<std::uint8_t, 4> out = {0x11, 0x22, 0x33, 0x44};
+    RequestHeader::oen::store(out.data(), 0xffaabbcc);
+
+    std::array<std::uint8_t, 4> expected = {0xcc, 0xbb, 0xaa, 0x44};
+    EXPECT_EQ(expected, out);
+    EXPECT_EQ(0xaabbccu, RequestHeader::oen::load(out.data()));
+}
+
+TEST(BlobLayoutTest, StatReplyRoundTrips)
+{
+    std::array<std::uint8_t, StatReply::size> out = {};
+    StatReply::encode(out, 0x8001, 0xdeadbeef, 0x20);
+
+    auto [state, size, metadataLength] = StatReply::decode(out);
+    EXPECT_EQ(0x8001, state);
+    EXPECT_EQ(0xdeadbeef, size);
+    EXPECT_EQ(0x20, metadataLength);
+    EXPECT_EQ(0x20, StatReply::metadataLength::load(out.data()));
+}
+
+TEST(BlobLayoutTest, DecodeReadsFromAnyOffset)
+{
+    std::array<std::uint8_t, 8> reply = {0xcf, 0xc2, 0x00, 0x34,
+                                         0x12, 0xaa, 0xbb, 0xcc};
+
+    auto header = std::span(reply).first<ResponseHeader::size>();
+    auto [oen, crc] = ResponseHeader::decode(header);
+    EXPECT_EQ(phosphorOen, oen);
+    EXPECT_EQ(0x1234, crc);
+}
+
+} // namespace layout
+} // namespace ipmiblob
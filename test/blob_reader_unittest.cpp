@@ -0,0 +1,180 @@
+#include "fake_blob_bmc.hpp"
+
+#include <ipmiblob/blob_errors.hpp>
+#include <ipmiblob/blob_handler.hpp>
+#include <ipmiblob/blob_reader.hpp>
+#include <ipmiblob/ipmi_interface.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace ipmiblob
+{
+
+using ::testing::ElementsAre;
+
+class BlobReaderTest : public ::testing::Test
+{
+  protected:
+    BlobReaderTest() :
+        image(pattern(1000)), bmc(new FakeBlobBmc(image)),
+        blob(std::unique_ptr<IpmiInterface>(bmc)), reader(blob, 1)
+    {}
+
+    static std::vector<std::uint8_t> pattern(std::size_t size)
+    {
+        std::vector<std::uint8_t> bytes(size);
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            bytes[i] = static_cast<std::uint8_t>(i * 7);
+        }
+        return bytes;
+    }
+
+    /* Read the blob in records until a short one, as a log parser would. */
+    std::vector<std::uint8_t> readRecords(std::size_t record)
+    {
+        std::vector<std::uint8_t> received;
+        std::vector<std::uint8_t> buffer(record);
+        std::uint32_t offset = 0;
+        while (true)
+        {
+            auto read = reader.read(offset, buffer);
+            EXPECT_TRUE(read);
+            if (!read)
+            {
+                break;
+            }
+            received.insert(received.end(), buffer.begin(),
+                            buffer.begin() + *read);
+            offset += static_cast<std::uint32_t>(*read);
+            if (*read < record)
+            {
+                break;
+            }
+        }
+        return received;
+    }
+
+    std::vector<std::uint8_t> image;
+    FakeBlobBmc* bmc;
+    BlobHandler blob;
+    BlobReader reader;
+};
+
+TEST_F(BlobReaderTest, SmallSequentialReadsShareFullChunks)
+{
+    EXPECT_EQ(image, readRecords(16));
+
+    EXPECT_EQ(1u, bmc->stats);
+    EXPECT_THAT(bmc->lengths, ElementsAre(266, 266, 266, 202));
+    EXPECT_EQ(4u, reader.packetsRequested());
+}
+
+TEST_F(BlobReaderTest, ReadsOutOfSequenceGoStraightThrough)
+{
+    std::array<std::uint8_t, 8> out;
+    auto read = reader.read(500, out);
+    ASSERT_TRUE(read);
+    EXPECT_EQ(8u, *read);
+    EXPECT_TRUE(std::equal(out.begin(), out.end(), image.begin() + 500));
+    EXPECT_EQ(0u, bmc->stats);
+
+    /* The next read follows on, so reading ahead starts. */
+    ASSERT_TRUE(reader.read(508, out));
+    EXPECT_TRUE(std::equal(out.begin(), out.end(), image.begin() + 508));
+    EXPECT_EQ(1u, bmc->stats);
+    EXPECT_THAT(bmc->lengths, ElementsAre(8, 266));
+
+    /* Bytes already fetched are served again without asking. */
+    ASSERT_TRUE(reader.read(510, out));
+    ASSERT_TRUE(reader.read(508, out));
+    EXPECT_TRUE(std::equal(out.begin(), out.end(), image.begin() + 508));
+    EXPECT_EQ(2u, bmc->lengths.size());
+}
+
+TEST_F(BlobReaderTest, StopsAtTheSizeTheStatReports)
+{
+    bmc->reportedSize = 300;
+    EXPECT_EQ(std::vector(image.begin(), image.begin() + 300),
+              readRecords(16));
+    EXPECT_THAT(bmc->lengths, ElementsAre(266, 34));
+
+    /* The end is remembered. */
+    std::array<std::uint8_t, 8> out;
+    auto read = reader.read(300, out);
+    ASSERT_TRUE(read);
+    EXPECT_EQ(0u, *read);
+    EXPECT_EQ(2u, bmc->lengths.size());
+}
+
+TEST_F(BlobReaderTest, WritesDropWhatWasReadAhead)
+{
+    std::array<std::uint8_t, 16> out;
+    ASSERT_TRUE(reader.read(0, out));
+
+    std::array<std::uint8_t, 4> written = {0xde, 0xad, 0xbe, 0xef};
+    ASSERT_TRUE(reader.write(16, written));
+
+    std::array<std::uint8_t, 4> back;
+    ASSERT_TRUE(reader.read(16, back));
+    EXPECT_EQ(written, back);
+    EXPECT_EQ(2u, bmc->stats);
+    EXPECT_THAT(bmc->lengths, ElementsAre(266, 266));
+}
+
+TEST_F(BlobReaderTest, PipelinedReadsKeepDepthInFlight)
+{
+    bmc->deferred = true;
+    std::size_t pumps = 0;
+    reader.setPipelining(3, [&]() -> IpmiResult<void> {
+        pumps++;
+        bmc->deliver();
+        return {};
+    });
+
+    EXPECT_EQ(image, readRecords(16));
+    EXPECT_THAT(bmc->lengths, ElementsAre(266, 266, 266, 202));
+    EXPECT_EQ(3u, bmc->mostInFlight);
+    EXPECT_EQ(4u, pumps);
+    EXPECT_TRUE(bmc->queued.empty());
+}
+
+TEST_F(BlobReaderTest, OnlyABlobHandlerIsPipelined)
+{
+    BlobReader plain(static_cast<BlobInterface&>(blob), 1);
+    bool pumped = false;
+    plain.setPipelining(3, [&]() -> IpmiResult<void> {
+        pumped = true;
+        return {};
+    });
+
+    std::array<std::uint8_t, 16> out;
+    ASSERT_TRUE(plain.read(0, out));
+    EXPECT_FALSE(pumped);
+    EXPECT_THAT(bmc->lengths, ElementsAre(266));
+}
+
+TEST_F(BlobReaderTest, FailuresAreReportedAndRetried)
+{
+    std::array<std::uint8_t, 16> out;
+    bmc->failReads = true;
+    auto read = reader.read(0, out);
+    ASSERT_FALSE(read);
+    EXPECT_EQ(0xc0, read.error().code);
+
+    bmc->failReads = false;
+    read = reader.read(0, out);
+    ASSERT_TRUE(read);
+    EXPECT_EQ(16u, *read);
+    EXPECT_TRUE(std::equal(out.begin(), out.end(), image.begin()));
+}
+
+} // namespace ipmiblob
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <ipmiblob/blob_layout.hpp>
+#include <ipmiblob/crc.hpp>
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace ipmiblob
+{
+
+/* Frame a blob reply as the BMC does: the OEN, then the CRC of the payload
+ * and the payload itself, or only the OEN when there is no payload.
+ */
+inline std::vector<std::uint8_t> blobReply(
+    std::span<const std::uint8_t> payload = {})
+{
+    using layout::ResponseHeader;
+
+    if (payload.empty())
+    {
+        std::vector<std::uint8_t> reply(ResponseHeader::oen::end);
+        ResponseHeader::oen::store(reply.data(), layout::phosphorOen);
+        return reply;
+    }
+
+    std::vector<std::uint8_t> reply(ResponseHeader::size);
+    ResponseHeader::encode(std::span(reply).first<ResponseHeader::size>(),
+                           layout::phosphorOen, generateCrc(payload));
+    reply.insert(reply.end(), payload.begin(), payload.end());
+    return reply;
+}
+
+} // namespace ipmiblob
@@ -0,0 +1,213 @@
+#include "fake_blob_bmc.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <ipmiblob/blob_errors.hpp>
+#include <ipmiblob/blob_handler.hpp>
+#include <ipmiblob/blob_layout.hpp>
+#include <ipmiblob/blob_sink.hpp>
+#include <ipmiblob/ipmi_interface.hpp>
+#include <ipmiblob/test/blob_interface_mock.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <expected>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace ipmiblob
+{
+
+using ::testing::A;
+using ::testing::ElementsAre;
+using ::testing::Return;
+using ::testing::Throw;
+
+std::vector<std::uint8_t> pattern(std::size_t size)
+{
+    std::vector<std::uint8_t> bytes(size);
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        bytes[i] = static_cast<std::uint8_t>(i * 7);
+    }
+    return bytes;
+}
+
+class ReadBlobTest : public ::testing::Test
+{
+  protected:
+    ReadBlobTest() :
+        image(pattern(1000)), bmc(new FakeBlobBmc(image)),
+        blob(std::unique_ptr<IpmiInterface>(bmc))
+    {}
+
+    std::vector<std::uint8_t> image;
+    FakeBlobBmc* bmc;
+    BlobHandler blob;
+};
+
+TEST_F(ReadBlobTest, ChunksToTheLargestPayload)
+{
+    std::vector<std::uint8_t> received;
+    std::size_t chunks = 0;
+    CallbackSink sink([&](std::span<const std::uint8_t> bytes) {
+        received.insert(received.end(), bytes.begin(), bytes.end());
+        chunks++;
+        return BlobResult<void>();
+    });
+
+    EXPECT_EQ(1000u, blob.readBlob(1, sink));
+    EXPECT_EQ(image, received);
+    EXPECT_EQ(4u, chunks);
+    EXPECT_THAT(bmc->lengths, ElementsAre(266, 266, 266, 202));
+}
+
+TEST_F(ReadBlobTest, SinkFailureStopsTheRead)
+{
+    CallbackSink sink([](std::span<const std::uint8_t>) -> BlobResult<void> {
+        return std::unexpected("full");
+    });
+
+    auto read = blob.tryReadBlob(1, sink);
+    ASSERT_FALSE(read);
+    EXPECT_STREQ("full", read.error().reason);
+    EXPECT_EQ(1u, bmc->lengths.size());
+    EXPECT_THROW(blob.readBlob(1, sink), BlobException);
+}
+
+TEST_F(ReadBlobTest, BlobShorterThanItsStatIsAnError)
+{
+    bmc->reportedSize = 1200;
+    CallbackSink sink(
+        [](std::span<const std::uint8_t>) { return BlobResult<void>(); });
+
+    auto read = blob.tryReadBlob(1, sink);
+    ASSERT_FALSE(read);
+    EXPECT_STREQ("Blob ended before its reported size", read.error().reason);
+}
+
+TEST_F(ReadBlobTest, FdSinkWritesEveryByte)
+{
+    int fd = ::memfd_create("blob_sink_unittest", MFD_CLOEXEC);
+    ASSERT_GE(fd, 0);
+
+    FdSink sink(fd);
+    EXPECT_EQ(1000u, blob.readBlob(1, sink));
+
+    std::vector<std::uint8_t> written(1000);
+    EXPECT_EQ(1000, ::pread(fd, written.data(), written.size(), 0));
+    EXPECT_EQ(image, written);
+    ::close(fd);
+}
+
+TEST_F(ReadBlobTest, FileSinkCreatesTheFile)
+{
+    std::string path = ::testing::TempDir() + "blob_sink_unittest.bin";
+    {
+        FileSink sink(path);
+        EXPECT_EQ(1000u, blob.readBlob(1, sink));
+    }
+
+    std::vector<std::uint8_t> written(2000);
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    ASSERT_NE(nullptr, file);
+    written.resize(std::fread(written.data(), 1, written.size(), file));
+    std::fclose(file);
+    std::remove(path.c_str());
+    EXPECT_EQ(image, written);
+}
+
+TEST_F(ReadBlobTest, FileSinkReportsAFailureToOpen)
+{
+    FileSink sink("/nonexistent/blob_sink_unittest.bin");
+    auto read = blob.tryReadBlob(1, sink);
+    ASSERT_FALSE(read);
+    EXPECT_STREQ("Unable to open file for blob data", read.error().reason);
+}
+
+TEST(BlobInterfaceReadBlobTest, DefaultReadsThroughReadBytes)
+{
+    BlobInterfaceMock blob;
+    EXPECT_CALL(blob, getStat(std::uint16_t{1}))
+        .WillOnce(Return(StatResponse{open_read, 300, {}}));
+    using Out = std::span<std::uint8_t>;
+    EXPECT_CALL(blob, readBytes(1, 0, A<Out>()))
+        .WillOnce([](std::uint16_t, std::uint32_t, Out out) {
+            EXPECT_EQ(layout::maxReadPayload, out.size());
+            std::fill(out.begin(), out.end(), 'a');
+            return out.size();
+        });
+    EXPECT_CALL(blob, readBytes(1, 266, A<Out>()))
+        .WillOnce([](std::uint16_t, std::uint32_t, Out out) {
+            EXPECT_EQ(34u, out.size());
+            std::fill(out.begin(), out.end(), 'b');
+            return out.size();
+        });
+
+    std::string received;
+    CallbackSink sink([&](std::span<const std::uint8_t> bytes) {
+        received.append(bytes.begin(), bytes.end());
+        return BlobResult<void>();
+    });
+    EXPECT_EQ(300u, blob.readBlob(1, sink));
+    EXPECT_EQ(std::string(266, 'a') + std::string(34, 'b'), received);
+}
+
+TEST(BlobInterfaceUploadFileTest, DefaultWritesThroughWriteBytes)
+{
+    std::string path = ::testing::TempDir() + "blob_upload_unittest.bin";
+    std::vector<std::uint8_t> image = pattern(300);
+    {
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        ASSERT_NE(nullptr, file);
+        std::fwrite(image.data(), 1, image.size(), file);
+        std::fclose(file);
+    }
+
+    BlobInterfaceMock blob;
+    std::vector<std::uint8_t> written;
+    auto take = [&written](std::uint16_t, std::uint32_t offset,
+                           std::span<const std::uint8_t> bytes) {
+        EXPECT_EQ(written.size(), offset);
+        written.insert(written.end(), bytes.begin(), bytes.end());
+    };
+    using Bytes = std::span<const std::uint8_t>;
+    EXPECT_CALL(blob, writeBytes(1, 0, A<Bytes>())).WillOnce(take);
+    EXPECT_CALL(blob, writeBytes(1, 260, A<Bytes>())).WillOnce(take);
+
+    EXPECT_EQ(300u, blob.uploadFile(1, path));
+    EXPECT_EQ(image, written);
+    std::remove(path.c_str());
+
+    auto missing = blob.tryUploadFile(1, path);
+    ASSERT_FALSE(missing);
+    EXPECT_STREQ("Unable to open file to upload", missing.error().reason);
+}
+
+TEST(BlobInterfaceTryTest, DefaultsKeepTheExceptionMessage)
+{
+    BlobInterfaceMock blob;
+    EXPECT_CALL(blob, closeBlob(1))
+        .WillOnce(Throw(BlobException(std::string("Session 1 is gone"))));
+    EXPECT_CALL(blob, deleteBlob("/flash/image")).WillOnce(Return(false));
+
+    BlobResult<void> closed = blob.tryCloseBlob(1);
+    ASSERT_FALSE(closed);
+    BlobError kept = closed.error();
+    closed = {};
+    EXPECT_EQ(0, kept.code);
+    EXPECT_EQ("Session 1 is gone", kept.message());
+
+    EXPECT_FALSE(blob.tryDeleteBlob("/flash/image"));
+}
+
+} // namespace ipmiblob
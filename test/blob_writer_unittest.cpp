@@ -0,0 +1,147 @@
+#include <ipmiblob/blob_errors.hpp>
+#include <ipmiblob/blob_writer.hpp>
+#include <ipmiblob/test/blob_interface_mock.hpp>
+
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace ipmiblob
+{
+
+using ::testing::_;
+using ::testing::A;
+using ::testing::ElementsAre;
+using ::testing::InSequence;
+using ::testing::Return;
+using ::testing::Throw;
+
+using Bytes = std::span<const std::uint8_t>;
+
+class BlobWriterTest : public ::testing::Test
+{
+  protected:
+    BlobWriterTest()
+    {
+        ON_CALL(blob, writeBytes(1, _, A<Bytes>()))
+            .WillByDefault([this](std::uint16_t, std::uint32_t offset,
+                                  Bytes bytes) {
+                packets.emplace_back(
+                    offset, std::vector<std::uint8_t>(bytes.begin(),
+                                                      bytes.end()));
+            });
+    }
+
+    std::vector<std::uint8_t> record(std::size_t size, std::uint8_t first)
+    {
+        std::vector<std::uint8_t> bytes(size);
+        std::iota(bytes.begin(), bytes.end(), first);
+        return bytes;
+    }
+
+    ::testing::NiceMock<BlobInterfaceMock> blob;
+    std::vector<std::pair<std::uint32_t, std::vector<std::uint8_t>>> packets;
+};
+
+TEST_F(BlobWriterTest, MergesContiguousWritesIntoFullPackets)
+{
+    BlobWriter writer(blob, 1, 100);
+    std::uint32_t offset = 0;
+    for (int i = 0; i < 50; ++i)
+    {
+        ASSERT_TRUE(writer.write(offset, record(10, offset)));
+        offset += 10;
+    }
+    EXPECT_EQ(5u, writer.packetsSent());
+    EXPECT_EQ(0u, writer.buffered());
+
+    ASSERT_EQ(5u, packets.size());
+    for (std::size_t i = 0; i < packets.size(); ++i)
+    {
+        EXPECT_EQ(i * 100, packets[i].first);
+        EXPECT_EQ(record(100, i * 100), packets[i].second);
+    }
+}
+
+TEST_F(BlobWriterTest, FlushesOnAGapAndOnRequest)
+{
+    BlobWriter writer(blob, 1, 100);
+    ASSERT_TRUE(writer.write(0, record(10, 0)));
+    ASSERT_TRUE(writer.write(10, record(10, 10)));
+    /* Not contiguous: what was buffered goes first. */
+    ASSERT_TRUE(writer.write(50, record(5, 50)));
+    EXPECT_EQ(1u, packets.size());
+    EXPECT_EQ(5u, writer.buffered());
+
+    ASSERT_TRUE(writer.flush());
+    ASSERT_EQ(2u, packets.size());
+    EXPECT_EQ(0u, packets[0].first);
+    EXPECT_EQ(record(20, 0), packets[0].second);
+    EXPECT_EQ(50u, packets[1].first);
+    EXPECT_EQ(record(5, 50), packets[1].second);
+
+    /* Nothing left to send. */
+    ASSERT_TRUE(writer.flush());
+    EXPECT_EQ(2u, packets.size());
+}
+
+TEST_F(BlobWriterTest, LargeWritesGoStraightOut)
+{
+    BlobWriter writer(blob, 1, 100);
+    ASSERT_TRUE(writer.write(0, record(30, 0)));
+    ASSERT_TRUE(writer.write(30, record(250, 30)));
+
+    /* The buffer is topped up and sent, then a whole packet from the
+     * caller's bytes, and the rest buffered.
+     */
+    ASSERT_EQ(2u, packets.size());
+    EXPECT_EQ(0u, packets[0].first);
+    EXPECT_EQ(100u, packets[1].first);
+    EXPECT_EQ(record(100, 100), packets[1].second);
+    EXPECT_EQ(80u, writer.buffered());
+}
+
+TEST_F(BlobWriterTest, CommitAndCloseFlushFirst)
+{
+    InSequence ordered;
+    EXPECT_CALL(blob, writeBytes(1, 0, A<Bytes>()));
+    EXPECT_CALL(blob, commit(1, A<Bytes>()));
+    EXPECT_CALL(blob, writeBytes(1, 10, A<Bytes>()));
+    EXPECT_CALL(blob, closeBlob(1));
+
+    BlobWriter writer(blob, 1);
+    ASSERT_TRUE(writer.write(0, record(10, 0)));
+    ASSERT_TRUE(writer.commit());
+    ASSERT_TRUE(writer.write(10, record(10, 10)));
+    ASSERT_TRUE(writer.close());
+}
+
+TEST_F(BlobWriterTest, FailuresAreReportedWhenFlushingAndKeepTheBuffer)
+{
+    BlobWriter writer(blob, 1, 100);
+    ASSERT_TRUE(writer.write(0, record(60, 0)));
+
+    EXPECT_CALL(blob, writeBytes(1, 0, A<Bytes>()))
+        .WillOnce(Throw(BlobException(BlobError(IpmiError{0xc0}))))
+        .WillOnce([this](std::uint16_t, std::uint32_t offset, Bytes bytes) {
+            packets.emplace_back(
+                offset, std::vector<std::uint8_t>(bytes.begin(), bytes.end()));
+        });
+
+    /* Filling the buffer sends it, which fails; the write is not taken. */
+    auto written = writer.write(60, record(60, 60));
+    ASSERT_FALSE(written);
+    EXPECT_EQ(0xc0, written.error().code);
+    EXPECT_EQ(60u, writer.buffered());
+
+    ASSERT_TRUE(writer.flush());
+    ASSERT_EQ(1u, packets.size());
+    EXPECT_EQ(record(60, 0), packets[0].second);
+}
+
+} // namespace ipmiblob
@@ -1,3 +1,6 @@
+#include "fake_blob_bmc.hpp"
+#include "fake_bmc.hpp"
+
 #include <ipmiblob/test/blob_interface_mock.hpp>
 #include <ipmiblob/test/crc_mock.hpp>
 #include <ipmiblob/test/ipmi_interface_mock.hpp>
@@ -12,6 +15,8 @@ TEST(BuildMockObjects, buildAllMocks)
     BlobInterfaceMock blobMock;
     CrcMock crcMock;
     IpmiInterfaceMock ipmiMock;
+    FakeBmc fakeBmc;
+    FakeBlobBmc fakeBlobBmc({});
 }
 
 } // namespace ipmiblob
@@ -1,6 +1,9 @@
 #include <ipmiblob/crc.hpp>
+#include <ipmiblob/internal/crc_kernels.hpp>
 
 #include <cstdint>
+#include <random>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -41,4 +44,90 @@ TEST(Crc16Test, VerifyCrcValue)
         EXPECT_EQ(generateCrc(input), testVector.output);
     }
 }
+
+TEST(Crc16Test, StreamingMatchesOneShot)
+{
+    // Feeding the message in pieces gives the same CRC as all at once.
+    std::string check = "123456789";
+    std::vector<std::uint8_t> input(check.begin(), check.end());
+    std::span<const std::uint8_t> in(input);
+
+    Crc16 crc;
+    EXPECT_EQ(0x1D0F, crc.finalize());
+
+    crc.update(in.first(1)).update(in.subspan(1, 4)).update(in.subspan(5));
+    EXPECT_EQ(0xE5CC, crc.finalize());
+
+    crc.reset();
+    crc.update({in.first(2), in.subspan(2, 0), in.subspan(2)});
+    EXPECT_EQ(0xE5CC, crc.finalize());
+
+    std::vector<std::span<const std::uint8_t>> pieces = {in.first(3),
+                                                         in.subspan(3)};
+    crc.reset();
+    EXPECT_EQ(0xE5CC, crc.update(pieces).finalize());
+    EXPECT_EQ(generateCrc(input), generateCrc(in));
+}
+
+TEST(Crc16Test, KernelsMatchKnownValues)
+{
+    // Every kernel the CPU can run must give the reference values.
+    std::string check = "123456789";
+    std::vector<std::uint8_t> input(check.begin(), check.end());
+
+    for (const internal::CrcKernel& kernel : internal::crcKernels())
+    {
+        if (!kernel.supported())
+        {
+            continue;
+        }
+
+        EXPECT_EQ(0x1D0F, kernel.update(internal::crcSeed, {})) << kernel.name;
+        EXPECT_EQ(0xE5CC, kernel.update(internal::crcSeed, input))
+            << kernel.name;
+    }
+}
+
+TEST(Crc16Test, KernelsAgreeWithBitwise)
+{
+    // Compare each kernel against the reference over lengths that exercise
+    // the block loops as well as their byte-wise tails, fed in two pieces.
+    std::mt19937 gen(0x1021);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::vector<std::uint8_t> data(1031);
+    for (auto& b : data)
+    {
+        b = static_cast<std::uint8_t>(byte(gen));
+    }
+
+    for (const internal::CrcKernel& kernel : internal::crcKernels())
+    {
+        if (!kernel.supported())
+        {
+            continue;
+        }
+
+        for (std::size_t len = 0; len <= data.size(); len += 7)
+        {
+            std::span<const std::uint8_t> in(data.data(), len);
+            std::uint16_t expected =
+                internal::crcUpdateBitwise(internal::crcSeed, in);
+
+            EXPECT_EQ(expected, kernel.update(internal::crcSeed, in))
+                << kernel.name << " len " << len;
+
+            std::size_t split = len / 3;
+            std::uint16_t crc =
+                kernel.update(internal::crcSeed, in.first(split));
+            crc = kernel.update(crc, in.subspan(split));
+            EXPECT_EQ(expected, crc) << kernel.name << " split " << split;
+        }
+    }
+}
+
+TEST(Crc16Test, ActiveKernelIsSupported)
+{
+    EXPECT_TRUE(internal::activeCrcKernel().supported());
+}
+
 } // namespace ipmiblob
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "blob_reply_builder.hpp"
+
+#include <ipmiblob/blob_handler.hpp>
+#include <ipmiblob/blob_interface.hpp>
+#include <ipmiblob/blob_layout.hpp>
+#include <ipmiblob/ipmi_errors.hpp>
+#include <ipmiblob/ipmi_interface.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace ipmiblob
+{
+
+/**
+ * Stands in for a BMC holding one blob, open as session 1, to exercise blob
+ * transfers without hardware.  It answers session stats, reads and writes of
+ * the blob, noting the length of each read asked for, and fails any other
+ * command as invalid.  With deferred set, submitted requests are only
+ * answered when the test delivers them.
+ */
+class FakeBlobBmc : public IpmiInterface
+{
+  public:
+    explicit FakeBlobBmc(std::vector<std::uint8_t> blob) :
+        blob(std::move(blob))
+    {}
+
+    std::vector<std::uint8_t> sendPacket(
+        std::uint8_t, std::uint8_t, std::vector<std::uint8_t>& data) override
+    {
+        using layout::ReadRequest;
+        using layout::RequestHeader;
+        using layout::WriteRequest;
+
+        std::span<const std::uint8_t> payload =
+            std::span(data).subspan(RequestHeader::size);
+        std::vector<std::uint8_t> bytes;
+        switch (static_cast<BlobOEMCommands>(data[3]))
+        {
+            case BlobOEMCommands::bmcBlobSessionStat:
+                stats++;
+                bytes.resize(layout::StatReply::size);
+                layout::StatReply::encode(
+                    std::span(bytes).first<layout::StatReply::size>(),
+                    open_read | open_write,
+                    reportedSize.value_or(
+                        static_cast<std::uint32_t>(blob.size())),
+                    0);
+                break;
+            case BlobOEMCommands::bmcBlobRead:
+            {
+                if (failReads)
+                {
+                    throw IpmiException(IpmiError{0xc0, nullptr});
+                }
+                auto [session, offset, length] =
+                    ReadRequest::decode(payload.first<ReadRequest::size>());
+                lengths.push_back(length);
+                std::size_t begin = std::min<std::size_t>(offset, blob.size());
+                std::size_t end =
+                    std::min<std::size_t>(begin + length, blob.size());
+                bytes.assign(blob.begin() + begin, blob.begin() + end);
+                break;
+            }
+            case BlobOEMCommands::bmcBlobWrite:
+            {
+                auto [session, offset] =
+                    WriteRequest::decode(payload.first<WriteRequest::size>());
+                auto written = payload.subspan(WriteRequest::size);
+                if (offset + written.size() > blob.size())
+                {
+                    blob.resize(offset + written.size());
+                }
+                std::copy(written.begin(), written.end(),
+                          blob.begin() + offset);
+                break;
+            }
+            default:
+                throw IpmiException(IpmiError{0xc1, nullptr});
+        }
+
+        return blobReply(bytes);
+    }
+
+    void submit(std::uint8_t netfn, std::uint8_t cmd,
+                std::span<const std::uint8_t> data,
+                IpmiCallback callback) override
+    {
+        if (!deferred)
+        {
+            IpmiInterface::submit(netfn, cmd, data, std::move(callback));
+            return;
+        }
+        queued.emplace_back(std::vector<std::uint8_t>(data.begin(), data.end()),
+                            std::move(callback));
+        mostInFlight = std::max(mostInFlight, queued.size());
+    }
+
+    /* Answer the oldest submitted request. */
+    void deliver()
+    {
+        auto [data, callback] = std::move(queued.front());
+        queued.pop_front();
+        IpmiInterface::submit(ipmiOEMNetFn, ipmiOEMBlobCmd, data,
+                              std::move(callback));
+    }
+
+    std::vector<std::uint8_t> blob;
+    /* What the stat says, if not the size of the blob. */
+    std::optional<std::uint32_t> reportedSize;
+    /* Fail reads as busy. */
+    bool failReads = false;
+    std::size_t stats = 0;
+    std::vector<std::uint32_t> lengths;
+
+    bool deferred = false;
+    std::deque<std::pair<std::vector<std::uint8_t>, IpmiCallback>> queued;
+    std::size_t mostInFlight = 0;
+};
+
+} // namespace ipmiblob
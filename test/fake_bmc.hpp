@@ -0,0 +1,166 @@
+#pragma once
+
+#include <ipmiblob/ipmi_errors.hpp>
+#include <ipmiblob/ipmi_interface.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ipmiblob
+{
+
+/**
+ * Stands in for the BMC, to exercise transports and the proxy without
+ * hardware.  Requests made with submit() are answered one at a time, in
+ * order, by a thread of its own after a fixed latency, so callbacks arrive
+ * asynchronously as they do from the device; the synchronous calls answer
+ * straight away.  The responder echoes the request unless replaced.
+ */
+class FakeBmc : public IpmiInterface
+{
+  public:
+    /* Produce the reply to a request, or the completion code to fail it
+     * with.
+     */
+    using Responder = std::function<IpmiResult<std::vector<std::uint8_t>>(
+        std::uint8_t netfn, std::uint8_t cmd,
+        std::span<const std::uint8_t> data)>;
+
+    explicit FakeBmc(Responder responder = echo,
+                     std::chrono::microseconds latency = {}) :
+        responder(std::move(responder)), latency(latency),
+        worker([this] { serve(); })
+    {}
+
+    /* Requests not yet answered are dropped without their callbacks. */
+    ~FakeBmc()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        queued.notify_all();
+        worker.join();
+    }
+
+    FakeBmc(const FakeBmc&) = delete;
+    FakeBmc& operator=(const FakeBmc&) = delete;
+
+    std::vector<std::uint8_t> sendPacket(
+        std::uint8_t netfn, std::uint8_t cmd,
+        std::vector<std::uint8_t>& data) override
+    {
+        auto returned = respond(netfn, cmd, data);
+        if (!returned)
+        {
+            throw IpmiException(returned.error());
+        }
+
+        return *returned;
+    }
+
+    void submit(std::uint8_t netfn, std::uint8_t cmd,
+                std::span<const std::uint8_t> data,
+                IpmiCallback callback) override
+    {
+        {
+            std::lock_guard lock(mutex);
+            requests.push_back(Request{
+                netfn, cmd, std::vector<std::uint8_t>(data.begin(), data.end()),
+                std::move(callback)});
+            peak = std::max(peak, requests.size());
+        }
+        queued.notify_all();
+    }
+
+    /**
+     * @return the most submit() requests ever waiting at once, which shows
+     *     whether a caller pipelines.
+     */
+    std::size_t peakQueued()
+    {
+        std::lock_guard lock(mutex);
+        return peak;
+    }
+
+    static IpmiResult<std::vector<std::uint8_t>> echo(
+        std::uint8_t, std::uint8_t, std::span<const std::uint8_t> data)
+    {
+        return std::vector<std::uint8_t>(data.begin(), data.end());
+    }
+
+  private:
+    struct Request
+    {
+        std::uint8_t netfn;
+        std::uint8_t cmd;
+        std::vector<std::uint8_t> data;
+        IpmiCallback callback;
+    };
+
+    IpmiResult<std::vector<std::uint8_t>> respond(
+        std::uint8_t netfn, std::uint8_t cmd,
+        std::span<const std::uint8_t> data)
+    {
+        /* The BMC handles one request at a time. */
+        std::lock_guard lock(bmcMutex);
+        return responder(netfn, cmd, data);
+    }
+
+    void serve()
+    {
+        std::unique_lock lock(mutex);
+        while (true)
+        {
+            queued.wait(lock, [this] { return stopping || !requests.empty(); });
+            if (stopping)
+            {
+                return;
+            }
+
+            /* Stays queued while being answered, as on the BMC. */
+            lock.unlock();
+            std::this_thread::sleep_for(latency);
+            lock.lock();
+            Request request = std::move(requests.front());
+            requests.pop_front();
+            lock.unlock();
+
+            auto returned = respond(request.netfn, request.cmd, request.data);
+            if (returned)
+            {
+                request.callback(std::span<const std::uint8_t>(*returned));
+            }
+            else
+            {
+                request.callback(std::unexpected(returned.error()));
+            }
+            lock.lock();
+        }
+    }
+
+    const Responder responder;
+    const std::chrono::microseconds latency;
+    std::mutex bmcMutex;
+
+    std::mutex mutex;
+    std::condition_variable queued;
+    std::deque<Request> requests;
+    std::size_t peak = 0;
+    bool stopping = false;
+
+    /* Last, so that it starts once everything above is ready. */
+    std::thread worker;
+};
+
+} // namespace ipmiblob
@@ -23,6 +23,8 @@ class InternalSysMock : public Sys
                 (const, override));
     MOCK_METHOD(int, munmap, (void*, std::size_t), (const, override));
     MOCK_METHOD(int, getpagesize, (), (const, override));
+    MOCK_METHOD(int, fstat, (int, struct stat*), (const, override));
+    MOCK_METHOD(int, madvise, (void*, std::size_t, int), (const, override));
     MOCK_METHOD(int, ioctl, (int, unsigned long, void*), (const, override));
     MOCK_METHOD(int, poll, (struct pollfd*, nfds_t, int), (const, override));
 };
@@ -0,0 +1,144 @@
+#include <ipmiblob/blob_handler.hpp>
+#include <ipmiblob/ipmi_congestion.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace ipmiblob
+{
+
+using std::chrono::milliseconds;
+using Signal = CongestionControl::Signal;
+
+TEST(CongestionControlTest, WindowStartsFullAndHalvesOnCongestion)
+{
+    CongestionControl control(8, {});
+    EXPECT_EQ(8u, control.allowed());
+
+    control.record(Signal::busy);
+    EXPECT_EQ(4u, control.allowed());
+
+    /* Once per window's worth of replies: the other seven in flight when
+     * the first came back busy say nothing new.
+     */
+    for (int i = 0; i < 7; ++i)
+    {
+        control.record(Signal::busy);
+    }
+    EXPECT_EQ(4u, control.allowed());
+    control.record(Signal::timeout);
+    EXPECT_EQ(2u, control.allowed());
+
+    /* Never below one request. */
+    for (int i = 0; i < 10; ++i)
+    {
+        control.record(Signal::busy);
+    }
+    EXPECT_EQ(1u, control.allowed());
+
+    CongestionStats stats = control.stats();
+    EXPECT_EQ(18u, stats.busy);
+    EXPECT_EQ(1u, stats.timeouts);
+}
+
+TEST(CongestionControlTest, WindowGrowsByOnePerWindowOfSuccesses)
+{
+    CongestionControl control(4, {});
+    control.record(Signal::busy);
+    ASSERT_EQ(2u, control.allowed());
+
+    control.record(Signal::success);
+    control.record(Signal::success);
+    EXPECT_EQ(2u, control.allowed());
+    control.record(Signal::success);
+    EXPECT_EQ(3u, control.allowed());
+
+    /* Other failures say nothing about load. */
+    control.record(Signal::other);
+    EXPECT_EQ(3u, control.allowed());
+
+    for (int i = 0; i < 100; ++i)
+    {
+        control.record(Signal::success);
+    }
+    EXPECT_EQ(4u, control.allowed());
+    EXPECT_EQ(4.0, control.stats().window);
+}
+
+TEST(CongestionControlTest, RetriesBusyAndOptionallyIdempotentTimeouts)
+{
+    CongestionControl::Options options;
+    options.maxRetries = 2;
+    CongestionControl control(4, options);
+
+    EXPECT_TRUE(control.shouldRetry(Signal::busy, 0, false));
+    EXPECT_FALSE(control.shouldRetry(Signal::timeout, 1, true));
+    EXPECT_FALSE(control.shouldRetry(Signal::busy, 2, true));
+    EXPECT_FALSE(control.shouldRetry(Signal::other, 0, true));
+    EXPECT_EQ(1u, control.stats().retries);
+
+    options.retryTimeouts = true;
+    CongestionControl timeouts(4, options);
+    EXPECT_TRUE(timeouts.shouldRetry(Signal::timeout, 0, true));
+    EXPECT_FALSE(timeouts.shouldRetry(Signal::timeout, 0, false));
+}
+
+TEST(CongestionControlTest, OnlyReadsAndStatsAreIdempotent)
+{
+    auto blobRequest = [](BlobOEMCommands command) {
+        return std::vector<std::uint8_t>{0xcf, 0xc2, 0x00,
+                                         static_cast<std::uint8_t>(command)};
+    };
+
+    for (auto command :
+         {BlobOEMCommands::bmcBlobGetCount, BlobOEMCommands::bmcBlobEnumerate,
+          BlobOEMCommands::bmcBlobRead, BlobOEMCommands::bmcBlobStat,
+          BlobOEMCommands::bmcBlobSessionStat})
+    {
+        EXPECT_TRUE(CongestionControl::idempotent(
+            ipmiOEMNetFn, ipmiOEMBlobCmd, blobRequest(command)));
+    }
+    for (auto command :
+         {BlobOEMCommands::bmcBlobOpen, BlobOEMCommands::bmcBlobWrite,
+          BlobOEMCommands::bmcBlobCommit, BlobOEMCommands::bmcBlobClose,
+          BlobOEMCommands::bmcBlobDelete, BlobOEMCommands::bmcBlobWriteMeta})
+    {
+        EXPECT_FALSE(CongestionControl::idempotent(
+            ipmiOEMNetFn, ipmiOEMBlobCmd, blobRequest(command)));
+    }
+
+    /* Nothing is known of other commands, or of a truncated header. */
+    EXPECT_FALSE(CongestionControl::idempotent(
+        0x06, 0x01, blobRequest(BlobOEMCommands::bmcBlobRead)));
+    std::vector<std::uint8_t> truncated = {0xcf, 0xc2, 0x00};
+    EXPECT_FALSE(CongestionControl::idempotent(ipmiOEMNetFn, ipmiOEMBlobCmd,
+                                               truncated));
+}
+
+TEST(CongestionControlTest, BackoffIsJitteredAndCapped)
+{
+    CongestionControl::Options options;
+    options.baseBackoff = milliseconds(10);
+    options.maxBackoff = milliseconds(100);
+    CongestionControl control(4, options);
+
+    for (int i = 0; i < 50; ++i)
+    {
+        milliseconds first = control.backoff(0);
+        EXPECT_GE(first, milliseconds(5));
+        EXPECT_LE(first, milliseconds(10));
+
+        milliseconds third = control.backoff(2);
+        EXPECT_GE(third, milliseconds(20));
+        EXPECT_LE(third, milliseconds(40));
+
+        milliseconds late = control.backoff(30);
+        EXPECT_GE(late, milliseconds(50));
+        EXPECT_LE(late, milliseconds(100));
+    }
+}
+
+} // namespace ipmiblob
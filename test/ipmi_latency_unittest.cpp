@@ -0,0 +1,118 @@
+#include <ipmiblob/blob_handler.hpp>
+#include <ipmiblob/ipmi_latency.hpp>
+#include <ipmiblob/ipmi_timing.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace ipmiblob
+{
+
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::nanoseconds;
+
+TEST(LatencyHistogramTest, BucketsByPowerOfTwo)
+{
+    LatencyHistogram histogram;
+    EXPECT_EQ(nanoseconds(0), histogram.mean());
+    EXPECT_EQ(nanoseconds(0), histogram.percentile(0.5));
+
+    histogram.record(nanoseconds(0));
+    histogram.record(nanoseconds(1));
+    histogram.record(nanoseconds(5));
+    histogram.record(nanoseconds(8));
+    EXPECT_EQ(1u, histogram.counts()[0]);
+    EXPECT_EQ(1u, histogram.counts()[1]);
+    EXPECT_EQ(1u, histogram.counts()[3]);
+    EXPECT_EQ(1u, histogram.counts()[4]);
+
+    EXPECT_EQ(4u, histogram.count());
+    EXPECT_EQ(nanoseconds(14), histogram.total());
+    EXPECT_EQ(nanoseconds(8), histogram.max());
+    EXPECT_EQ(nanoseconds(3), histogram.mean());
+
+    /* Far beyond the last bucket, which takes it anyway. */
+    histogram.record(std::chrono::hours(1));
+    EXPECT_EQ(1u, histogram.counts()[LatencyHistogram::buckets - 1]);
+    EXPECT_EQ(std::chrono::hours(1), histogram.max());
+}
+
+TEST(LatencyHistogramTest, PercentilesBoundTheDurations)
+{
+    LatencyHistogram histogram;
+    for (int i = 0; i < 99; ++i)
+    {
+        histogram.record(microseconds(100));
+    }
+    histogram.record(milliseconds(30));
+
+    /* 100us falls in the bucket up to 2^17 ns. */
+    EXPECT_EQ(nanoseconds(1 << 17), histogram.percentile(0.5));
+    EXPECT_EQ(nanoseconds(1 << 17), histogram.percentile(0.99));
+    /* Capped by the longest seen rather than the top of its bucket. */
+    EXPECT_EQ(milliseconds(30), histogram.percentile(1.0));
+}
+
+TEST(LatencyHistogramTest, MergeAddsEverything)
+{
+    LatencyHistogram a;
+    LatencyHistogram b;
+    a.record(microseconds(10));
+    b.record(microseconds(10));
+    b.record(milliseconds(1));
+
+    a.merge(b);
+    EXPECT_EQ(3u, a.count());
+    EXPECT_EQ(microseconds(1020), a.total());
+    EXPECT_EQ(milliseconds(1), a.max());
+}
+
+TEST(LatencyProfileTest, SeparatesKindsAndMergesByCommand)
+{
+    std::vector<std::uint8_t> stat = {
+        0xcf, 0xc2, 0x00,
+        static_cast<std::uint8_t>(BlobOEMCommands::bmcBlobSessionStat)};
+    std::vector<std::uint8_t> read = {
+        0xcf, 0xc2, 0x00,
+        static_cast<std::uint8_t>(BlobOEMCommands::bmcBlobRead)};
+    auto statKind =
+        AdaptiveTiming::kindOf(ipmiOEMNetFn, ipmiOEMBlobCmd, stat);
+    auto readKind =
+        AdaptiveTiming::kindOf(ipmiOEMNetFn, ipmiOEMBlobCmd, read);
+    auto otherKind = AdaptiveTiming::kindOf(6, 1, {});
+
+    LatencyProfile profile;
+    profile.recordSend(statKind, microseconds(5));
+    profile.recordReply(statKind, {microseconds(100), microseconds(3),
+                                   nanoseconds(0), microseconds(110)});
+    profile.recordSend(readKind, microseconds(6));
+    /* Read without polling, and delayed by a wrong message. */
+    profile.recordReply(readKind, {nanoseconds(0), microseconds(4),
+                                   microseconds(50), microseconds(70)});
+    profile.recordSend(otherKind, microseconds(7));
+
+    auto report = profile.byKind();
+    ASSERT_EQ(3u, report.size());
+    EXPECT_EQ(1u, report[statKind].poll.count());
+    EXPECT_EQ(0u, report[statKind].wrongMessage.count());
+    EXPECT_EQ(0u, report[readKind].poll.count());
+    EXPECT_EQ(microseconds(50), report[readKind].wrongMessage.total());
+    EXPECT_EQ(0u, report[otherKind].roundTrip.count());
+
+    auto commands = profile.byCommand();
+    ASSERT_EQ(2u, commands.size());
+    const LatencyBreakdown& blob =
+        commands[AdaptiveTiming::kindOf(ipmiOEMNetFn, ipmiOEMBlobCmd, {})];
+    EXPECT_EQ(2u, blob.send.count());
+    EXPECT_EQ(2u, blob.roundTrip.count());
+    EXPECT_EQ(microseconds(180), blob.roundTrip.total());
+
+    profile.reset();
+    EXPECT_TRUE(profile.byKind().empty());
+}
+
+} // namespace ipmiblob
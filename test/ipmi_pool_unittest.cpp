@@ -0,0 +1,210 @@
+#include "blob_reply_builder.hpp"
+
+#include <ipmiblob/blob_handler.hpp>
+#include <ipmiblob/blob_interface.hpp>
+#include <ipmiblob/blob_layout.hpp>
+#include <ipmiblob/crc.hpp>
+#include <ipmiblob/ipmi_errors.hpp>
+#include <ipmiblob/ipmi_interface.hpp>
+#include <ipmiblob/ipmi_pool.hpp>
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace ipmiblob
+{
+
+using ::testing::ElementsAre;
+
+/* A handle that holds submitted requests until told to answer them, and
+ * answers opens with the session id carried in the first byte of the id, or
+ * with a bad CRC if told to.
+ */
+class FakeHandle : public IpmiInterface
+{
+  public:
+    std::vector<std::uint8_t> sendPacket(
+        std::uint8_t, std::uint8_t, std::vector<std::uint8_t>& data) override
+    {
+        commands.push_back(data[3]);
+        return answer(data);
+    }
+
+    void submit(std::uint8_t, std::uint8_t,
+                std::span<const std::uint8_t> data,
+                IpmiCallback callback) override
+    {
+        commands.push_back(data[3]);
+        queued.push_back({{data.begin(), data.end()}, std::move(callback)});
+    }
+
+    void completeOne()
+    {
+        auto request = std::move(queued.front());
+        queued.pop_front();
+        std::vector<std::uint8_t> reply = answer(request.first);
+        request.second(std::span<const std::uint8_t>(reply));
+    }
+
+    std::vector<std::uint8_t> commands;
+    bool corrupt = false;
+
+  private:
+    std::vector<std::uint8_t> answer(
+        const std::vector<std::uint8_t>& request) const
+    {
+        using layout::ResponseHeader;
+
+        if (request[3] != static_cast<std::uint8_t>(
+                              BlobOEMCommands::bmcBlobOpen))
+        {
+            return blobReply();
+        }
+
+        std::array<std::uint8_t, layout::OpenResponse::size> session;
+        layout::OpenResponse::encode(session, request[8]);
+        std::vector<std::uint8_t> reply = blobReply(session);
+        if (corrupt)
+        {
+            ResponseHeader::crc::store(
+                reply.data(), ResponseHeader::crc::load(reply.data()) ^ 1);
+        }
+        return reply;
+    }
+
+    std::deque<std::pair<std::vector<std::uint8_t>, IpmiCallback>> queued;
+};
+
+class IpmiPoolTest : public ::testing::Test
+{
+  protected:
+    IpmiPoolTest()
+    {
+        std::vector<std::unique_ptr<IpmiInterface>> handles;
+        for (auto& handle : fakes)
+        {
+            auto fake = std::make_unique<FakeHandle>();
+            handle = fake.get();
+            handles.push_back(std::move(fake));
+        }
+        pool = std::make_unique<IpmiPool>(std::move(handles));
+    }
+
+    /* A blob request: OEN, command, CRC and the given payload. */
+    static std::vector<std::uint8_t> request(
+        BlobOEMCommands command, std::vector<std::uint8_t> payload = {})
+    {
+        using layout::RequestHeader;
+
+        std::vector<std::uint8_t> bytes(RequestHeader::size);
+        RequestHeader::encode(std::span(bytes).first<RequestHeader::size>(),
+                              layout::phosphorOen,
+                              static_cast<std::uint8_t>(command),
+                              generateCrc(payload));
+        bytes.insert(bytes.end(), payload.begin(), payload.end());
+        return bytes;
+    }
+
+    void submit(const std::vector<std::uint8_t>& data)
+    {
+        pool->submit(ipmiOEMNetFn, ipmiOEMBlobCmd, data,
+                     [](IpmiResult<std::span<const std::uint8_t>> result) {
+                         EXPECT_TRUE(result);
+                     });
+    }
+
+    static constexpr std::uint8_t open =
+        static_cast<std::uint8_t>(BlobOEMCommands::bmcBlobOpen);
+    static constexpr std::uint8_t write =
+        static_cast<std::uint8_t>(BlobOEMCommands::bmcBlobWrite);
+    static constexpr std::uint8_t count =
+        static_cast<std::uint8_t>(BlobOEMCommands::bmcBlobGetCount);
+
+    std::array<FakeHandle*, 2> fakes;
+    std::unique_ptr<IpmiPool> pool;
+};
+
+TEST(IpmiPoolCreateTest, NeedsAHandle)
+{
+    EXPECT_THROW(IpmiPool(std::vector<std::unique_ptr<IpmiInterface>>()),
+                 IpmiException);
+}
+
+TEST_F(IpmiPoolTest, SpreadsRequestsLeastLoadedFirst)
+{
+    submit(request(BlobOEMCommands::bmcBlobOpen, {0x00, 0x00, 'a', 0x00}));
+    submit(request(BlobOEMCommands::bmcBlobOpen, {0x00, 0x00, 'b', 0x00}));
+    submit(request(BlobOEMCommands::bmcBlobGetCount));
+
+    EXPECT_THAT(fakes[0]->commands, ElementsAre(open, count));
+    EXPECT_THAT(fakes[1]->commands, ElementsAre(open));
+}
+
+TEST_F(IpmiPoolTest, SessionsStickToTheirHandle)
+{
+    submit(request(BlobOEMCommands::bmcBlobOpen, {0x00, 0x00, 'a', 0x00}));
+    submit(request(BlobOEMCommands::bmcBlobOpen, {0x00, 0x00, 'b', 0x00}));
+    fakes[0]->completeOne();
+    fakes[1]->completeOne();
+
+    /* Session 'b' lives on the second handle, however busy it gets. */
+    submit(request(BlobOEMCommands::bmcBlobWrite, {'b', 0x00, 0, 0, 0, 0}));
+    submit(request(BlobOEMCommands::bmcBlobWrite, {'b', 0x00, 0, 0, 0, 0}));
+    submit(request(BlobOEMCommands::bmcBlobWrite, {'a', 0x00, 0, 0, 0, 0}));
+    EXPECT_THAT(fakes[0]->commands, ElementsAre(open, write));
+    EXPECT_THAT(fakes[1]->commands, ElementsAre(open, write, write));
+
+    /* Once closed, the session id is no longer tied to the handle. */
+    submit(request(BlobOEMCommands::bmcBlobClose, {'b', 0x00}));
+    for (int i = 0; i < 3; ++i)
+    {
+        fakes[1]->completeOne();
+    }
+    fakes[0]->completeOne();
+    submit(request(BlobOEMCommands::bmcBlobWrite, {'b', 0x00, 0, 0, 0, 0}));
+    EXPECT_THAT(fakes[0]->commands, ElementsAre(open, write, write));
+}
+
+TEST_F(IpmiPoolTest, SynchronousCallsLearnSessionsToo)
+{
+    /* Keep the first handle busy so the open goes to the second. */
+    submit(request(BlobOEMCommands::bmcBlobGetCount));
+
+    IpmiReply reply;
+    auto data = request(BlobOEMCommands::bmcBlobOpen, {0x00, 0x00, 'c', 0x00});
+    ASSERT_TRUE(
+        pool->trySendPacketInto(ipmiOEMNetFn, ipmiOEMBlobCmd, data, reply));
+
+    fakes[0]->completeOne();
+    data = request(BlobOEMCommands::bmcBlobWrite, {'c', 0x00, 0, 0, 0, 0});
+    pool->sendPacket(ipmiOEMNetFn, ipmiOEMBlobCmd, data);
+    EXPECT_THAT(fakes[1]->commands, ElementsAre(open, write));
+}
+
+TEST_F(IpmiPoolTest, SessionsAreLearnedOnlyFromValidReplies)
+{
+    submit(request(BlobOEMCommands::bmcBlobGetCount));
+
+    /* The open reaches the second handle, but its reply fails the CRC. */
+    fakes[1]->corrupt = true;
+    IpmiReply reply;
+    auto data = request(BlobOEMCommands::bmcBlobOpen, {0x00, 0x00, 'd', 0x00});
+    ASSERT_TRUE(
+        pool->trySendPacketInto(ipmiOEMNetFn, ipmiOEMBlobCmd, data, reply));
+
+    fakes[0]->completeOne();
+    data = request(BlobOEMCommands::bmcBlobWrite, {'d', 0x00, 0, 0, 0, 0});
+    pool->sendPacket(ipmiOEMNetFn, ipmiOEMBlobCmd, data);
+    EXPECT_THAT(fakes[0]->commands, ElementsAre(count, write));
+    EXPECT_THAT(fakes[1]->commands, ElementsAre(open));
+}
+
+} // namespace ipmiblob
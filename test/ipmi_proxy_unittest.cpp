@@ -0,0 +1,425 @@
+#include "blob_reply_builder.hpp"
+#include "fake_bmc.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <ipmiblob/blob_handler.hpp>
+#include <ipmiblob/ipmi_errors.hpp>
+#include <ipmiblob/ipmi_proxy.hpp>
+#include <ipmiblob/internal/shm_ring.hpp>
+#include <ipmiblob/ipmi_proxy_client.hpp>
+#include <ipmiblob/ipmi_ring_client.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace ipmiblob
+{
+
+using ::testing::ElementsAre;
+
+/* Runs a proxy in front of a fake BMC on a socket of its own. */
+class IpmiProxyTest : public ::testing::Test
+{
+  protected:
+    void start(std::unique_ptr<FakeBmc> fake,
+               const IpmiProxyServer::Options& options = {})
+    {
+        bmc = fake.get();
+        server = std::make_unique<IpmiProxyServer>(std::move(fake), options);
+        ASSERT_TRUE(server->listen(path));
+        serving = std::thread([this] { EXPECT_TRUE(server->run()); });
+    }
+
+    ~IpmiProxyTest()
+    {
+        if (server)
+        {
+            server->stop();
+            serving.join();
+        }
+    }
+
+    const std::string path = ::testing::TempDir() + "ipmi_proxy_" +
+                             std::to_string(::getpid()) + ".sock";
+    FakeBmc* bmc = nullptr;
+    std::unique_ptr<IpmiProxyServer> server;
+    std::thread serving;
+};
+
+TEST_F(IpmiProxyTest, RepliesAndFailuresReachTheClient)
+{
+    start(std::make_unique<FakeBmc>(
+        [](std::uint8_t, std::uint8_t cmd, std::span<const std::uint8_t> data)
+            -> IpmiResult<std::vector<std::uint8_t>> {
+            if (cmd == 1)
+            {
+                return std::unexpected(IpmiError{0xc0, nullptr});
+            }
+            return std::vector<std::uint8_t>(data.begin(), data.end());
+        }));
+
+    IpmiProxyClient client(path);
+    std::vector<std::uint8_t> request = {1, 2, 3};
+    EXPECT_THAT(client.sendPacket(6, 0, request), ElementsAre(1, 2, 3));
+
+    IpmiReply reply;
+    auto failed = client.trySendPacketInto(6, 1, request, reply);
+    ASSERT_FALSE(failed);
+    EXPECT_EQ(0xc0, failed.error().code);
+}
+
+TEST_F(IpmiProxyTest, BlobHandlerSwitchesToTheProxy)
+{
+    /* Answers bmcBlobGetCount with a count of 7. */
+    start(std::make_unique<FakeBmc>(
+        [](std::uint8_t, std::uint8_t, std::span<const std::uint8_t>)
+            -> IpmiResult<std::vector<std::uint8_t>> {
+            std::vector<std::uint8_t> count = {7, 0, 0, 0};
+            return blobReply(count);
+        }));
+
+    BlobHandler blob(IpmiProxyClient::CreateIpmiProxyClient(path));
+    EXPECT_EQ(7, blob.getBlobCount());
+}
+
+TEST_F(IpmiProxyTest, ClientsArePipelinedAndServedInTurn)
+{
+    std::mutex orderMutex;
+    std::vector<std::uint8_t> order;
+    IpmiProxyServer::Options options;
+    options.window = 1;
+    start(std::make_unique<FakeBmc>(
+              [&](std::uint8_t netfn, std::uint8_t,
+                  std::span<const std::uint8_t> data)
+                  -> IpmiResult<std::vector<std::uint8_t>> {
+                  std::lock_guard lock(orderMutex);
+                  order.push_back(netfn);
+                  return std::vector<std::uint8_t>(data.begin(), data.end());
+              },
+              std::chrono::milliseconds(5)),
+          options);
+
+    /* The first client queues a burst before the second asks for anything;
+     * the second is still served next rather than after the whole burst.
+     */
+    IpmiProxyClient busy(path);
+    IpmiProxyClient quiet(path);
+    int answered = 0;
+    auto count = [&answered](IpmiResult<std::span<const std::uint8_t>> r) {
+        EXPECT_TRUE(r);
+        ++answered;
+    };
+    for (int i = 0; i < 8; ++i)
+    {
+        busy.submit(1, 0, {}, count);
+    }
+    quiet.submit(2, 0, {}, count);
+    std::vector<std::uint8_t> none;
+    quiet.sendPacket(2, 0, none);
+    busy.sendPacket(1, 0, none);
+
+    EXPECT_EQ(9, answered);
+    std::lock_guard lock(orderMutex);
+    ASSERT_EQ(11u, order.size());
+    auto firstQuiet = std::find(order.begin(), order.end(), 2);
+    EXPECT_LE(firstQuiet - order.begin(), 2);
+    EXPECT_EQ(2, std::count(order.begin(), order.begin() + 5, 2));
+}
+
+TEST_F(IpmiProxyTest, RequestsArePipelinedToTheBmc)
+{
+    start(std::make_unique<FakeBmc>(FakeBmc::echo,
+                                    std::chrono::milliseconds(2)));
+
+    IpmiProxyClient client(path);
+    int answered = 0;
+    for (std::uint8_t i = 0; i < 8; ++i)
+    {
+        std::vector<std::uint8_t> request = {i};
+        client.submit(0, 0, request,
+                      [&answered, i](auto r) {
+                          ASSERT_TRUE(r);
+                          EXPECT_THAT(*r, ElementsAre(i));
+                          ++answered;
+                      });
+    }
+    std::vector<std::uint8_t> last = {8};
+    EXPECT_THAT(client.sendPacket(0, 0, last), ElementsAre(8));
+
+    EXPECT_EQ(8, answered);
+    EXPECT_GT(bmc->peakQueued(), 1u);
+}
+
+TEST_F(IpmiProxyTest, ClientThatLeavesDoesNotDisturbOthers)
+{
+    start(std::make_unique<FakeBmc>(FakeBmc::echo,
+                                    std::chrono::milliseconds(2)));
+
+    {
+        IpmiProxyClient leaving(path);
+        for (int i = 0; i < 4; ++i)
+        {
+            leaving.submit(0, 0, {}, [](auto) {});
+        }
+    }
+
+    IpmiProxyClient staying(path);
+    std::vector<std::uint8_t> request = {9};
+    EXPECT_THAT(staying.sendPacket(0, 0, request), ElementsAre(9));
+}
+
+TEST_F(IpmiProxyTest, ClientThatStopsReadingIsStoppedFromSending)
+{
+    std::atomic<std::size_t> answered = 0;
+    start(std::make_unique<FakeBmc>(
+        [&answered](std::uint8_t, std::uint8_t,
+                    std::span<const std::uint8_t> data)
+            -> IpmiResult<std::vector<std::uint8_t>> {
+            ++answered;
+            return std::vector<std::uint8_t>(data.begin(), data.end());
+        }));
+
+    /* Sends until the proxy stops reading, without reading any replies. */
+    auto connected = proxy::connectTo(path);
+    ASSERT_TRUE(connected);
+    int fd = *connected;
+    constexpr std::uint32_t asked = 20000;
+    std::array<std::uint8_t, proxy::RequestFrame::size> frame;
+    std::uint32_t sent = 0;
+    while (sent < asked)
+    {
+        proxy::RequestFrame::encode(frame, sent, 0, 0);
+        if (::send(fd, frame.data(), frame.size(), MSG_DONTWAIT) ==
+            static_cast<ssize_t>(frame.size()))
+        {
+            sent++;
+            continue;
+        }
+        ASSERT_EQ(EAGAIN, errno);
+        pollfd writable{fd, POLLOUT, 0};
+        if (::poll(&writable, 1, 200) == 0)
+        {
+            break;
+        }
+    }
+    EXPECT_LT(sent, asked);
+    EXPECT_LT(answered.load(), asked);
+
+    /* Once it reads again, every request is answered, in order. */
+    std::array<std::uint8_t, proxy::maxFrame> reply;
+    for (std::uint32_t i = 0; i < sent; ++i)
+    {
+        ASSERT_GE(::recv(fd, reply.data(), reply.size(), 0),
+                  static_cast<ssize_t>(proxy::ReplyFrame::size));
+        EXPECT_EQ(i, proxy::ReplyFrame::id::load(reply.data()));
+    }
+    ::close(fd);
+}
+
+TEST_F(IpmiProxyTest, LostProxyFailsWaitersAndIsReconnected)
+{
+    start(std::make_unique<FakeBmc>(FakeBmc::echo,
+                                    std::chrono::milliseconds(50)));
+
+    IpmiProxyClient client(path);
+    std::vector<IpmiResult<std::span<const std::uint8_t>>> outcomes;
+    for (int i = 0; i < 2; ++i)
+    {
+        client.submit(0, 0, {}, [&outcomes](auto r) {
+            outcomes.push_back(std::move(r));
+        });
+    }
+
+    /* The proxy goes away with both requests unanswered. */
+    server->stop();
+    serving.join();
+    server.reset();
+
+    std::vector<std::uint8_t> request = {5};
+    IpmiReply reply;
+    EXPECT_FALSE(client.trySendPacketInto(0, 0, request, reply));
+    ASSERT_EQ(2u, outcomes.size());
+    EXPECT_FALSE(outcomes[0]);
+    EXPECT_FALSE(outcomes[1]);
+
+    start(std::make_unique<FakeBmc>());
+    EXPECT_THAT(client.sendPacket(0, 0, request), ElementsAre(5));
+}
+
+TEST_F(IpmiProxyTest, RingClientRoundTripsThroughSharedMemory)
+{
+    start(std::make_unique<FakeBmc>(
+        [](std::uint8_t, std::uint8_t cmd, std::span<const std::uint8_t> data)
+            -> IpmiResult<std::vector<std::uint8_t>> {
+            if (cmd == 1)
+            {
+                return std::unexpected(IpmiError{0xc3, nullptr});
+            }
+            return std::vector<std::uint8_t>(data.begin(), data.end());
+        }));
+
+    IpmiRingClient client(path);
+    std::vector<std::uint8_t> request(200, 0x5a);
+    EXPECT_EQ(request, client.sendPacket(6, 0, request));
+
+    IpmiReply reply;
+    auto failed = client.trySendPacketInto(6, 1, request, reply);
+    ASSERT_FALSE(failed);
+    EXPECT_EQ(0xc3, failed.error().code);
+
+    /* Socket and ring clients share the proxy. */
+    IpmiProxyClient other(path);
+    EXPECT_EQ(request, other.sendPacket(6, 0, request));
+}
+
+TEST_F(IpmiProxyTest, RingClientPipelinesBeyondTheRing)
+{
+    start(std::make_unique<FakeBmc>());
+
+    /* More requests than the ring holds: submit() waits for room, taking
+     * replies as they come back.
+     */
+    IpmiRingClient client(path);
+    std::vector<int> answered;
+    constexpr int count = 3 * internal::ShmRing::slots;
+    for (int i = 0; i < count; ++i)
+    {
+        std::vector<std::uint8_t> request = {static_cast<std::uint8_t>(i)};
+        client.submit(0, 0, request, [&answered](auto r) {
+            ASSERT_TRUE(r);
+            ASSERT_EQ(1u, r->size());
+            answered.push_back((*r)[0]);
+        });
+    }
+    std::vector<std::uint8_t> none;
+    client.sendPacket(0, 0, none);
+
+    ASSERT_EQ(static_cast<std::size_t>(count), answered.size());
+    for (int i = 0; i < count; ++i)
+    {
+        EXPECT_EQ(i % 256, answered[i]);
+    }
+}
+
+TEST_F(IpmiProxyTest, RingClientFailsWaitersOfALostProxyAndReconnects)
+{
+    start(std::make_unique<FakeBmc>(FakeBmc::echo,
+                                    std::chrono::milliseconds(50)));
+
+    IpmiRingClient client(path);
+    std::vector<IpmiResult<std::span<const std::uint8_t>>> outcomes;
+    for (int i = 0; i < 2; ++i)
+    {
+        client.submit(0, 0, {}, [&outcomes](auto r) {
+            outcomes.push_back(std::move(r));
+        });
+    }
+    auto watched = client.tryGetFd();
+    ASSERT_TRUE(watched);
+
+    /* The proxy goes away with both requests unanswered; an event loop
+     * watching the client is woken for it.
+     */
+    server->stop();
+    serving.join();
+    server.reset();
+
+    pollfd readable{*watched, POLLIN, 0};
+    ASSERT_EQ(1, ::poll(&readable, 1, 1000));
+    EXPECT_FALSE(client.processReadable());
+    ASSERT_EQ(2u, outcomes.size());
+    EXPECT_FALSE(outcomes[0]);
+    EXPECT_FALSE(outcomes[1]);
+
+    start(std::make_unique<FakeBmc>());
+    std::vector<std::uint8_t> request = {5};
+    EXPECT_THAT(client.sendPacket(0, 0, request), ElementsAre(5));
+    EXPECT_EQ(*watched, *client.tryGetFd());
+}
+
+TEST(ShmRingTest, WakesOnlyWhenTheOtherSideMaySleep)
+{
+    auto shared = std::make_unique<internal::ShmRing::Shared>();
+    internal::ShmRing ring(shared.get());
+    EXPECT_TRUE(ring.front().empty());
+
+    /* The first frame finds the consumer caught up; the next does not. */
+    std::span<std::uint8_t> slot = ring.reserve();
+    ASSERT_FALSE(slot.empty());
+    slot[0] = 7;
+    EXPECT_TRUE(ring.publish(1));
+    ASSERT_FALSE(ring.reserve().empty());
+    EXPECT_FALSE(ring.publish(1));
+
+    EXPECT_THAT(ring.front(), ElementsAre(7));
+    EXPECT_FALSE(ring.pop());
+    EXPECT_FALSE(ring.pop());
+    EXPECT_TRUE(ring.front().empty());
+
+    /* Taking from a full ring wakes the producer. */
+    for (std::uint32_t i = 0; i < internal::ShmRing::slots; ++i)
+    {
+        ASSERT_FALSE(ring.reserve().empty());
+        ring.publish(1);
+    }
+    EXPECT_TRUE(ring.reserve().empty());
+    EXPECT_TRUE(ring.pop());
+    EXPECT_FALSE(ring.pop());
+}
+
+TEST(ShmChannelTest, AttachTakesOnlySealedMemoryAndEventfds)
+{
+    std::unique_ptr<internal::ShmChannel> created =
+        internal::ShmChannel::create();
+    ASSERT_TRUE(created);
+    /* The client cannot shrink the memory once the proxy maps it. */
+    EXPECT_LT(::ftruncate(created->memFd, 0), 0);
+
+    std::unique_ptr<internal::ShmChannel> attached =
+        internal::ShmChannel::attach(::dup(created->memFd),
+                                     ::dup(created->serverBell),
+                                     ::dup(created->clientBell));
+    ASSERT_TRUE(attached);
+    EXPECT_TRUE(::fcntl(attached->clientBell, F_GETFL) & O_NONBLOCK);
+
+    /* Memory of the right size, but not sealed. */
+    int unsealed = ::memfd_create("unsealed", MFD_CLOEXEC);
+    ASSERT_GE(unsealed, 0);
+    ASSERT_EQ(0, ::ftruncate(unsealed, 2 * sizeof(internal::ShmRing::Shared)));
+    EXPECT_FALSE(internal::ShmChannel::attach(
+        unsealed, ::dup(created->serverBell), ::dup(created->clientBell)));
+
+    /* A pipe for a doorbell, which could block the proxy. */
+    int pipeFds[2];
+    ASSERT_EQ(0, ::pipe(pipeFds));
+    EXPECT_FALSE(internal::ShmChannel::attach(
+        ::dup(created->memFd), ::dup(created->serverBell), pipeFds[1]));
+    ::close(pipeFds[0]);
+}
+
+TEST(IpmiProxyClientTest, ReportsMissingServer)
+{
+    IpmiProxyClient client(::testing::TempDir() + "no_such_proxy.sock");
+    std::vector<std::uint8_t> request;
+    EXPECT_THROW(client.sendPacket(0, 0, request), IpmiException);
+}
+
+} // namespace ipmiblob
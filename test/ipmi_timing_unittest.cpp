@@ -0,0 +1,148 @@
+#include <ipmiblob/blob_handler.hpp>
+#include <ipmiblob/blob_interface.hpp>
+#include <ipmiblob/ipmi_timing.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace ipmiblob
+{
+
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+AdaptiveTiming::Kind blobKind(BlobOEMCommands command)
+{
+    std::vector<std::uint8_t> request = {0xcf, 0xc2, 0x00,
+                                         static_cast<std::uint8_t>(command)};
+    return AdaptiveTiming::kindOf(ipmiOEMNetFn, ipmiOEMBlobCmd, request);
+}
+
+TEST(IpmiTimingTest, PollTimeoutCoversEveryAttempt)
+{
+    IpmiTiming timing{2, 1000};
+    EXPECT_GE(timing.pollTimeoutMs(), 3000);
+    EXPECT_LT(timing.pollTimeoutMs(), 4000);
+
+    IpmiTiming huge{1000, 4000000000u};
+    EXPECT_GT(huge.pollTimeoutMs(), 0);
+}
+
+TEST(AdaptiveTimingTest, UnsampledKindsWaitNoLongerThanWithoutTiming)
+{
+    AdaptiveTiming timing;
+    auto commit = blobKind(BlobOEMCommands::bmcBlobCommit);
+    int waited = timing.timingFor(commit).pollTimeoutMs();
+    EXPECT_GE(waited, 15000);
+    EXPECT_LT(waited, 16000);
+}
+
+TEST(AdaptiveTimingTest, BlobSubcommandsAreTrackedApart)
+{
+    EXPECT_NE(blobKind(BlobOEMCommands::bmcBlobCommit),
+              blobKind(BlobOEMCommands::bmcBlobSessionStat));
+
+    std::vector<std::uint8_t> other = {0x01, 0x02, 0x03, 0x04};
+    EXPECT_EQ(AdaptiveTiming::kindOf(6, 1, {}),
+              AdaptiveTiming::kindOf(6, 1, other));
+}
+
+TEST(AdaptiveTimingTest, UsesLongestBudgetUntilSampled)
+{
+    AdaptiveTiming::Options options;
+    options.maxRetryTimeMs = 5000;
+    options.minSamples = 4;
+    AdaptiveTiming timing(options);
+
+    auto stat = blobKind(BlobOEMCommands::bmcBlobSessionStat);
+    for (int i = 0; i < 3; ++i)
+    {
+        timing.record(stat, milliseconds(2));
+        EXPECT_EQ(IpmiTiming({options.retries, 5000}), timing.timingFor(stat));
+    }
+
+    timing.record(stat, milliseconds(2));
+    EXPECT_EQ(IpmiTiming({options.retries, options.minRetryTimeMs}),
+              timing.timingFor(stat));
+}
+
+TEST(AdaptiveTimingTest, FastCommandsFailFastSlowOnesKeepTheirBudget)
+{
+    AdaptiveTiming::Options options;
+    options.factor = 2.0;
+    options.minRetryTimeMs = 10;
+    options.maxRetryTimeMs = 20000;
+    AdaptiveTiming timing(options);
+
+    auto stat = blobKind(BlobOEMCommands::bmcBlobSessionStat);
+    auto commit = blobKind(BlobOEMCommands::bmcBlobCommit);
+    for (int i = 0; i < 100; ++i)
+    {
+        /* One slow outlier among the stats sits above the p99. */
+        timing.record(stat, i == 50 ? milliseconds(900) : milliseconds(20));
+        timing.record(commit, milliseconds(3000 + i));
+    }
+
+    EXPECT_EQ(40u, timing.timingFor(stat).retryTimeMs);
+    EXPECT_EQ(2 * 3098u, timing.timingFor(commit).retryTimeMs);
+}
+
+TEST(AdaptiveTimingTest, BudgetIsBounded)
+{
+    AdaptiveTiming::Options options;
+    options.minSamples = 1;
+    AdaptiveTiming timing(options);
+
+    timing.record(1, microseconds(1));
+    EXPECT_EQ(options.minRetryTimeMs, timing.timingFor(1).retryTimeMs);
+
+    timing.record(2, std::chrono::hours(1));
+    EXPECT_EQ(options.maxRetryTimeMs, timing.timingFor(2).retryTimeMs);
+}
+
+TEST(AdaptiveTimingTest, TimeoutsBackOffUntilASlowBmcIsSampled)
+{
+    AdaptiveTiming::Options options;
+    options.factor = 2.0;
+    options.minRetryTimeMs = 10;
+    options.maxRetryTimeMs = 5000;
+    options.minSamples = 4;
+    AdaptiveTiming timing(options);
+
+    auto stat = blobKind(BlobOEMCommands::bmcBlobSessionStat);
+    for (int i = 0; i < 100; ++i)
+    {
+        timing.record(stat, milliseconds(20));
+    }
+    ASSERT_EQ(40u, timing.timingFor(stat).retryTimeMs);
+
+    /* The BMC now takes 500ms.  Each timeout backs the budget off, and once
+     * two are in the history the p99 covers them.
+     */
+    timing.recordTimeout(stat, milliseconds(80));
+    EXPECT_EQ(80u, timing.timingFor(stat).retryTimeMs);
+    timing.recordTimeout(stat, milliseconds(160));
+    EXPECT_EQ(320u, timing.timingFor(stat).retryTimeMs);
+    timing.recordTimeout(stat, milliseconds(640));
+    EXPECT_EQ(2 * 2 * 160u, timing.timingFor(stat).retryTimeMs);
+
+    /* Late replies now come in time, and keep the budget long. */
+    timing.record(stat, milliseconds(500));
+    EXPECT_EQ(2 * 500u, timing.timingFor(stat).retryTimeMs);
+}
+
+TEST(AdaptiveTimingTest, TimeoutsBackOffNoFurtherThanTheLongest)
+{
+    AdaptiveTiming::Options options;
+    options.minSamples = 1;
+    AdaptiveTiming timing(options);
+
+    timing.record(1, std::chrono::hours(1));
+    timing.recordTimeout(1, std::chrono::hours(1));
+    EXPECT_EQ(options.maxRetryTimeMs, timing.timingFor(1).retryTimeMs);
+}
+
+} // namespace ipmiblob
@@ -0,0 +1,118 @@
+/* Compares the round trip through the proxy over its socket with the one
+ * through a shared-memory channel, against a fake BMC that answers at once,
+ * so that only the transport is measured.  Runs on any Linux machine.
+ */
+
+#include "fake_bmc.hpp"
+
+#include <unistd.h>
+
+#include <ipmiblob/ipmi_interface.hpp>
+#include <ipmiblob/ipmi_proxy.hpp>
+#include <ipmiblob/ipmi_proxy_client.hpp>
+#include <ipmiblob/ipmi_ring_client.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using ipmiblob::IpmiInterface;
+using ipmiblob::IpmiReply;
+using Clock = std::chrono::steady_clock;
+
+constexpr int roundTrips = 20000;
+constexpr int batch = 32;
+
+double nanosecondsPer(Clock::duration elapsed, int count)
+{
+    return std::chrono::duration<double, std::nano>(elapsed).count() / count;
+}
+
+/* One request at a time, as a blob read or write loop makes them. */
+double synchronous(IpmiInterface& ipmi, std::size_t size)
+{
+    std::vector<std::uint8_t> request(size, 0xa5);
+    IpmiReply reply;
+    auto start = Clock::now();
+    for (int i = 0; i < roundTrips; ++i)
+    {
+        if (!ipmi.trySendPacketInto(0x2e, 0x80, request, reply))
+        {
+            std::fprintf(stderr, "request failed\n");
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    return nanosecondsPer(Clock::now() - start, roundTrips);
+}
+
+/* Batches of submit() requests, each closed by a synchronous one. */
+double pipelined(IpmiInterface& ipmi, std::size_t size)
+{
+    std::vector<std::uint8_t> request(size, 0xa5);
+    IpmiReply reply;
+    int answered = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < roundTrips; i += batch)
+    {
+        for (int j = 1; j < batch; ++j)
+        {
+            ipmi.submit(0x2e, 0x80, request,
+                        [&answered](auto r) { answered += r ? 1 : 0; });
+        }
+        if (ipmi.trySendPacketInto(0x2e, 0x80, request, reply))
+        {
+            ++answered;
+        }
+    }
+    auto elapsed = Clock::now() - start;
+
+    if (answered != roundTrips / batch * batch)
+    {
+        std::fprintf(stderr, "requests failed\n");
+        std::exit(EXIT_FAILURE);
+    }
+    return nanosecondsPer(elapsed, answered);
+}
+
+} // namespace
+
+int main()
+{
+    std::string path = "/tmp/ipmi_transport_benchmark_" +
+                       std::to_string(::getpid()) + ".sock";
+    ipmiblob::IpmiProxyServer::Options options;
+    options.window = batch;
+    ipmiblob::IpmiProxyServer server(std::make_unique<ipmiblob::FakeBmc>(),
+                                     options);
+    if (!server.listen(path))
+    {
+        std::fprintf(stderr, "cannot listen on %s\n", path.c_str());
+        return EXIT_FAILURE;
+    }
+    std::thread serving([&server] { server.run(); });
+
+    ipmiblob::IpmiProxyClient socket(path);
+    ipmiblob::IpmiRingClient ring(path);
+    std::printf("%-10s %6s %16s %16s\n", "transport", "bytes",
+                "sync ns/op", "pipelined ns/op");
+    for (std::size_t size : {8u, 64u, 250u})
+    {
+        std::printf("%-10s %6zu %16.0f %16.0f\n", "socket", size,
+                    synchronous(socket, size), pipelined(socket, size));
+        std::printf("%-10s %6zu %16.0f %16.0f\n", "shm-ring", size,
+                    synchronous(ring, size), pipelined(ring, size));
+    }
+
+    server.stop();
+    serving.join();
+    return EXIT_SUCCESS;
+}
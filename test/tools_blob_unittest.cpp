@@ -1,26 +1,42 @@
+#include "internal_sys_mock.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <ipmiblob/blob_errors.hpp>
 #include <ipmiblob/blob_handler.hpp>
 #include <ipmiblob/test/crc_mock.hpp>
 #include <ipmiblob/test/ipmi_interface_mock.hpp>
 
+#include <array>
 #include <cstdint>
 #include <memory>
+#include <numeric>
+#include <span>
 #include <vector>
 
+#include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
 namespace ipmiblob
 {
 CrcInterface* crcIntf = nullptr;
 
-std::uint16_t generateCrc(const std::vector<std::uint8_t>& data)
+std::uint16_t generateCrc(std::span<const std::uint8_t> data)
 {
-    return (crcIntf) ? crcIntf->generateCrc(data) : 0x00;
+    return (crcIntf) ? crcIntf->generateCrc(
+                           std::vector<std::uint8_t>(data.begin(), data.end()))
+                     : 0x00;
 }
 
+using ::testing::_;
 using ::testing::ContainerEq;
+using ::testing::ElementsAre;
 using ::testing::Eq;
 using ::testing::Return;
+using ::testing::StrEq;
+using ::testing::Throw;
 
 class BlobHandlerTest : public ::testing::Test
 {
@@ -505,6 +521,83 @@ TEST_F(BlobHandlerTest, writeBytesSucceeds)
     blob.writeBytes(0x0001, 0, bytes);
 }
 
+TEST_F(BlobHandlerTest, tryWriteBytesReportsCompletionCode)
+{
+    /* A busy BMC is reported by value, with its completion code. */
+    auto ipmi = CreateIpmiMock();
+    IpmiInterfaceMock* ipmiMock =
+        reinterpret_cast<IpmiInterfaceMock*>(ipmi.get());
+    BlobHandler blob(std::move(ipmi));
+
+    std::vector<std::uint8_t> bytes = {'a', 'b', 'c', 'd'};
+    EXPECT_CALL(crcMock, generateCrc(_)).WillRepeatedly(Return(0x00));
+    EXPECT_CALL(*ipmiMock, sendPacket(ipmiOEMNetFn, ipmiOEMBlobCmd, _))
+        .WillRepeatedly(Throw(IpmiException(0xc0)));
+
+    auto written = blob.tryWriteBytes(0x0001, 0, bytes);
+    ASSERT_FALSE(written);
+    EXPECT_EQ(0xc0, written.error().code);
+
+    /* The throwing API keeps both the message and the code. */
+    try
+    {
+        blob.writeBytes(0x0001, 0, bytes);
+        ADD_FAILURE() << "writeBytes did not throw";
+    }
+    catch (const BlobException& e)
+    {
+        EXPECT_STREQ("Received IPMI_CC: busy", e.what());
+        EXPECT_EQ(0xc0, e.code());
+    }
+}
+
+TEST_F(BlobHandlerTest, tryOpenBlobReportsShortReply)
+{
+    auto ipmi = CreateIpmiMock();
+    IpmiInterfaceMock* ipmiMock =
+        reinterpret_cast<IpmiInterfaceMock*>(ipmi.get());
+    BlobHandler blob(std::move(ipmi));
+
+    std::vector<std::uint8_t> resp = {0xcf, 0xc2, 0x00, 0x00, 0x00, 0xfe};
+    EXPECT_CALL(crcMock, generateCrc(_)).WillRepeatedly(Return(0x00));
+    EXPECT_CALL(*ipmiMock, sendPacket(ipmiOEMNetFn, ipmiOEMBlobCmd, _))
+        .WillOnce(Return(resp));
+
+    auto session = blob.tryOpenBlob("abcd", 0);
+    ASSERT_FALSE(session);
+    EXPECT_EQ(0, session.error().code);
+    EXPECT_STREQ("Did not receive session.", session.error().reason);
+}
+
+TEST_F(BlobHandlerTest, openBlobAsyncCompletes)
+{
+    /* Against a transport without its own event loop, the callback runs
+     * before the call returns.
+     */
+    auto ipmi = CreateIpmiMock();
+    IpmiInterfaceMock* ipmiMock =
+        reinterpret_cast<IpmiInterfaceMock*>(ipmi.get());
+    BlobHandler blob(std::move(ipmi));
+
+    std::vector<std::uint8_t> request = {
+        0xcf, 0xc2, 0x00,
+        static_cast<std::uint8_t>(BlobOEMCommands::bmcBlobOpen),
+        0x00, 0x00, 0x02, 0x04,
+        'a',  'b',  'c',  'd',
+        0x00};
+    std::vector<std::uint8_t> resp = {0xcf, 0xc2, 0x00, 0x00, 0x00, 0xfe, 0xed};
+    EXPECT_CALL(crcMock, generateCrc(_)).WillRepeatedly(Return(0x00));
+    EXPECT_CALL(*ipmiMock,
+                sendPacket(ipmiOEMNetFn, ipmiOEMBlobCmd, ContainerEq(request)))
+        .WillOnce(Return(resp));
+
+    BlobResult<std::uint16_t> session = std::unexpected("not called");
+    blob.openBlobAsync("abcd", 0x0402,
+                       [&](BlobResult<std::uint16_t> r) { session = r; });
+    ASSERT_TRUE(session);
+    EXPECT_EQ(0xedfe, *session);
+}
+
 TEST_F(BlobHandlerTest, readBytesSucceeds)
 {
     /* The reading of bytes succeeds. */
@@ -542,6 +635,75 @@ TEST_F(BlobHandlerTest, readBytesSucceeds)
     EXPECT_EQ(blob.readBytes(0x0001, 0, 4), expectedBytes);
 }
 
+TEST_F(BlobHandlerTest, writeBytesFromSpanSucceeds)
+{
+    /* Writing a slice of a larger buffer sends just that slice. */
+    auto ipmi = CreateIpmiMock();
+    IpmiInterfaceMock* ipmiMock =
+        reinterpret_cast<IpmiInterfaceMock*>(ipmi.get());
+    BlobHandler blob(std::move(ipmi));
+
+    std::vector<std::uint8_t> request = {
+        0xcf, 0xc2,
+        0x00, static_cast<std::uint8_t>(BlobOEMCommands::bmcBlobWrite),
+        0x00, 0x00,
+        0x01, 0x00,
+        0x04, 0x00,
+        0x00, 0x00,
+        'b',  'c'};
+
+    std::vector<std::uint8_t> image = {'a', 'b', 'c', 'd'};
+    std::vector<std::uint8_t> resp = {0xcf, 0xc2, 0x00};
+    std::vector<std::uint8_t> reqCrc = {0x01, 0x00, 0x04, 0x00,
+                                        0x00, 0x00, 'b',  'c'};
+    EXPECT_CALL(crcMock, generateCrc(ContainerEq(reqCrc)))
+        .WillOnce(Return(0x00));
+
+    EXPECT_CALL(*ipmiMock,
+                sendPacket(ipmiOEMNetFn, ipmiOEMBlobCmd, ContainerEq(request)))
+        .WillOnce(Return(resp));
+
+    blob.writeBytes(0x0001, 4, std::span(image).subspan(1, 2));
+}
+
+TEST_F(BlobHandlerTest, readBytesIntoSpanSucceeds)
+{
+    /* The read asks for the size of the buffer and fills it in. */
+    auto ipmi = CreateIpmiMock();
+    IpmiInterfaceMock* ipmiMock =
+        reinterpret_cast<IpmiInterfaceMock*>(ipmi.get());
+    BlobHandler blob(std::move(ipmi));
+
+    std::vector<std::uint8_t> request = {
+        0xcf, 0xc2,
+        0x00, static_cast<std::uint8_t>(BlobOEMCommands::bmcBlobRead),
+        0x00, 0x00,
+        0x01, 0x00,
+        0x00, 0x00,
+        0x00, 0x00,
+        0x08, 0x00,
+        0x00, 0x00};
+
+    std::vector<std::uint8_t> resp = {0xcf, 0xc2, 0x00, 0x00, 0x00,
+                                      'a',  'b',  'c'};
+    std::vector<std::uint8_t> reqCrc = {0x01, 0x00, 0x00, 0x00, 0x00,
+                                        0x00, 0x08, 0x00, 0x00, 0x00};
+    std::vector<std::uint8_t> respCrc = {'a', 'b', 'c'};
+
+    EXPECT_CALL(crcMock, generateCrc(ContainerEq(reqCrc)))
+        .WillOnce(Return(0x00));
+    EXPECT_CALL(crcMock, generateCrc(ContainerEq(respCrc)))
+        .WillOnce(Return(0x00));
+
+    EXPECT_CALL(*ipmiMock,
+                sendPacket(ipmiOEMNetFn, ipmiOEMBlobCmd, ContainerEq(request)))
+        .WillOnce(Return(resp));
+
+    std::array<std::uint8_t, 8> out = {};
+    EXPECT_EQ(3, blob.readBytes(0x0001, 0, out));
+    EXPECT_THAT(out, ElementsAre('a', 'b', 'c', 0, 0, 0, 0, 0));
+}
+
 TEST_F(BlobHandlerTest, deleteBlobSucceeds)
 {
     /* The delete succeeds. */
@@ -570,4 +732,254 @@ TEST_F(BlobHandlerTest, deleteBlobSucceeds)
     EXPECT_TRUE(blob.deleteBlob("abcd"));
 }
 
+TEST_F(BlobHandlerTest, uploadFileFramesChunksFromTheMapping)
+{
+    /* Three chunks: two full ones and the rest, each cut straight from the
+     * mapped file, with the pages behind dropped as they are sent.
+     */
+    auto ipmi = CreateIpmiMock();
+    IpmiInterfaceMock* ipmiMock =
+        reinterpret_cast<IpmiInterfaceMock*>(ipmi.get());
+    auto sys = std::make_unique<internal::InternalSysMock>();
+    internal::InternalSysMock* sysMock = sys.get();
+    BlobHandler blob(std::move(ipmi), std::move(sys));
+
+    std::vector<std::uint8_t> image(600);
+    std::iota(image.begin(), image.end(), 0);
+    void* mapped = image.data();
+
+    EXPECT_CALL(*sysMock, open(StrEq("/tmp/image.bin"), O_RDONLY | O_CLOEXEC))
+        .WillOnce(Return(5));
+    EXPECT_CALL(*sysMock, fstat(5, _)).WillOnce([](int, struct stat* info) {
+        info->st_size = 600;
+        return 0;
+    });
+    EXPECT_CALL(*sysMock, mmap(nullptr, 600, PROT_READ, MAP_PRIVATE, 5, 0))
+        .WillOnce(Return(mapped));
+    EXPECT_CALL(*sysMock, close(5)).WillOnce(Return(0));
+    EXPECT_CALL(*sysMock, madvise(mapped, 600, MADV_SEQUENTIAL))
+        .WillOnce(Return(0));
+    /* A one byte page makes the 256 page release window 256 bytes. */
+    EXPECT_CALL(*sysMock, getpagesize()).WillOnce(Return(1));
+    EXPECT_CALL(*sysMock, madvise(mapped, 260, MADV_DONTNEED))
+        .WillOnce(Return(0));
+    EXPECT_CALL(*sysMock, madvise(image.data() + 260, 260, MADV_DONTNEED))
+        .WillOnce(Return(0));
+    EXPECT_CALL(*sysMock, munmap(mapped, 600)).WillOnce(Return(0));
+
+    EXPECT_CALL(crcMock, generateCrc(_)).WillRepeatedly(Return(0x00));
+    std::vector<std::vector<std::uint8_t>> requests;
+    EXPECT_CALL(*ipmiMock, sendPacket(ipmiOEMNetFn, ipmiOEMBlobCmd, _))
+        .Times(3)
+        .WillRepeatedly([&](std::uint8_t, std::uint8_t,
+                            std::vector<std::uint8_t>& data) {
+            requests.push_back(data);
+            return std::vector<std::uint8_t>{0xcf, 0xc2, 0x00};
+        });
+
+    EXPECT_EQ(600u, blob.uploadFile(1, "/tmp/image.bin"));
+
+    ASSERT_EQ(3u, requests.size());
+    std::size_t offset = 0;
+    for (const auto& request : requests)
+    {
+        /* Header, session and offset, then the chunk. */
+        ASSERT_GT(request.size(), 12u);
+        EXPECT_EQ(static_cast<std::uint8_t>(BlobOEMCommands::bmcBlobWrite),
+                  request[3]);
+        EXPECT_EQ(offset, std::size_t{request[8]} | (request[9] << 8));
+        EXPECT_TRUE(std::equal(request.begin() + 12, request.end(),
+                               image.begin() + offset));
+        offset += request.size() - 12;
+    }
+    EXPECT_EQ(600u, offset);
+    EXPECT_EQ(272u, requests[0].size());
+}
+
+TEST_F(BlobHandlerTest, uploadFileReportsAFailedWriteAndUnmaps)
+{
+    auto ipmi = CreateIpmiMock();
+    IpmiInterfaceMock* ipmiMock =
+        reinterpret_cast<IpmiInterfaceMock*>(ipmi.get());
+    auto sys = std::make_unique<internal::InternalSysMock>();
+    internal::InternalSysMock* sysMock = sys.get();
+    BlobHandler blob(std::move(ipmi), std::move(sys));
+
+    std::vector<std::uint8_t> image(600);
+    void* mapped = image.data();
+    EXPECT_CALL(*sysMock, open(_, _)).WillOnce(Return(5));
+    EXPECT_CALL(*sysMock, fstat(5, _)).WillOnce([](int, struct stat* info) {
+        info->st_size = 600;
+        return 0;
+    });
+    EXPECT_CALL(*sysMock, mmap(_, _, _, _, _, _)).WillOnce(Return(mapped));
+    EXPECT_CALL(*sysMock, close(5)).WillOnce(Return(0));
+    EXPECT_CALL(*sysMock, madvise(_, _, _)).WillRepeatedly(Return(0));
+    EXPECT_CALL(*sysMock, getpagesize()).WillOnce(Return(4096));
+    EXPECT_CALL(*sysMock, munmap(mapped, 600)).WillOnce(Return(0));
+
+    EXPECT_CALL(crcMock, generateCrc(_)).WillRepeatedly(Return(0x00));
+    EXPECT_CALL(*ipmiMock, sendPacket(_, _, _))
+        .WillOnce(Throw(IpmiException(IpmiError{0xc0, nullptr})));
+
+    auto uploaded = blob.tryUploadFile(1, "/tmp/image.bin");
+    ASSERT_FALSE(uploaded);
+    EXPECT_EQ(0xc0, uploaded.error().code);
+}
+
+TEST_F(BlobHandlerTest, uploadFileReportsAFailureToOpen)
+{
+    auto sys = std::make_unique<internal::InternalSysMock>();
+    EXPECT_CALL(*sys, open(_, _)).WillOnce(Return(-1));
+    BlobHandler blob(CreateIpmiMock(), std::move(sys));
+
+    EXPECT_THROW(blob.uploadFile(1, "/nonexistent"), BlobException);
+}
+
+static_assert(maxPayloadSize(BlobOEMCommands::bmcBlobWrite) == 260);
+static_assert(maxPayloadSize(BlobOEMCommands::bmcBlobWriteMeta) == 260);
+static_assert(maxPayloadSize(BlobOEMCommands::bmcBlobRead) == 266);
+static_assert(maxPayloadSize(BlobOEMCommands::bmcBlobCommit) == 255);
+static_assert(maxPayloadSize(BlobOEMCommands::bmcBlobOpen) == 263);
+static_assert(maxPayloadSize(BlobOEMCommands::bmcBlobClose) == 0);
+
+TEST_F(BlobHandlerTest, probePayloadLimitsFindsWhatTheBmcTakes)
+{
+    /* This BMC takes writes of up to 200 bytes and reads of up to 128. */
+    auto ipmi = CreateIpmiMock();
+    IpmiInterfaceMock* ipmiMock =
+        reinterpret_cast<IpmiInterfaceMock*>(ipmi.get());
+    BlobHandler blob(std::move(ipmi));
+    EXPECT_EQ(PayloadLimits({260, 266}), blob.payloadLimits());
+
+    EXPECT_CALL(crcMock, generateCrc(_)).WillRepeatedly(Return(0x00));
+    std::vector<std::uint8_t> upcoming(300);
+    std::iota(upcoming.begin(), upcoming.end(), 0);
+    std::vector<std::size_t> writes;
+    std::vector<std::size_t> reads;
+    EXPECT_CALL(*ipmiMock, sendPacket(ipmiOEMNetFn, ipmiOEMBlobCmd, _))
+        .WillRepeatedly([&](std::uint8_t, std::uint8_t,
+                            std::vector<std::uint8_t>& data) {
+            std::vector<std::uint8_t> reply = {0xcf, 0xc2, 0x00, 0x00, 0x00};
+            switch (static_cast<BlobOEMCommands>(data[3]))
+            {
+                case BlobOEMCommands::bmcBlobSessionStat:
+                    /* Open both ways, 4096 bytes long, no metadata. */
+                    reply.insert(reply.end(), {open_read | open_write, 0x00,
+                                               0x00, 0x10, 0x00, 0x00, 0x00});
+                    break;
+                case BlobOEMCommands::bmcBlobWrite:
+                    writes.push_back(data.size() - 12);
+                    /* Only ever the bytes about to be written. */
+                    EXPECT_TRUE(std::equal(data.begin() + 12, data.end(),
+                                           upcoming.begin()));
+                    if (writes.back() > 200)
+                    {
+                        throw IpmiException(IpmiError{0xc7, nullptr});
+                    }
+                    break;
+                case BlobOEMCommands::bmcBlobRead:
+                    reads.push_back(data[12] | (data[13] << 8));
+                    if (reads.back() > 128)
+                    {
+                        throw IpmiException(IpmiError{0xca, nullptr});
+                    }
+                    reply.resize(reply.size() + reads.back());
+                    break;
+                default:
+                    break;
+            }
+            return reply;
+        });
+
+    auto probed = blob.tryProbePayloadLimits(1, upcoming);
+    ASSERT_TRUE(probed);
+    EXPECT_EQ(PayloadLimits({200, 128}), *probed);
+    EXPECT_EQ(*probed, blob.payloadLimits());
+
+    /* The largest first, then a binary search. */
+    EXPECT_EQ(260u, writes.front());
+    EXPECT_LE(writes.size(), 10u);
+    EXPECT_EQ(266u, reads.front());
+    EXPECT_LE(reads.size(), 10u);
+}
+
+TEST_F(BlobHandlerTest, probePayloadLimitsStopsOnOtherFailures)
+{
+    auto ipmi = CreateIpmiMock();
+    IpmiInterfaceMock* ipmiMock =
+        reinterpret_cast<IpmiInterfaceMock*>(ipmi.get());
+    BlobHandler blob(std::move(ipmi));
+    blob.setPayloadLimits({0, 1000});
+    EXPECT_EQ(PayloadLimits({1, 266}), blob.payloadLimits());
+
+    EXPECT_CALL(crcMock, generateCrc(_)).WillRepeatedly(Return(0x00));
+    EXPECT_CALL(*ipmiMock, sendPacket(ipmiOEMNetFn, ipmiOEMBlobCmd, _))
+        .WillOnce(Return(std::vector<std::uint8_t>{
+            0xcf, 0xc2, 0x00, 0x00, 0x00, open_write, 0x00, 0x00, 0x00, 0x00,
+            0x00, 0x00}))
+        .WillOnce(Throw(IpmiException(IpmiError{0xc0, nullptr})));
+
+    std::array<std::uint8_t, 260> upcoming = {};
+    auto probed = blob.tryProbePayloadLimits(1, upcoming);
+    ASSERT_FALSE(probed);
+    EXPECT_EQ(0xc0, probed.error().code);
+    EXPECT_EQ(PayloadLimits({1, 266}), blob.payloadLimits());
+}
+
+TEST_F(BlobHandlerTest, probePayloadLimitsTakesShortReadsAsTheLimit)
+{
+    /* This BMC answers reads of any length with at most 100 bytes. */
+    auto ipmi = CreateIpmiMock();
+    IpmiInterfaceMock* ipmiMock =
+        reinterpret_cast<IpmiInterfaceMock*>(ipmi.get());
+    BlobHandler blob(std::move(ipmi));
+
+    EXPECT_CALL(crcMock, generateCrc(_)).WillRepeatedly(Return(0x00));
+    EXPECT_CALL(*ipmiMock, sendPacket(ipmiOEMNetFn, ipmiOEMBlobCmd, _))
+        .WillRepeatedly([&](std::uint8_t, std::uint8_t,
+                            std::vector<std::uint8_t>& data) {
+            std::vector<std::uint8_t> reply = {0xcf, 0xc2, 0x00, 0x00, 0x00};
+            if (static_cast<BlobOEMCommands>(data[3]) ==
+                BlobOEMCommands::bmcBlobSessionStat)
+            {
+                /* Open for reading, 4096 bytes long. */
+                reply.insert(reply.end(), {open_read, 0x00, 0x00, 0x10, 0x00,
+                                           0x00, 0x00});
+                return reply;
+            }
+            std::size_t length = data[12] | (data[13] << 8);
+            reply.resize(reply.size() + std::min<std::size_t>(length, 100));
+            return reply;
+        });
+
+    auto probed = blob.tryProbePayloadLimits(1);
+    ASSERT_TRUE(probed);
+    EXPECT_EQ(100u, probed->read);
+    EXPECT_EQ(260u, probed->write);
+}
+
+TEST_F(BlobHandlerTest, probePayloadLimitsSkipsWhatItCannotTestSafely)
+{
+    /* Open both ways but only 100 bytes long, and nothing to write: neither
+     * limit can be probed without going past the blob.
+     */
+    auto ipmi = CreateIpmiMock();
+    IpmiInterfaceMock* ipmiMock =
+        reinterpret_cast<IpmiInterfaceMock*>(ipmi.get());
+    BlobHandler blob(std::move(ipmi));
+    blob.setPayloadLimits({64, 128});
+
+    EXPECT_CALL(crcMock, generateCrc(_)).WillRepeatedly(Return(0x00));
+    EXPECT_CALL(*ipmiMock, sendPacket(ipmiOEMNetFn, ipmiOEMBlobCmd, _))
+        .WillOnce(Return(std::vector<std::uint8_t>{
+            0xcf, 0xc2, 0x00, 0x00, 0x00, open_read | open_write, 0x00, 0x64,
+            0x00, 0x00, 0x00, 0x00}));
+
+    std::array<std::uint8_t, 100> upcoming = {};
+    auto probed = blob.tryProbePayloadLimits(1, upcoming);
+    ASSERT_TRUE(probed);
+    EXPECT_EQ(PayloadLimits({64, 128}), *probed);
+}
+
 } // namespace ipmiblob
@@ -1,5 +1,14 @@
+#include <ipmiblob/blob_errors.hpp>
 #include <ipmiblob/ipmi_errors.hpp>
+#include <ipmiblob/ipmi_interface.hpp>
+#include <ipmiblob/test/ipmi_interface_mock.hpp>
 
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
 namespace ipmiblob
@@ -25,4 +34,27 @@ TEST(IpmiExceptionTest, VerifyTimedOutIsString)
     EXPECT_TRUE(verified);
 }
 
+TEST(IpmiErrorTest, DefaultTrySendKeepsTheHostSideMessage)
+{
+    IpmiInterfaceMock ipmi;
+    EXPECT_CALL(ipmi, sendPacket)
+        .WillOnce(::testing::Throw(IpmiException("Unable to open device")))
+        .WillOnce(::testing::Throw(IpmiException(0xc0)));
+
+    std::vector<std::uint8_t> request = {1};
+    IpmiReply reply;
+    auto failed = ipmi.trySendPacketInto(6, 1, request, reply);
+    ASSERT_FALSE(failed);
+    EXPECT_EQ(0, failed.error().code);
+    EXPECT_EQ("Unable to open device", failed.error().message());
+
+    /* The message outlives the error it came from. */
+    BlobError blob = failed.error();
+    failed = ipmi.trySendPacketInto(6, 1, request, reply);
+    EXPECT_EQ("Unable to open device", blob.message());
+    ASSERT_FALSE(failed);
+    EXPECT_EQ(0xc0, failed.error().code);
+    EXPECT_EQ(nullptr, failed.error().reason);
+}
+
 } // namespace ipmiblob
@@ -5,13 +5,24 @@
 
 #include <ipmiblob/ipmi_errors.hpp>
 #include <ipmiblob/ipmi_handler.hpp>
+#include <ipmiblob/ipmi_interface.hpp>
+#include <ipmiblob/ipmi_latency.hpp>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
 #include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <cstring>
 #include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string_view>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include <gmock/gmock-more-actions.h>
@@ -24,7 +35,9 @@ using std::chrono::milliseconds;
 using ::testing::_;
 using ::testing::DoAll;
 using ::testing::ElementsAre;
+using ::testing::Le;
 using ::testing::Return;
+using ::testing::SetErrnoAndReturn;
 
 ACTION_TEMPLATE(SetArgNPointeeTo, HAS_1_TEMPLATE_PARAMS(unsigned, uIndex),
                 AND_2_VALUE_PARAMS(pData, uiDataSize))
@@ -34,12 +47,104 @@ ACTION_TEMPLATE(SetArgNPointeeTo, HAS_1_TEMPLATE_PARAMS(unsigned, uIndex),
     reply->msg.data_len = uiDataSize;
 }
 
+ACTION_P2(SetReplyFor, msgid, bytes)
+{
+    ipmi_recv* reply = reinterpret_cast<ipmi_recv*>(arg2);
+    reply->msgid = msgid;
+    std::memcpy(reply->msg.data, bytes.data(), bytes.size());
+    reply->msg.data_len = bytes.size();
+}
+
 ACTION_TEMPLATE(SetOpenDelays, HAS_1_TEMPLATE_PARAMS(unsigned, delay),
                 AND_0_VALUE_PARAMS())
 {
     std::this_thread::sleep_for(milliseconds(delay));
 }
 
+/* A device that answers each request by echoing its data, handing the
+ * queued replies back newest first so that concurrent callers always see
+ * each other's replies before their own.
+ */
+class EchoSys : public internal::Sys
+{
+  public:
+    int open(const char*, int) const override
+    {
+        return 3;
+    }
+    int read(int, void*, std::size_t) const override
+    {
+        return -1;
+    }
+    int close(int) const override
+    {
+        return 0;
+    }
+    void* mmap(void*, std::size_t, int, int, int, off_t) const override
+    {
+        return MAP_FAILED;
+    }
+    int munmap(void*, std::size_t) const override
+    {
+        return -1;
+    }
+    int getpagesize() const override
+    {
+        return 4096;
+    }
+    int fstat(int, struct stat*) const override
+    {
+        return -1;
+    }
+    int madvise(void*, std::size_t, int) const override
+    {
+        return -1;
+    }
+
+    int poll(struct pollfd*, nfds_t, int timeout) const override
+    {
+        std::unique_lock lock(mutex);
+        bool ready = queued.wait_for(lock, milliseconds(timeout),
+                                     [this] { return !replies.empty(); });
+        return ready ? 1 : 0;
+    }
+
+    int ioctl(int, unsigned long request, void* param) const override
+    {
+        std::lock_guard lock(mutex);
+        if (request == IPMICTL_SEND_COMMAND)
+        {
+            auto req = static_cast<ipmi_req*>(param);
+            replies.emplace_back(req->msgid,
+                                 std::vector<std::uint8_t>(
+                                     req->msg.data,
+                                     req->msg.data + req->msg.data_len));
+            queued.notify_all();
+            return 0;
+        }
+
+        if (request == IPMICTL_RECEIVE_MSG_TRUNC && !replies.empty())
+        {
+            auto recv = static_cast<ipmi_recv*>(param);
+            auto& [msgid, bytes] = replies.back();
+            recv->msgid = msgid;
+            recv->msg.data[0] = 0x00;
+            std::copy(bytes.begin(), bytes.end(), recv->msg.data + 1);
+            recv->msg.data_len = bytes.size() + 1;
+            replies.pop_back();
+            return 0;
+        }
+
+        errno = EAGAIN;
+        return -1;
+    }
+
+  private:
+    mutable std::mutex mutex;
+    mutable std::condition_variable queued;
+    mutable std::vector<std::pair<long, std::vector<std::uint8_t>>> replies;
+};
+
 class IpmiHandlerTest : public ::testing::Test
 {
   protected:
@@ -225,6 +330,548 @@ TEST_F(IpmiHandlerTest, SendPacketSucess)
     EXPECT_THAT(ipmi.sendPacket(0, 0, data), ElementsAre(1, 2, 3));
 }
 
+TEST_F(IpmiHandlerTest, SendPacketIntoReceivesInPlace)
+{
+    EXPECT_CALL(*sysMock, open(_, _)).WillOnce(Return(fd));
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_SEND_COMMAND, _))
+        .WillOnce(Return(0));
+    EXPECT_CALL(*sysMock, poll(_, 1, _)).WillOnce(Return(1));
+
+    std::vector<std::uint8_t> expectedOutput = {0, 1, 2, 3};
+
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_RECEIVE_MSG_TRUNC, _))
+        .WillOnce(DoAll(
+            SetArgNPointeeTo<2>(expectedOutput.data(), expectedOutput.size()),
+            Return(0)));
+
+    IpmiHandler ipmi(std::move(sysMock));
+    IpmiReply reply;
+    auto returned = ipmi.sendPacketInto(0, 0, data, reply);
+
+    /* The reply is a view into the buffer, past the completion code. */
+    EXPECT_THAT(returned, ElementsAre(1, 2, 3));
+    EXPECT_EQ(reply.raw().data() + 1, returned.data());
+}
+
+TEST_F(IpmiHandlerTest, TrySendPacketReportsCompletionCode)
+{
+    EXPECT_CALL(*sysMock, open(_, _)).WillOnce(Return(fd));
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_SEND_COMMAND, _))
+        .WillOnce(Return(0));
+    EXPECT_CALL(*sysMock, poll(_, 1, _)).WillOnce(Return(1));
+
+    std::vector<std::uint8_t> expectedOutput = {0xc0};
+
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_RECEIVE_MSG_TRUNC, _))
+        .WillOnce(DoAll(
+            SetArgNPointeeTo<2>(expectedOutput.data(), expectedOutput.size()),
+            Return(0)));
+
+    IpmiHandler ipmi(std::move(sysMock));
+    IpmiReply reply;
+    auto returned = ipmi.trySendPacketInto(0, 0, data, reply);
+
+    ASSERT_FALSE(returned);
+    EXPECT_EQ(0xc0, returned.error().code);
+    EXPECT_EQ("Received IPMI_CC: busy", returned.error().message());
+}
+
+TEST_F(IpmiHandlerTest, TrySendPacketReportsHostFailure)
+{
+    EXPECT_CALL(*sysMock, open(_, _)).WillOnce(Return(fd));
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_SEND_COMMAND, _))
+        .WillOnce(Return(0));
+    EXPECT_CALL(*sysMock, poll(_, 1, _)).WillOnce(Return(0));
+
+    IpmiHandler ipmi(std::move(sysMock));
+    IpmiReply reply;
+    auto returned = ipmi.trySendPacketInto(0, 0, data, reply);
+
+    ASSERT_FALSE(returned);
+    EXPECT_EQ(0, returned.error().code);
+    EXPECT_STREQ("Timeout waiting for reply.", returned.error().reason);
+}
+
+TEST_F(IpmiHandlerTest, PipelinedRepliesRoutedByMsgid)
+{
+    EXPECT_CALL(*sysMock, open(_, _)).WillOnce(Return(fd));
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_SEND_COMMAND, _))
+        .Times(3)
+        .WillRepeatedly(Return(0));
+    /* The second reply is read straight after the first, without polling. */
+    EXPECT_CALL(*sysMock, poll(_, 1, _)).Times(2).WillRepeatedly(Return(1));
+
+    /* The replies come back out of order, and one of them is a failure. */
+    std::vector<std::uint8_t> reply0 = {0, 'a'};
+    std::vector<std::uint8_t> reply1 = {0xc0};
+    std::vector<std::uint8_t> reply2 = {0, 'c', 'c'};
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_RECEIVE_MSG_TRUNC, _))
+        .WillOnce(DoAll(SetReplyFor(2, reply2), Return(0)))
+        .WillOnce(DoAll(SetReplyFor(0, reply0), Return(0)))
+        .WillOnce(DoAll(SetReplyFor(1, reply1), Return(0)));
+
+    IpmiHandler ipmi(std::move(sysMock), 3);
+    std::array<IpmiReply, 3> replies;
+    std::vector<IpmiHandler::Ticket> tickets;
+    for (IpmiReply& reply : replies)
+    {
+        auto ticket = ipmi.trySubmit(0, 0, data, reply);
+        ASSERT_TRUE(ticket);
+        tickets.push_back(*ticket);
+    }
+
+    /* The window is full until a ticket is spent. */
+    IpmiReply extra;
+    auto refused = ipmi.trySubmit(0, 0, data, extra);
+    ASSERT_FALSE(refused);
+    EXPECT_STREQ("IPMI request window is full.", refused.error().reason);
+
+    auto returned = ipmi.tryWait(tickets[0]);
+    ASSERT_TRUE(returned);
+    EXPECT_THAT(*returned, ElementsAre('a'));
+
+    auto failed = ipmi.tryWait(tickets[1]);
+    ASSERT_FALSE(failed);
+    EXPECT_EQ(0xc0, failed.error().code);
+
+    /* Already delivered while waiting for the first. */
+    returned = ipmi.tryWait(tickets[2]);
+    ASSERT_TRUE(returned);
+    EXPECT_THAT(*returned, ElementsAre('c', 'c'));
+    EXPECT_EQ(replies[2].raw().data() + 1, returned->data());
+
+    EXPECT_FALSE(ipmi.tryWait(tickets[2]));
+}
+
+TEST_F(IpmiHandlerTest, SubmitCompletesFromProcessReadable)
+{
+    EXPECT_CALL(*sysMock, open(_, _)).WillOnce(Return(fd));
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_SEND_COMMAND, _))
+        .Times(2)
+        .WillRepeatedly(Return(0));
+    EXPECT_CALL(*sysMock, poll(_, _, _)).Times(0);
+
+    std::vector<std::uint8_t> reply0 = {0, 'a'};
+    std::vector<std::uint8_t> reply1 = {0xc0};
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_RECEIVE_MSG_TRUNC, _))
+        .WillOnce(SetErrnoAndReturn(EAGAIN, -1))
+        .WillOnce(DoAll(SetReplyFor(0, reply0), Return(0)))
+        .WillOnce(DoAll(SetReplyFor(1, reply1), Return(0)));
+
+    /* With a window of one, the second request waits for the first. */
+    IpmiHandler ipmi(std::move(sysMock), 1);
+    ASSERT_TRUE(ipmi.tryGetFd());
+    EXPECT_EQ(fd, *ipmi.tryGetFd());
+
+    std::vector<std::vector<std::uint8_t>> returned;
+    std::vector<int> failures;
+    auto record = [&](IpmiResult<std::span<const std::uint8_t>> result) {
+        if (result)
+        {
+            returned.emplace_back(result->begin(), result->end());
+        }
+        else
+        {
+            failures.push_back(result.error().code);
+        }
+    };
+    ipmi.submit(0, 0, data, record);
+    ipmi.submit(0, 0, data, record);
+    EXPECT_TRUE(returned.empty());
+
+    /* Nothing queued yet. */
+    EXPECT_TRUE(ipmi.processReadable());
+    EXPECT_TRUE(returned.empty());
+
+    /* Completing the first sends the second, whose reply is read in the
+     * same call; with nothing left outstanding, no more reads are made.
+     */
+    EXPECT_TRUE(ipmi.processReadable());
+    ASSERT_EQ(1u, returned.size());
+    EXPECT_THAT(returned[0], ElementsAre('a'));
+    EXPECT_THAT(failures, ElementsAre(0xc0));
+
+    ReceiveStats stats = ipmi.receiveStats();
+    EXPECT_EQ(0u, stats.polls);
+    EXPECT_EQ(3u, stats.receives);
+    EXPECT_EQ(2u, stats.completions);
+    EXPECT_DOUBLE_EQ(1.5, stats.syscallsPerCompletion());
+}
+
+TEST_F(IpmiHandlerTest, CallbackMayCallSynchronouslyWithAWindowOfOne)
+{
+    EXPECT_CALL(*sysMock, open(_, _)).WillOnce(Return(fd));
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_SEND_COMMAND, _))
+        .Times(2)
+        .WillRepeatedly(Return(0));
+    EXPECT_CALL(*sysMock, poll(_, _, _)).WillRepeatedly(Return(1));
+
+    std::vector<std::uint8_t> reply0 = {0, 'a'};
+    std::vector<std::uint8_t> reply1 = {0, 'b'};
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_RECEIVE_MSG_TRUNC, _))
+        .WillOnce(DoAll(SetReplyFor(0, reply0), Return(0)))
+        .WillOnce(DoAll(SetReplyFor(1, reply1), Return(0)))
+        .WillRepeatedly(SetErrnoAndReturn(EAGAIN, -1));
+
+    IpmiHandler ipmi(std::move(sysMock), 1);
+    std::vector<std::uint8_t> returned;
+    ipmi.submit(0, 0, data, [&](auto result) {
+        ASSERT_TRUE(result);
+        returned.insert(returned.end(), result->begin(), result->end());
+
+        /* The only slot was this request's; it is free again by now. */
+        IpmiReply reply;
+        auto nested = ipmi.trySendPacketInto(0, 0, data, reply);
+        ASSERT_TRUE(nested);
+        returned.insert(returned.end(), nested->begin(), nested->end());
+    });
+
+    EXPECT_TRUE(ipmi.processReadable());
+    EXPECT_THAT(returned, ElementsAre('a', 'b'));
+}
+
+TEST_F(IpmiHandlerTest, BacklogThatFailsToSendIsWorkedThroughInALoop)
+{
+    EXPECT_CALL(*sysMock, open(_, _)).WillOnce(Return(fd));
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_SEND_COMMAND, _))
+        .WillOnce(Return(0))
+        .WillRepeatedly(Return(-1));
+
+    std::vector<std::uint8_t> reply0 = {0, 'a'};
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_RECEIVE_MSG_TRUNC, _))
+        .WillOnce(DoAll(SetReplyFor(0, reply0), Return(0)))
+        .WillRepeatedly(SetErrnoAndReturn(EAGAIN, -1));
+
+    IpmiHandler ipmi(std::move(sysMock), 1);
+    ipmi.submit(0, 0, data, [](auto result) { EXPECT_TRUE(result); });
+
+    /* Each failure is reported from the same depth, not one frame deeper
+     * than the last.
+     */
+    std::vector<std::uintptr_t> depths;
+    auto record = [&depths](IpmiResult<std::span<const std::uint8_t>> r) {
+        EXPECT_FALSE(r);
+        int local = 0;
+        depths.push_back(reinterpret_cast<std::uintptr_t>(&local));
+    };
+    for (int i = 0; i < 100; ++i)
+    {
+        ipmi.submit(0, 0, data, record);
+    }
+
+    EXPECT_TRUE(ipmi.processReadable());
+    ASSERT_EQ(100u, depths.size());
+    EXPECT_TRUE(std::all_of(depths.begin(), depths.end(),
+                            [&](auto depth) { return depth == depths[0]; }));
+}
+
+TEST_F(IpmiHandlerTest, ProcessReadableDrainsUntilTheQueueIsEmpty)
+{
+    EXPECT_CALL(*sysMock, open(_, _)).WillOnce(Return(fd));
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_SEND_COMMAND, _))
+        .Times(3)
+        .WillRepeatedly(Return(0));
+    EXPECT_CALL(*sysMock, poll(_, 1, _)).WillOnce(Return(1));
+
+    std::vector<std::uint8_t> reply0 = {0, 'a'};
+    std::vector<std::uint8_t> reply2 = {0, 'c'};
+    std::vector<std::uint8_t> reply1 = {0, 'b'};
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_RECEIVE_MSG_TRUNC, _))
+        .WillOnce(DoAll(SetReplyFor(0, reply0), Return(0)))
+        .WillOnce(DoAll(SetReplyFor(2, reply2), Return(0)))
+        .WillOnce(SetErrnoAndReturn(EAGAIN, -1))
+        .WillOnce(DoAll(SetReplyFor(1, reply1), Return(0)));
+
+    IpmiHandler ipmi(std::move(sysMock), 4);
+    std::vector<std::uint8_t> returned;
+    auto record = [&](IpmiResult<std::span<const std::uint8_t>> result) {
+        ASSERT_TRUE(result);
+        returned.insert(returned.end(), result->begin(), result->end());
+    };
+    for (int i = 0; i < 3; ++i)
+    {
+        ipmi.submit(0, 0, data, record);
+    }
+
+    /* One wakeup collects both queued replies, then stops at the empty
+     * read while the third is still outstanding.
+     */
+    EXPECT_TRUE(ipmi.processEvents());
+    EXPECT_THAT(returned, ElementsAre('a', 'c'));
+
+    EXPECT_TRUE(ipmi.processReadable());
+    EXPECT_THAT(returned, ElementsAre('a', 'c', 'b'));
+
+    ReceiveStats stats = ipmi.receiveStats();
+    EXPECT_EQ(1u, stats.polls);
+    EXPECT_EQ(4u, stats.receives);
+    EXPECT_EQ(3u, stats.completions);
+}
+
+TEST_F(IpmiHandlerTest, ProcessEventsWaitsForAReply)
+{
+    EXPECT_CALL(*sysMock, open(_, _)).WillOnce(Return(fd));
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_SEND_COMMAND, _))
+        .WillOnce(Return(0));
+    EXPECT_CALL(*sysMock, poll(_, 1, _)).WillOnce(Return(1));
+
+    std::vector<std::uint8_t> reply = {0, 'b'};
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_RECEIVE_MSG_TRUNC, _))
+        .WillOnce(DoAll(SetReplyFor(0, reply), Return(0)));
+
+    IpmiHandler ipmi(std::move(sysMock));
+    std::vector<std::uint8_t> returned;
+    ipmi.submit(0, 0, data,
+                [&](IpmiResult<std::span<const std::uint8_t>> result) {
+                    ASSERT_TRUE(result);
+                    returned.assign(result->begin(), result->end());
+                });
+
+    EXPECT_TRUE(ipmi.processEvents());
+    EXPECT_THAT(returned, ElementsAre('b'));
+}
+
+TEST_F(IpmiHandlerTest, LatencyProfileBreaksDownEachStage)
+{
+    EXPECT_CALL(*sysMock, open(_, _)).WillOnce(Return(fd));
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_SEND_COMMAND, _))
+        .WillOnce(Return(0));
+    EXPECT_CALL(*sysMock, poll(_, 1, _))
+        .Times(2)
+        .WillRepeatedly([](pollfd*, nfds_t, int) {
+            std::this_thread::sleep_for(milliseconds(2));
+            return 1;
+        });
+
+    /* A stale reply first, so the right one has to be polled for again. */
+    std::vector<std::uint8_t> stale = {0, 'x'};
+    std::vector<std::uint8_t> reply = {0, 'b'};
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_RECEIVE_MSG_TRUNC, _))
+        .WillOnce(DoAll(SetReplyFor(99, stale), Return(0)))
+        .WillOnce(SetErrnoAndReturn(EAGAIN, -1))
+        .WillOnce(DoAll(SetReplyFor(0, reply), Return(0)));
+
+    IpmiHandler ipmi(std::move(sysMock));
+    EXPECT_EQ(nullptr, ipmi.latencyProfile());
+    ipmi.setLatencyProfiling(true);
+    ASSERT_NE(nullptr, ipmi.latencyProfile());
+
+    std::vector<std::uint8_t> request = {1, 2, 3};
+    EXPECT_THAT(ipmi.sendPacket(6, 1, request), ElementsAre('b'));
+
+    auto report = ipmi.latencyProfile()->byKind();
+    ASSERT_EQ(1u, report.size());
+    EXPECT_EQ(AdaptiveTiming::kindOf(6, 1, request), report.begin()->first);
+
+    const LatencyBreakdown& breakdown = report.begin()->second;
+    EXPECT_EQ(1u, breakdown.send.count());
+    EXPECT_EQ(1u, breakdown.poll.count());
+    EXPECT_GE(breakdown.poll.total(), milliseconds(2));
+    EXPECT_EQ(1u, breakdown.receive.count());
+    EXPECT_EQ(1u, breakdown.wrongMessage.count());
+    EXPECT_GE(breakdown.wrongMessage.total(), milliseconds(2));
+    EXPECT_EQ(1u, breakdown.roundTrip.count());
+    EXPECT_GE(breakdown.roundTrip.total(), milliseconds(4));
+}
+
+TEST_F(IpmiHandlerTest, SetTimingSendsRetryParameters)
+{
+    EXPECT_CALL(*sysMock, open(_, _)).WillOnce(Return(fd));
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_SEND_COMMAND, _)).Times(0);
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_SEND_COMMAND_SETTIME, _))
+        .WillOnce([](int, unsigned long, void* param) {
+            auto timed = static_cast<ipmi_req_settime*>(param);
+            EXPECT_EQ(2, timed->retries);
+            EXPECT_EQ(100u, timed->retry_time_ms);
+            EXPECT_EQ(0, timed->req.msgid);
+            return 0;
+        });
+
+    /* Three attempts of 100ms each, and some slack; never the default. */
+    IpmiTiming timing{2, 100};
+    EXPECT_CALL(*sysMock, poll(_, 1, Le(timing.pollTimeoutMs())))
+        .WillOnce(Return(1));
+
+    std::vector<std::uint8_t> reply = {0, 'c'};
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_RECEIVE_MSG_TRUNC, _))
+        .WillOnce(DoAll(SetReplyFor(0, reply), Return(0)));
+
+    IpmiHandler ipmi(std::move(sysMock));
+    ipmi.setTiming(timing);
+    EXPECT_THAT(ipmi.sendPacket(0, 0, data), ElementsAre('c'));
+}
+
+TEST_F(IpmiHandlerTest, WaitersTimeOutBehindASlowerReader)
+{
+    EXPECT_CALL(*sysMock, open(_, _)).WillOnce(Return(fd));
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_SEND_COMMAND_SETTIME, _))
+        .Times(2)
+        .WillRepeatedly(Return(0));
+    /* The BMC never answers. */
+    EXPECT_CALL(*sysMock, poll(_, 1, _))
+        .WillRepeatedly([](pollfd*, nfds_t, int ms) {
+            std::this_thread::sleep_for(milliseconds(ms));
+            return 0;
+        });
+
+    IpmiHandler ipmi(std::move(sysMock), 2);
+    IpmiReply slowReply;
+    IpmiReply quickReply;
+    ipmi.setTiming({0, 1000});
+    auto slow = ipmi.trySubmit(0, 0, data, slowReply);
+    ASSERT_TRUE(slow);
+    ipmi.setTiming({0, 1});
+    auto quick = ipmi.trySubmit(0, 0, data, quickReply);
+    ASSERT_TRUE(quick);
+
+    /* The slow request's waiter reads the device first. */
+    std::thread reader([&] { EXPECT_FALSE(ipmi.tryWait(*slow)); });
+    std::this_thread::sleep_for(milliseconds(50));
+
+    auto start = std::chrono::steady_clock::now();
+    auto returned = ipmi.tryWait(*quick);
+    auto waited = std::chrono::steady_clock::now() - start;
+    reader.join();
+
+    ASSERT_FALSE(returned);
+    EXPECT_EQ("Timeout waiting for reply.", returned.error().message());
+    EXPECT_LT(waited, milliseconds(800));
+}
+
+TEST_F(IpmiHandlerTest, ProcessEventsExpiresOverdueRequests)
+{
+    EXPECT_CALL(*sysMock, open(_, _)).WillOnce(Return(fd));
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_SEND_COMMAND_SETTIME, _))
+        .WillOnce(Return(0));
+    EXPECT_CALL(*sysMock, poll(_, 1, _)).WillOnce([](pollfd*, nfds_t, int ms) {
+        std::this_thread::sleep_for(milliseconds(ms));
+        return 0;
+    });
+
+    IpmiHandler ipmi(std::move(sysMock));
+    ipmi.setTiming({0, 1});
+
+    std::optional<IpmiError> failure;
+    ipmi.submit(0, 0, data,
+                [&](IpmiResult<std::span<const std::uint8_t>> result) {
+                    ASSERT_FALSE(result);
+                    failure = result.error();
+                });
+
+    EXPECT_TRUE(ipmi.processEvents());
+    ASSERT_TRUE(failure);
+    EXPECT_EQ("Timeout waiting for reply.", failure->message());
+}
+
+TEST_F(IpmiHandlerTest, BusyRepliesAreRetriedAndShrinkTheWindow)
+{
+    EXPECT_CALL(*sysMock, open(_, _)).WillOnce(Return(fd));
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_SEND_COMMAND, _))
+        .Times(2)
+        .WillRepeatedly(Return(0));
+    EXPECT_CALL(*sysMock, poll(_, 1, _)).Times(2).WillRepeatedly(Return(1));
+
+    std::vector<std::uint8_t> busy = {0xc0};
+    std::vector<std::uint8_t> reply = {0, 'd'};
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_RECEIVE_MSG_TRUNC, _))
+        .WillOnce(DoAll(SetReplyFor(0, busy), Return(0)))
+        .WillOnce(DoAll(SetReplyFor(1, reply), Return(0)));
+
+    IpmiHandler ipmi(std::move(sysMock), 8);
+    CongestionControl::Options options;
+    options.baseBackoff = milliseconds(1);
+    ipmi.setCongestionControl(options);
+
+    EXPECT_THAT(ipmi.sendPacket(0, 0, data), ElementsAre('d'));
+
+    CongestionStats stats = ipmi.congestionStats();
+    EXPECT_EQ(1u, stats.retries);
+    EXPECT_EQ(1u, stats.busy);
+    EXPECT_LT(stats.window, 5.0);
+    EXPECT_GE(stats.window, 4.0);
+}
+
+TEST_F(IpmiHandlerTest, BusySubmitIsResentAfterBackoff)
+{
+    EXPECT_CALL(*sysMock, open(_, _)).WillOnce(Return(fd));
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_SEND_COMMAND, _))
+        .Times(2)
+        .WillRepeatedly(Return(0));
+    /* Reply, nothing while backing off, then the reply to the resend. */
+    EXPECT_CALL(*sysMock, poll(_, 1, _))
+        .WillOnce(Return(1))
+        .WillOnce([](pollfd*, nfds_t, int ms) {
+            EXPECT_LE(ms, 20);
+            std::this_thread::sleep_for(milliseconds(ms));
+            return 0;
+        })
+        .WillOnce(Return(1));
+
+    std::vector<std::uint8_t> busy = {0xc0};
+    std::vector<std::uint8_t> reply = {0, 'e'};
+    EXPECT_CALL(*sysMock, ioctl(fd, IPMICTL_RECEIVE_MSG_TRUNC, _))
+        .WillOnce(DoAll(SetReplyFor(0, busy), Return(0)))
+        .WillOnce(DoAll(SetReplyFor(1, reply), Return(0)));
+
+    IpmiHandler ipmi(std::move(sysMock));
+    CongestionControl::Options options;
+    options.baseBackoff = milliseconds(20);
+    ipmi.setCongestionControl(options);
+
+    std::vector<std::uint8_t> returned;
+    ipmi.submit(0, 0, data,
+                [&](IpmiResult<std::span<const std::uint8_t>> result) {
+                    ASSERT_TRUE(result);
+                    returned.assign(result->begin(), result->end());
+                });
+
+    for (int i = 0; i < 3; ++i)
+    {
+        EXPECT_TRUE(ipmi.processEvents());
+    }
+    EXPECT_THAT(returned, ElementsAre('e'));
+    EXPECT_EQ(1u, ipmi.congestionStats().retries);
+}
+
+TEST(IpmiHandlerSharedTest, ThreadsEachGetTheirOwnReply)
+{
+    /* Many threads share one handler; every reply is routed to the thread
+     * that sent the request, none are dropped and nobody times out.
+     */
+    IpmiHandler ipmi(std::make_unique<EchoSys>(), 4);
+    constexpr int threadCount = 8;
+    constexpr int requestCount = 200;
+    std::atomic<int> mismatches = 0;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back([&ipmi, &mismatches, t]() {
+            IpmiReply reply;
+            for (int i = 0; i < requestCount; ++i)
+            {
+                std::array<std::uint8_t, 2> request = {
+                    static_cast<std::uint8_t>(t),
+                    static_cast<std::uint8_t>(i)};
+                auto returned = ipmi.trySendPacketInto(0, 0, request, reply);
+                if (!returned ||
+                    !std::equal(returned->begin(), returned->end(),
+                                request.begin(), request.end()))
+                {
+                    ++mismatches;
+                }
+            }
+        });
+    }
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    EXPECT_EQ(0, mismatches.load());
+}
+
 // Tried to call open() in different thread and making sure that both thread
 // tried it and there aree no data race. Expect the first thread to fail to
 // open() and second one pass open(), but failed in the IPMICTL_SEND_COMMAND.